@@ -3,6 +3,11 @@
 # import objects, creating a .json object with all lights,
 # camera and object details.
 #
+# Meshes are classified in get_mesh_type: a plane, a cube, or a sphere whose
+# vertices all sit on one radius are exported as primitives. Any other mesh
+# (e.g. Suzanne, 507 vertices, or a sphere that has been sculpted) is
+# exported as a TRIANGLE_MESH with its buffers under "meshes".
+#
 # James Hocking 2025, assisted w. ChatGPT
 
 import bpy
@@ -24,8 +29,29 @@ def get_camera_gaze_vector(camera_obj):
     world_forward = camera_obj.matrix_world.to_3x3() @ local_forward
     return world_forward.normalized()
 
+def is_sphere_mesh(mesh, tolerance=0.01):
+    """
+    True for a UV or ico sphere: every vertex is about the same distance from the
+    centroid. Anything else with many vertices, like Suzanne, is not a sphere.
+    """
+    if len(mesh.vertices) <= 12:
+        return False
+    centroid = mathutils.Vector((0.0, 0.0, 0.0))
+    for v in mesh.vertices:
+        centroid += v.co
+    centroid /= len(mesh.vertices)
+
+    distances = [(v.co - centroid).length for v in mesh.vertices]
+    radius = sum(distances) / len(distances)
+    if radius <= 0.0:
+        return False
+    return all(abs(d - radius) <= tolerance * radius for d in distances)
+
 def get_mesh_type(obj):
-    """Heuristic classification of mesh types."""
+    """
+    Heuristic classification of mesh types. Planes, cubes and spheres become analytic
+    primitives, and every other mesh is exported as an indexed triangle mesh.
+    """
     mesh = obj.data
     verts = len(mesh.vertices)
     faces = len(mesh.polygons)
@@ -33,9 +59,9 @@ def get_mesh_type(obj):
         return "PLANE"
     elif verts == 8 and faces == 6:
         return "CUBE"
-    elif verts > 12:
+    elif is_sphere_mesh(mesh):
         return "SPHERE"
-    return "OTHER"
+    return "TRIANGLE_MESH"
 
 def extract_texture_path_from_material(mat):
     if not mat or not mat.use_nodes:
@@ -227,8 +253,41 @@ def extract_phong_from_material(mat):
 
     return output_data
 
-def get_mesh_data(obj):
-    """Extract geometric info depending on mesh type."""
+def get_triangle_mesh_buffers(mesh):
+    """
+    Triangulate a mesh into flat position, normal, uv and index lists. Corners sharing
+    a vertex, uv and normal become one vertex, so the buffers stay indexed.
+    """
+    mesh.calc_loop_triangles()
+    uv_layer = mesh.uv_layers.active
+
+    positions, normals, uvs, indices = [], [], [], []
+    vertex_lookup = {}
+    for triangle in mesh.loop_triangles:
+        for vertex_index, loop_index in zip(triangle.vertices, triangle.loops):
+            vertex = mesh.vertices[vertex_index]
+            normal = vertex.normal if triangle.use_smooth else triangle.normal
+            uv = tuple(uv_layer.data[loop_index].uv) if uv_layer else None
+            key = (vertex_index, uv, tuple(normal))
+
+            if key not in vertex_lookup:
+                vertex_lookup[key] = len(positions) // 3
+                positions += vector_to_list(vertex.co)
+                normals += vector_to_list(normal)
+                if uv:
+                    uvs += [float(uv[0]), float(uv[1])]
+            indices.append(vertex_lookup[key])
+
+    buffers = {"positions": positions, "normals": normals, "indices": indices}
+    if uv_layer:
+        buffers["uvs"] = uvs
+    return buffers
+
+def get_mesh_data(obj, meshes):
+    """
+    Extract geometric info depending on mesh type. Triangle meshes are written once
+    into meshes by name, and every object using one refers to it with its own transform.
+    """
     mesh_type = get_mesh_type(obj)
     if mesh_type == "SPHERE":
         # Get transform components
@@ -258,6 +317,14 @@ def get_mesh_data(obj):
             "shape": "PLANE",
             "corners_world": corners,
         }
+    elif mesh_type == "TRIANGLE_MESH":
+        if obj.data.name not in meshes:
+            meshes[obj.data.name] = get_triangle_mesh_buffers(obj.data)
+        return {
+            "shape": "TRIANGLE_MESH",
+            "mesh": obj.data.name,
+            "matrix_world": [[float(value) for value in row] for row in obj.matrix_world],
+        }
     else:
         return None
 
@@ -266,7 +333,8 @@ def get_blend_object_as_dict():
     scene = bpy.context.scene
     blend_object = {
         "scene_name": scene.name,
-        "objects": []
+        "objects": [],
+        "meshes": {}
     }
 
     for obj in bpy.data.objects:
@@ -303,7 +371,7 @@ def get_blend_object_as_dict():
                 "is": i_s
             })
         elif obj.type == "MESH":
-            mesh_data = get_mesh_data(obj)
+            mesh_data = get_mesh_data(obj, blend_object["meshes"])
             if mesh_data:
                 entry.update(mesh_data)
                 material_data = extract_phong_from_material(obj.active_material)
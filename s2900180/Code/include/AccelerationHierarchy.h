@@ -1,11 +1,16 @@
-#pragma once 
+#pragma once
 
 #include "Light.h"
 #include <Eigen/Dense>
+#include <cstdint>
 #include <memory>
+#include <span>
+#include <string>
 #include <vector>
-#include "Mesh.h"      
-#include <limits> 
+#include "Mesh.h"
+#include "PrimitiveStore.h"
+#include "RayPacket.h"
+#include <limits>
 
 // forward declaration
 class Mesh;
@@ -14,53 +19,198 @@ struct Ray;
 
 // constants
 constexpr int MAX_DEPTH = 10; // representing the depth of the bounding box hierarchy tree
+constexpr int MAX_TRAVERSAL_STACK = 64; // nodes waiting to be visited during a traversal
+constexpr size_t MAX_LEAF_PRIMITIVES = std::numeric_limits<uint16_t>::max(); // what a node's primitive_count holds
+constexpr int SAH_MAX_DEPTH = 48; // keeps SAH trees within the traversal stack
+constexpr int SAH_NUMBER_OF_BINS = 16; // candidate split positions tested per axis
+constexpr int SAH_MAX_LEAF_SIZE = 8; // leaves bigger than this are always split
+constexpr float SAH_TRAVERSAL_COST = 1.0f; // relative cost of visiting a node
+constexpr float SAH_INTERSECTION_COST = 2.0f; // relative cost of testing a mesh
+constexpr int WIDE_NODE_WIDTH = 4; // children per node of the wide tree, one per SSE lane
+constexpr int MAX_WIDE_TRAVERSAL_STACK = (WIDE_NODE_WIDTH - 1) * MAX_TRAVERSAL_STACK; // wide nodes push up to 3 at once
+
+enum class BoundingBoxBuilder {
+    /*
+        The strategies available for building the tree. MIDPOINT splits every box in half
+        along its longest axis. SAH (surface area heuristic) bins the mesh centroids and
+        picks the split with the lowest estimated traversal cost, creating a leaf whenever
+        splitting would cost more than testing the meshes directly.
+    */
+    MIDPOINT,
+    SAH,
+};
 
 // classes
-class BoundingBoxNode {
+struct BoundingBoxNode {
     /*
-        Node with the bounding box tree that contains the meshes within its bounds.
+        Node within the bounding box tree. The nodes are stored depth first in one array,
+        so the left child of an inner node always sits directly after it and only the
+        index of the right child is stored. Leaves instead store the range of primitive
+        references they contain.
 
         Common flow is to check intersection, and if true then continue down into tree.
         If not can skip the branches below it completely.
     */
-    public:
-        // function to check whether a ray is intersecting with the box
-        bool check_intersect(Ray ray, Hit* hit, int* counter);
-        
-        // min and max values of the box
-        Eigen::Vector3f min; 
-        Eigen::Vector3f max;
-
-        // all the meshes contained within the box
-        std::vector<std::unique_ptr<Mesh>> meshes;
-
-        // inner left and inner right nodes
-        std::unique_ptr<BoundingBoxNode> left;
-        std::unique_ptr<BoundingBoxNode> right;
+    // min and max values of the box
+    float min[3];
+    float max[3];
+
+    // leaf: index of the first primitive reference, inner node: index of the right child
+    uint32_t offset;
+
+    // amount of primitives within a leaf
+    uint16_t primitive_count;
+
+    // axis the inner node was split on
+    uint8_t axis;
+    uint8_t is_leaf;
 };
+static_assert(sizeof(BoundingBoxNode) == 32, "BoundingBoxNode should be kept at half a cache line");
+
+struct WideBoundingBoxNode {
+    /*
+        Node within the wide (4 children) version of the tree, collapsed from the binary
+        one after it is built. The bounds of the children are stored per axis (all the
+        min x values together, and so on), so one SIMD slab test checks every child at once.
+
+        Each child is either another wide node or a leaf holding a range of primitive
+        references. Unused children have inverted bounds, so no ray ever enters them.
+    */
+    alignas(16) float min[3][WIDE_NODE_WIDTH];
+    alignas(16) float max[3][WIDE_NODE_WIDTH];
+
+    // leaf: index of the first primitive reference, otherwise: index of the wide node
+    uint32_t child[WIDE_NODE_WIDTH];
+
+    // amount of primitives within each leaf child
+    uint16_t primitive_count[WIDE_NODE_WIDTH];
+
+    // bit i is set when child i is a leaf
+    uint8_t leaf_mask;
+    uint8_t child_count;
+};
+static_assert(sizeof(WideBoundingBoxNode) == 128, "WideBoundingBoxNode should be kept at two cache lines");
 
 class BoundingBoxHierarchyTree {
     /*
-        Tree container class that holds the root of the tree and constructing the 
-        tree. 
+        Tree container class that owns the primitives and the flattened nodes, and handles
+        constructing the tree. The meshes given are copied into a PrimitiveStore, and
+        are not needed after construction.
+
+        With a width of 4 the binary tree is also collapsed into wide nodes, which single
+        rays then walk instead. Ray packets always walk the binary nodes.
     */
     public:
-        // constructor that holds the meshes
-        BoundingBoxHierarchyTree(std::vector<std::unique_ptr<Mesh>> meshes);
+        // constructor that holds the meshes, width is 2 (binary) or 4 (wide)
+        BoundingBoxHierarchyTree(std::vector<std::unique_ptr<Mesh>> meshes,
+                                 BoundingBoxBuilder builder = BoundingBoxBuilder::SAH,
+                                 int width = 2);
+
+        // constructor over primitives that are already in a store, eg. from a compiled scene. 
+        // given a cache_filepath, the tree is read from there when it was built from the same
+        // primitives and settings, otherwise it is built and written there for next time
+        BoundingBoxHierarchyTree(PrimitiveStore store,
+                                 BoundingBoxBuilder builder = BoundingBoxBuilder::SAH,
+                                 int width = 2,
+                                 const std::string& cache_filepath = "");
 
         // print out the whole tree
         void print();
 
-        // check the intersection of a ray and the root of the tree
-        bool check_intersect(Ray ray, Hit* hit, int* counter);
-        
+        // check the intersection of a ray against the tree, walking it with a small fixed stack
+        bool check_intersect(Ray ray, Hit* hit, RenderStatistics* statistics) const;
+
+        // closest hit of RAY_PACKET_SIZE rays at once, walking the tree together with SIMD. rays that
+        // do not share direction signs are traced one at a time. returns a bitmask of the rays that hit
+        int check_intersect_packet(const Ray* rays, Hit* hits, RenderStatistics* statistics) const;
+
+        // any-hit query for shadow rays, true as soon as any mesh blocks the ray before t_max.
+        // no hit details are computed, only the reference of the blocker when occluder is given
+        bool occluded(Ray ray, float t_max, RenderStatistics* statistics, uint32_t* occluder = nullptr) const;
+
+        // the same query against the one primitive reference, eg. a blocker remembered from before
+        bool is_occluded_by(uint32_t reference, const Ray& ray, float t_max, RenderStatistics* statistics) const;
+
+        // getters
+        size_t get_number_of_nodes() { return _nodes.size(); };
+        size_t get_number_of_wide_nodes() { return _wide_nodes.size(); };
+        int get_width() { return _width; };
+        bool get_is_from_cache() { return _is_from_cache; };
+        const PrimitiveStore& get_store() { return _store; };
+        BoundingBoxBuilder get_builder() { return _builder; };
+        PacketTraversalData get_packet_traversal_data() const;
+
+        // box around every primitive, the bounds of the root node. zero for an empty scene
+        void get_bounds(Eigen::Vector3f& min, Eigen::Vector3f& max) const;
+
     private:
-        // root of the tree
-        std::unique_ptr<BoundingBoxNode> _root;
-        
-        // helper function for the constructing of the tree. Given a box, creates its left and right children.
-        void split_bounding_box(std::unique_ptr<BoundingBoxNode>& node, 
-                            std::vector<std::unique_ptr<Mesh>>& meshes, 
+        // helper used while building, holds the bounds of a primitive and its reference
+        struct BuildMesh {
+            Eigen::Vector3f min;
+            Eigen::Vector3f max;
+            Eigen::Vector3f centroid;
+            uint32_t reference;
+        };
+
+        // builds the tree over the primitives of the store into the storage vectors
+        void build();
+
+        // helper function for the constructing of the tree. Appends the node for the given range
+        // of meshes, then creates its left and right children.
+        void split_bounding_box(std::vector<BuildMesh>& build_meshes,
+                            size_t begin, size_t end,
                             int depth);
 
-};
\ No newline at end of file
+        // split strategies, each either partitions the range and returns true, or returns false
+        // when the range should become a leaf
+        bool partition_midpoint(std::vector<BuildMesh>& build_meshes,
+                                size_t begin, size_t end, int depth,
+                                const Eigen::Vector3f& node_min, const Eigen::Vector3f& node_max,
+                                size_t& split, int& axis);
+        bool partition_sah(std::vector<BuildMesh>& build_meshes,
+                           size_t begin, size_t end, int depth,
+                           const Eigen::Vector3f& node_min, const Eigen::Vector3f& node_max,
+                           size_t& split, int& axis);
+
+        // helper that collapses the binary subtree at binary_index into wide nodes, pulling up the
+        // children of the largest inner children until there are WIDE_NODE_WIDTH. returns its index
+        uint32_t collapse_wide_node(uint32_t binary_index);
+
+        // the walks of check_intersect and occluded over each node layout
+        bool check_intersect_binary(const Ray& ray, Hit* hit, RenderStatistics* statistics) const;
+        bool check_intersect_wide(const Ray& ray, Hit* hit, RenderStatistics* statistics) const;
+        bool occluded_binary(const Ray& ray, float t_max, RenderStatistics* statistics, uint32_t* occluder) const;
+        bool occluded_wide(const Ray& ray, float t_max, RenderStatistics* statistics, uint32_t* occluder) const;
+
+        // helper for print, walks the node at node_index and its children
+        void print_subtree(uint32_t node_index, int depth);
+
+        // every node of the tree, depth first, root at index 0
+        std::span<const BoundingBoxNode> _nodes;
+
+        // the same tree collapsed into wide nodes, root at index 0. empty for a binary tree
+        std::span<const WideBoundingBoxNode> _wide_nodes;
+
+        // strategy used to build the tree
+        BoundingBoxBuilder _builder;
+
+        // children per node walked by single rays, 2 or 4
+        int _width;
+
+        // geometry and materials of every primitive
+        PrimitiveStore _store;
+
+        // primitive references, ordered so every leaf covers a contiguous range
+        std::span<const uint32_t> _primitives;
+
+        // the arrays above view either what build filled in here, or a mapped cache file
+        // kept alive by _cache_owner
+        std::vector<BoundingBoxNode> _node_storage;
+        std::vector<WideBoundingBoxNode> _wide_node_storage;
+        std::vector<uint32_t> _primitive_storage;
+        std::shared_ptr<const void> _cache_owner;
+        bool _is_from_cache = false;
+
+        // packet traversal for the current CPU
+        PacketTraversalFunction _traverse_packet = select_packet_traversal();
+};
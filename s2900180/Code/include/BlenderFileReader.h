@@ -10,13 +10,28 @@ James Hocking, 2025
 #include "Image.h"
 #include "Helpers.h"
 #include "Mesh.h"
+#include "Texture.h"
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <map>
 #include <memory>
 #include <vector>
 #include <nlohmann/json.hpp>
 
+struct Scene {
+  /*
+  Everything read from a blender file. The materials of the meshes hold
+  their textures, which may still be reading in the background.
+  */
+  Camera camera;
+  std::vector<std::unique_ptr<Mesh>> meshes;
+  std::vector<Light> lights;
+};
+
+// the triangle meshes of a file by name, as listed under its "meshes"
+using TriangleMeshLibrary = std::map<std::string, std::shared_ptr<const TriangleMeshData>>;
+
 class BlenderFileReader {
   /*
   This class will be directly connected to a file exported from blender
@@ -26,16 +41,18 @@ class BlenderFileReader {
   public: 
     BlenderFileReader(std::string filepath) : _filepath(filepath) {;};
 
-    // function that reads the JSON of the blender file and creates the Camera object
-    Camera get_camera_from_blender_file();
-
-    // function that reads the JSON of the blender file and creates a vector of Mesh pointers
-    std::vector<std::unique_ptr<Mesh>> get_meshes_from_blender_file();
+    // function that parses the JSON of the blender file once and creates the camera, meshes 
+    // (with their materials) and lights from it. textures are read in the background
+    Scene load_scene();
 
-    // function that reads the JSON of the blender file and creates a light 
-    std::vector<Light> get_lights_from_blender_file();
+    // function that blocks until every texture of the scene has been read, sampling one
+    // before this returns is not allowed
+    void wait_for_textures();
 
   private:
     // blender file to read, likely found in ../../ASCII/file.json
     std::string _filepath;
+
+    // textures requested so far, so each image file is only read once
+    TextureCache _texture_cache;
 };
@@ -0,0 +1,73 @@
+/*
+BoundingBoxCache.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "AccelerationHierarchy.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+
+/*
+A built bounding box tree saved in a cache directory (see --bvh-cache), so later runs
+can map it back in instead of building it again. The file holds a header followed by the binary nodes,
+the wide nodes and the primitive references, each starting on a 16 byte boundary and
+written exactly as the tree keeps them.
+
+The header records a hash of everything the build depends on: the primitives, the
+builder, the width and the build constants. A file whose hash, version or byte order
+does not match is ignored and replaced, so editing the scene never reuses a stale tree.
+Before a file is used every node is checked to point forward within its arrays, the
+tree to fit the traversal stacks, and every reference to name a primitive of the store.
+
+Only the scene's tree is cached. For triangle meshes that is the tree over their
+instances, each mesh still builds the tree over its own triangles as it is read.
+*/
+const char BOUNDING_BOX_CACHE_MAGIC[8] = {'R', 'T', 'B', 'V', 'H', '\0', '\0', '\0'};
+const uint32_t BOUNDING_BOX_CACHE_VERSION = 2;
+const char BOUNDING_BOX_CACHE_EXTENSION[] = ".bvhcache"; // added to the scene's filename within the directory
+
+struct BoundingBoxCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t hash;
+  uint32_t width;
+  uint32_t primitive_count;
+  uint64_t node_offset;
+  uint64_t node_count;
+  uint64_t wide_node_offset;
+  uint64_t wide_node_count;
+  uint64_t primitive_offset;
+};
+
+struct BoundingBoxCache {
+  /*
+    The arrays of a tree, pointing into a mapped cache file kept alive by owner, or
+    into the tree itself when writing one.
+  */
+  std::span<const BoundingBoxNode> nodes;
+  std::span<const WideBoundingBoxNode> wide_nodes;
+  std::span<const uint32_t> primitives;
+  std::shared_ptr<const void> owner;
+};
+
+// FNV-1a hash over the primitives of the store and the settings that shape the tree
+uint64_t hash_bounding_box_inputs(const PrimitiveStore& store, BoundingBoxBuilder builder, int width);
+
+// the cache file of a scene within the cache directory
+std::string get_bounding_box_cache_filepath(const std::string& directory, const std::string& scene_filepath);
+
+// maps the cache file and checks it was built from the same inputs, and that every index in it
+// stays within its arrays and the store. returns nothing when the file is missing, stale or damaged
+std::optional<BoundingBoxCache> read_bounding_box_cache(const std::string& filepath, uint64_t hash,
+                                                        const PrimitiveStore& store, int width);
+
+// writes the tree to the cache file, going through a temporary file of its own so readers, and
+// other renders writing the same cache, never see half of one. failing to write only prints a
+// warning, the cache is just an optimisation
+void write_bounding_box_cache(const std::string& filepath, uint64_t hash, const BoundingBoxCache& cache);
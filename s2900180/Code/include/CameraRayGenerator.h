@@ -0,0 +1,88 @@
+/*
+CameraRayGenerator.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Camera.h"
+#include "Sampler.h"
+#include "Types.h"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <vector>
+
+struct CameraRayBuffer {
+  /*
+    The primary rays of a tile, stored as one array per axis and ordered row by row
+    across the tile. Every primary ray starts at the camera, so only the directions
+    are kept. The caller owns the buffer and reuses it from tile to tile.
+  */
+  std::vector<float> direction[3];
+
+  void resize(size_t number_of_rays) {
+    for (auto& axis : direction) axis.resize(number_of_rays);
+  };
+};
+
+class CameraRayGenerator {
+  /*
+    Turns image positions into primary rays. The camera basis, the sensor size and
+    the offset of every column and row are worked out once, so generating a ray is
+    just a couple of multiply-adds and a normalise. Only read after construction, so
+    one generator can be shared between threads.
+
+    Positions are in pixels, where (px, py) is the top left corner of a pixel and the
+    rays of one pixel's antialiasing samples land anywhere within [px, px + 1).
+  */
+  public:
+    CameraRayGenerator(const CameraProperties& props, Sampler sampler = Sampler());
+
+    // direction and full ray through the image position (x, y)
+    Eigen::Vector3f get_direction(float x, float y) const;
+    Ray get_ray(float x, float y) const;
+
+    // writes the rays through the corner of every pixel within the tile into the buffer
+    void generate_tile(int x_start, int y_start, int width, int height, CameraRayBuffer& buffer) const;
+
+    // same, but every ray lands at a position within its pixel given by the sampler. the position
+    // only depends on the pixel and sample_index, so it is the same whichever thread renders it
+    void generate_jittered_tile(int x_start, int y_start, int width, int height,
+                                int sample_index, CameraRayBuffer& buffer) const;
+
+    // the ray of one sample of the pixel (px, py), the same one generate_jittered_tile gives it
+    Ray get_jittered_ray(int px, int py, int sample_index) const;
+
+    // angle between the rays of neighbouring pixels, the spread of each pixel's ray cone
+    float get_pixel_spread_angle() const { return _pixel_spread_angle; };
+
+    // the ray at index i of a buffer filled by the above
+    Ray get_ray(const CameraRayBuffer& buffer, size_t i) const {
+      return Ray(_origin, Eigen::Vector3f(buffer.direction[0][i], buffer.direction[1][i], buffer.direction[2][i]));
+    };
+
+  private:
+    // offset along the sensor of an image position, these match the original Pixel::as_ray
+    float horizontal_offset(float x) const { return ((x / (_resolution_x - 1)) - 0.5f) * _sensor_width; };
+    float vertical_offset(float y) const { return -_sensor_height / 2 + (y / _resolution_y) * _sensor_height; };
+
+    // direction from the offsets, normalised
+    Eigen::Vector3f direction_from_offsets(float u, float v) const {
+      return ((_forward + (_right * u)) + (_down * v)).normalized();
+    };
+
+    Eigen::Vector3f _origin;
+    Eigen::Vector3f _forward; // gaze scaled by the focal length
+    Eigen::Vector3f _right; // the camera basis, pointing along increasing x and y in the image
+    Eigen::Vector3f _down;
+    float _sensor_width;
+    float _sensor_height;
+    float _resolution_x;
+    float _resolution_y;
+    float _pixel_spread_angle;
+    Sampler _sampler;
+
+    // offsets of the corner of every column and row of the image, used by generate_tile
+    std::vector<float> _column_offsets;
+    std::vector<float> _row_offsets;
+};
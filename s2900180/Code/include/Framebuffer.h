@@ -0,0 +1,103 @@
+/*
+Framebuffer.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include <string>
+
+// forward declaration
+class PPMImageFile;
+enum class ImageFormat;
+
+struct SampleVariance {
+  /*
+    Running mean and variance of the brightness of one pixel's samples, updated with
+    Welford's method so each sample is only seen once and no history is kept. Used by
+    adaptive sampling to decide which pixels still need more samples.
+  */
+  int count = 0;
+  float mean = 0.0f;
+  float m2 = 0.0f; // sum of squared differences from the mean
+
+  void add(const Eigen::Vector3f& colour) {
+    float value = 0.2126f * colour[0] + 0.7152f * colour[1] + 0.0722f * colour[2]; // luminance
+    count++;
+    float delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+  };
+
+  // standard error of the mean, how far the pixel is likely to still be from its converged
+  // value. unknown, so infinite, until there are two samples
+  float get_error() const {
+    if (count < 2) return std::numeric_limits<float>::infinity();
+    return std::sqrt(m2 / (count - 1) / count);
+  };
+};
+
+class Framebuffer {
+  /*
+    The image while it is being rendered, held as one contiguous block of floats. Pixels
+    are stored row by row with their red, green and blue next to each other, so a tile
+    walks memory in order. Colours are in the 0-255 range but kept as floats (and not
+    clamped), so samples can be accumulated without losing precision. They are only
+    turned into 8 bit values by quantize, once the frame is done.
+  */
+  public:
+    Framebuffer(int width, int height) : _width(width), _height(height),
+        _data(static_cast<size_t>(width) * height * 3, 0.0f) {};
+
+    // raw access to the red value of a pixel, followed by its green and blue
+    float* pixel(int px, int py) { return _data.data() + (static_cast<size_t>(py) * _width + px) * 3; };
+    const float* pixel(int px, int py) const { return _data.data() + (static_cast<size_t>(py) * _width + px) * 3; };
+
+    // every value of a row, 3 per pixel
+    std::span<float> row(int py) { return {pixel(0, py), static_cast<size_t>(_width) * 3}; };
+    std::span<const float> row(int py) const { return {pixel(0, py), static_cast<size_t>(_width) * 3}; };
+
+    Eigen::Vector3f get_pixel(int px, int py) const {
+      const float* p = pixel(px, py);
+      return Eigen::Vector3f(p[0], p[1], p[2]);
+    };
+
+    void add_to_pixel(int px, int py, const Eigen::Vector3f& colour) {
+      float* p = pixel(px, py);
+      p[0] += colour[0];
+      p[1] += colour[1];
+      p[2] += colour[2];
+    };
+
+    void set_pixel(int px, int py, const Eigen::Vector3f& colour) {
+      float* p = pixel(px, py);
+      p[0] = colour[0];
+      p[1] = colour[1];
+      p[2] = colour[2];
+    };
+
+    // function that rounds every pixel down to 8 bits, clamped to 0-255, into the image
+    void quantize(PPMImageFile& image) const;
+
+    // function that writes the frame to a file. ppm formats are quantized first, while pfm keeps
+    // the floats as they are, divided by 255 into the 0-1 range
+    void write_to_file(const std::string& filename, ImageFormat format) const;
+
+    // getters
+    int get_width() const { return _width; };
+    int get_height() const { return _height; };
+    float* data() { return _data.data(); };
+    const float* data() const { return _data.data(); };
+
+  private:
+    int _width;
+    int _height;
+    std::vector<float> _data;
+};
@@ -11,98 +11,96 @@ James Hocking, 2025
 #include <fstream>
 #include <random>
 #include <vector>
+#include <cstdint>
 
 struct Pixel {
     /*
         This struct holds the value at each value of the 
         image. For now, it holds both the index within the 
-        image grid, as well as the colour in rgb.
+        image grid, as well as the colour in rgb. Rays through 
+        a pixel come from the CameraRayGenerator.
     */
 
     float px;
     float py;
 
     Colour colour{0, 0, 0};
+};
+
 
-    Ray as_ray(CameraProperties props) {
-        /*
-        Function that converts the pixel into a ray based on the 
-        Cameras properties, notably its positions and gaze.
-        */
-
-        // find the camera basis vectors
-        Eigen::Vector3f w_vec = props.gaze_vector_direction.normalized(); 
-        Eigen::Vector3f up_vec = props.up_vector.normalized();             
-        Eigen::Vector3f u_vec = up_vec.cross(w_vec).normalized();          
-        Eigen::Vector3f v_vec = w_vec.cross(u_vec).normalized();           
-
-        // depending on the sensor fit, find the FOV
-        float width, height;
-        if (props.sensor_fit == SensorFit::HORIZONTAL) {
-            width = props.sensor_width;
-            height = width * (props.resolution_y/props.resolution_x);
-        } else {
-            height = props.sensor_height;
-            width = height * (props.resolution_x/props.resolution_y);
-        }
-
-        // offset based on the pixel coordinates then multiply by basis vectors
-        float d = props.focal_length;
-        float u = ((static_cast<float>(px) / (props.resolution_x - 1)) - 0.5f) * width;
-        float v = -height / 2 + (static_cast<float>(py)/ (props.resolution_y)) * height;
-        Eigen::Vector3f dir = (w_vec * d) + (-u_vec * u) + (-v_vec * v);
-
-        // construct the ray
-        Ray ray;
-        ray.origin = props.location;
-        ray.direction = dir.normalized();
-
-        return ray;
-    };
+enum class ImageFormat {
+    /*
+        The image files that can be written. P3 is the plain text ppm, P6 the binary ppm
+        and PFM stores a 32 bit float per channel, so nothing is clamped or rounded.
+    */
+    P3,
+    P6,
+    PFM,
 };
 
+// picks the format to write from the extension of a filename, .pfm gives PFM and anything else P6
+ImageFormat image_format_from_filename(const std::string& filename);
+
+// function that writes an RGB float image to a pfm file in one go, multiplying every value by scale
+void write_pfm_file(const std::string& filename, int width, int height, const float* rgb, float scale);
 
 class PPMImageFile {
+    /*
+        An 8 bit RGB image, as read from or written to a ppm file. The pixels are stored 
+        row by row in one block, three bytes per pixel. P3, P6 and PFM files can all be 
+        read, the format is picked from the header.
+    */
     public:
-        PPMImageFile(std::string filename): _filename(filename), _width(0), _height(0), _has_image(false) {};
+        PPMImageFile(std::string filename): _width(0), _height(0), _has_image(false), _filename(filename) {};
 
-        Pixel get_pixel(int px, int py) {return _image_map.at(py).at(px); };
+        Pixel get_pixel(int px, int py) const {
+            const uint8_t* p = &_data[(static_cast<size_t>(py) * _width + px) * 3];
+            return Pixel{static_cast<float>(px), static_cast<float>(py), Colour{p[0], p[1], p[2]}};
+        };
 
         // function that reads ppm image from the specified file given in constructor
         void read_image_from_file();
 
-        // function that writes the current updated (or not) image to a new file
-        void write_current_image_to_file(std::string export_filename);
+        // function that writes the current updated (or not) image to a new file, in one bulk write
+        void write_current_image_to_file(std::string export_filename, ImageFormat format = ImageFormat::P6);
 
-        // function to update the rgb values of a particular pixel based on its pixel coordinate
+        // function to update the rgb values of a particular pixel based on its pixel coordinate,
+        // clamped to 0-255
         void update_pixel(int px, int py, struct Colour colour);
 
-        // setter 
+        // raw access to the three bytes of every pixel of a row
+        uint8_t* row(int py) { return &_data[static_cast<size_t>(py) * _width * 3]; };
+        const uint8_t* row(int py) const { return &_data[static_cast<size_t>(py) * _width * 3]; };
+
+        // setter, clears the image to black
         void set_width_and_height(int width, int height) {
             _width=width;
             _height=height;
-            _image_map.resize(_height);
-            for (auto& row : _image_map) {
-                row.resize(_width);
-            }
-            for (int px = 0; px < get_width(); px++) {
-                for (int py = 0; py < get_height(); py++) {
-                    _image_map.at(py).at(px).px = px;
-                    _image_map.at(py).at(px).py = py;
-                }
-            }
-            
+            _data.assign(static_cast<size_t>(_width) * _height * 3, 0);
         };
 
+        // the bytes of every pixel, row by row
+        const std::vector<uint8_t>& get_data() const {return _data;};
+
+        // the original floats of a pfm file, laid out like get_data. empty for ppm files
+        const std::vector<float>& get_float_data() const {return _float_data;};
+
         // getters 
-        int get_width() {return _width;};
-        int get_height() {return _height;};
-        bool get_has_image() {return _has_image;};
+        int get_width() const {return _width;};
+        int get_height() const {return _height;};
+        bool get_has_image() const {return _has_image;};
+        const std::string& get_filename() const {return _filename;};
 
     private:
+        // readers for the pixels of each format, called once the header up to the size is read
+        void read_p3(std::istream& file, int max_colour);
+        void read_p6(std::istream& file, int max_colour);
+        void read_pfm(std::istream& file, int channels);
+
         int _width;
         int _height;
         bool _has_image;
         std::string _filename;
-        std::vector<std::vector<Pixel>> _image_map;
+        std::vector<uint8_t> _data;
+        std::vector<float> _float_data;
 };
\ No newline at end of file
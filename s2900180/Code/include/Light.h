@@ -16,6 +16,10 @@ James Hocking, 2025
 // forward declaration
 class Mesh;
 class BoundingBoxHierarchyTree;
+class LightGrid;
+class ShadowCache;
+struct RenderStatistics;
+struct ShadingMaterial;
 
 // classes
 struct Hit {
@@ -31,8 +35,14 @@ struct Hit {
   bool is_hit = false;
 
   float u, v; // texture coordinates
+  float uv_scale = 0.0f; // world distance covered by one unit of u or v, roughly
 
-  Mesh *mesh;
+  const ShadingMaterial *material; // from the store's compiled material table
+
+  // the ray cone that made the hit, which tells the textures how much of them a pixel covers
+  float cone_width = 0.0f; // width of the cone at the hit
+  float cone_spread = 0.0f; // angle the cone widens by, per unit of distance
+  float cone_cosine = 1.0f; // cosine between the ray and the normal
 };
 
 class Light {
@@ -49,9 +59,9 @@ class Light {
     };
 
     // getters/setters
-    Eigen::Vector3f get_location() { return _location; };
-    float get_id() { return _id; };
-    float get_is() { return _is; };
+    Eigen::Vector3f get_location() const { return _location; };
+    float get_id() const { return _id; };
+    float get_is() const { return _is; };
 
   private:
     Eigen::Vector3f _location;
@@ -62,9 +72,56 @@ class Light {
 // helper functions
 void update_hit_from_intersection(Hit *h, Eigen::Vector3f intersection_point,
                                   Eigen::Vector3f normal,
-                                  float distance_along_ray, Mesh *mesh,
-                                  float u = -1.0f, float v = -1.0f);
-Eigen::Vector3f shade(Hit *hit, std::vector<Light> lights,
-                      CameraProperties *props, float Ia,
-                      std::unique_ptr<BoundingBoxHierarchyTree> &bbht,
-                      int depth, int max_depth);
+                                  float distance_along_ray, const ShadingMaterial *material,
+                                  float u = -1.0f, float v = -1.0f, float uv_scale = 0.0f);
+
+// sets the ray cone of a hit made by ray, whose cone started out width wide
+void update_hit_ray_cone(Hit *h, const Ray &ray, float width, float spread);
+
+/*
+  The steps of shading a hit, shared by the recursive shade below and the wavefront
+  renderer (see Wavefront.h), which runs each step over a whole queue of hits at once.
+*/
+struct ShadingPoint {
+  Eigen::Vector3f P; // the hit point
+  Eigen::Vector3f N; // unit normal
+  Eigen::Vector3f V; // unit direction from the camera to the point
+  Eigen::Vector3f base_colour; // 0-1, with the texture applied
+  const ShadingMaterial *material;
+};
+
+// function that finds everything the lights need about a hit, including its textured colour
+ShadingPoint get_shading_point(const Hit *hit, const CameraProperties *props);
+
+// the ambient part of the colour, the start of every shaded point
+Eigen::Vector3f get_ambient(const ShadingPoint &point, float Ia);
+
+// ray towards a light, and the distance along it that a mesh must be within to block the light
+Ray get_shadow_ray(const ShadingPoint &point, const Light &light, float &distance_to_blocker);
+
+// adds the diffuse and specular light from an unblocked light, scaled by weight when the light was sampled
+void add_light(Eigen::Vector3f &shaded, const ShadingPoint &point, const Light &light, float weight = 1.0f);
+
+// the mirror reflection of the view direction, and mixing its colour into the point's
+Ray get_reflection_ray(const ShadingPoint &point);
+Eigen::Vector3f blend_reflection(const Eigen::Vector3f &shaded, const Eigen::Vector3f &reflected_colour,
+                                 float reflectivity);
+
+struct ShadingContext {
+  /*
+    Everything shade reads besides the hit. It only holds references, and is passed
+    down the reflections by reference, so nothing is copied per hit or per bounce.
+  */
+  const std::vector<Light> &lights;
+  const LightGrid &light_grid; // picks which of the lights to shade each point with
+  const CameraProperties &camera;
+  float ambient; // Ia, the intensity of the ambient light
+  const BoundingBoxHierarchyTree &tree;
+  int max_depth; // reflections followed past the first hit
+};
+
+// function that shades a hit, following its reflections until context.max_depth. shadow rays go
+// through shadow_cache when one is given, and the rays traced are counted into statistics. both
+// belong to the calling thread
+Eigen::Vector3f shade(Hit *hit, const ShadingContext &context, ShadowCache *shadow_cache,
+                      RenderStatistics *statistics, int depth);
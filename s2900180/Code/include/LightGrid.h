@@ -0,0 +1,127 @@
+/*
+LightGrid.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Light.h"
+#include "Sampler.h"
+#include <Eigen/Dense>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// constants
+constexpr int LIGHT_GRID_MAX_RESOLUTION = 32; // most cells along each axis of the grid
+constexpr int LIGHT_GRID_CELLS_PER_LIGHT = 4; // cells aimed for per light, before the cap above
+
+class LightGrid {
+  /*
+    Finds the lights that matter at a shading point, so a hit does not have to cast a
+    shadow ray to every light in the scene.
+
+    A point light's diffuse and specular terms fall off as min(1 / distance, 1), so
+    with a cutoff on the brightness a light may add, each light only reaches within an
+    influence radius of (id + is) * 255 / cutoff. The grid covers the bounds of these
+    spheres, and each cell lists the lights whose sphere may overlap it. With no cutoff
+    every light reaches everywhere and no grid is built.
+
+    With light samples set, a point with more lights in reach than samples only shades
+    that many, picked with a probability matching their estimated contribution and
+    weighted so the expected colour is unchanged. Picks are stratified over the lights,
+    and the random number is hashed from the point, so it is the same on every run.
+  */
+  public:
+    // cutoff is in 0-255 brightness, 0 for none. samples is 0 to always use every light in reach
+    LightGrid(const std::vector<Light>& lights, float cutoff = 0.0f, int samples = 0);
+
+    /*
+    Function that calls visit(light_index, weight) for each light to shade P with, in the
+    order of the lights. The weight is 1 unless the lights were sampled, in which case it
+    scales that light's colour up to stand in for the lights that were not picked.
+    */
+    template <typename Visit>
+    void for_each_light(const Eigen::Vector3f& P, Visit&& visit) const;
+
+    // getters
+    bool get_is_culling() const { return _cutoff > 0.0f; };
+    float get_radius(size_t light_index) const { return std::sqrt(_radii_squared[light_index]); };
+    size_t get_number_of_cells() const { return _cell_starts.empty() ? 0 : _cell_starts.size() - 1; };
+    int get_samples() const { return _samples; };
+
+    // average number of lights listed per cell, the candidates a point starts from
+    float get_average_lights_per_cell() const;
+
+  private:
+    // the lights listed in the cell P falls in, every light when not culling
+    std::span<const uint32_t> get_candidates(const Eigen::Vector3f& P) const;
+
+    // whether light_index reaches P, and its estimated brightness there
+    bool is_in_reach(uint32_t light_index, const Eigen::Vector3f& P) const {
+      return (_positions[light_index] - P).squaredNorm() < _radii_squared[light_index];
+    };
+    float get_estimate(uint32_t light_index, const Eigen::Vector3f& P) const {
+      return _powers[light_index] * std::min(1.0f / (_positions[light_index] - P).norm(), 1.0f);
+    };
+
+    float _cutoff;
+    int _samples;
+
+    // per light, copied out so the grid does not depend on the light list staying put
+    std::vector<Eigen::Vector3f> _positions;
+    std::vector<float> _radii_squared;
+    std::vector<float> _powers; // id + is, the most the light can add before attenuation
+
+    // the cells, each listing its lights in _cell_lights from _cell_starts[cell] to
+    // _cell_starts[cell + 1]. when not culling, _all_lights is used instead
+    Eigen::Vector3f _min;
+    Eigen::Vector3f _inv_cell_size;
+    int _resolution[3] = {0, 0, 0};
+    std::vector<uint32_t> _cell_starts;
+    std::vector<uint32_t> _cell_lights;
+    std::vector<uint32_t> _all_lights;
+};
+
+template <typename Visit>
+void LightGrid::for_each_light(const Eigen::Vector3f& P, Visit&& visit) const {
+    std::span<const uint32_t> candidates = get_candidates(P);
+
+    // sum up the lights in reach, and stop there when every one of them is shaded anyway
+    size_t in_reach = 0;
+    float total = 0.0f;
+    for (uint32_t light_index : candidates) {
+        if (!is_in_reach(light_index, P)) continue;
+        in_reach++;
+        if (_samples > 0) total += get_estimate(light_index, P);
+    }
+    if (_samples <= 0 || in_reach <= static_cast<size_t>(_samples)) {
+        for (uint32_t light_index : candidates) {
+            if (is_in_reach(light_index, P)) visit(light_index, 1.0f);
+        }
+        return;
+    }
+    if (total <= 0.0f) return;
+
+    // the picks are evenly spaced over the running total of the estimates, from one random offset
+    float offset = random_sample(std::bit_cast<int>(P.x()), std::bit_cast<int>(P.y()), std::bit_cast<int>(P.z()), 0);
+    float spacing = total / _samples;
+    float next_pick = offset * spacing;
+    float running_total = 0.0f;
+    int picked = 0;
+    for (uint32_t light_index : candidates) {
+        if (picked == _samples) break;
+        if (!is_in_reach(light_index, P)) continue;
+        float estimate = get_estimate(light_index, P);
+        running_total += estimate;
+
+        int picks = 0;
+        while (picked < _samples && next_pick < running_total) {
+            picks++;
+            picked++;
+            next_pick += spacing;
+        }
+        if (picks > 0) visit(light_index, picks * spacing / estimate);
+    }
+}
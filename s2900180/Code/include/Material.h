@@ -2,8 +2,9 @@
 
 #include <Eigen/Dense>
 #include "Types.h"
+#include <memory>
 
-class PPMImageFIle;
+class Texture;
 
 struct Material { 
   float ka; // constant for ambiance
@@ -14,5 +15,35 @@ struct Material {
   float transparancy = 0.0;
   float ior = 1.0; // index of refraction
   Colour base_colour;
-  PPMImageFile* texture = nullptr;
-};
\ No newline at end of file
+  std::shared_ptr<const Texture> texture; // shared with every material using the same image
+};
+
+struct ShadingMaterial {
+  /*
+    The parameters of a Material in the form shade reads them, compiled once when the
+    scene is loaded. The colour is already 0-1 floats, and the texture is a plain
+    pointer kept alive by the Material it came from.
+  */
+  Eigen::Vector3f base_colour; // 0-1
+  float ka;
+  float kd;
+  float ks;
+  float shininess;
+  float reflectivity;
+  const Texture* texture;
+};
+
+// function that converts a material into its shading parameters
+inline ShadingMaterial compile_material(const Material& material) {
+  ShadingMaterial compiled;
+  compiled.base_colour = Eigen::Vector3f(material.base_colour.r / 255.0f,
+                                         material.base_colour.g / 255.0f,
+                                         material.base_colour.b / 255.0f);
+  compiled.ka = material.ka;
+  compiled.kd = material.kd;
+  compiled.ks = material.ks;
+  compiled.shininess = material.shininess;
+  compiled.reflectivity = material.reflectivity;
+  compiled.texture = material.texture.get();
+  return compiled;
+}
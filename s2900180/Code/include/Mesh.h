@@ -9,6 +9,8 @@ James Hocking, 2025
 #include "Types.h"
 #include "Light.h"
 #include "Helpers.h"
+#include "Primitives.h"
+#include "TriangleMesh.h"
 #include <Eigen/Dense>
 #include <array>
 #include <iostream>
@@ -29,32 +31,31 @@ enum PlaneCorners {
   TOP_RIGHT,
 };
 
-enum class MeshType {
-  CUBE,
-  SPHERE,
-  PLANE,
-};
-
 class Mesh {
   /*
-    The parent class for all meshes, holds the shared features of all meshes
+    The parent class for all meshes, holds the shared features of all meshes. Meshes are
+    how the scene is described when it is read in, the renderer itself copies their
+    geometry into a PrimitiveStore and works on that instead.
   */
   public:
     // almost all functions are purely virtual as needed to be implemented
-    Mesh(std::string name, MeshType type, Material material): _name(std::move(name)), _type(type), _material(material) {}
+    Mesh(std::string name, MeshType type, Material material)
+        : _material(material), _shading_material(compile_material(_material)), _name(std::move(name)), _type(type) {}
     virtual void show_properties() = 0;
     virtual enum MeshType get_meshtype() = 0;
     virtual bool check_intersect(struct Ray &r, struct Hit *hit) = 0;
+    virtual bool occluded(struct Ray &r, float t_max) = 0;
     virtual Eigen::Vector3f get_centroid() = 0;
     virtual Eigen::Vector3f get_min_bound() = 0;
     virtual Eigen::Vector3f get_max_bound() = 0;
     virtual std::unique_ptr<Mesh> clone() const = 0;
     std::string get_name() { return _name;};
-    Material get_material() {return _material;};
+    const Material& get_material() const { return _material; };
     virtual ~Mesh() = default;
 
   protected:
     Material _material;
+    ShadingMaterial _shading_material; // what the mesh's own intersection tests give their hits
     std::string _name;
     enum MeshType _type;
 };
@@ -62,7 +63,8 @@ class Mesh {
 class Cube : public Mesh {
   public:
     Cube(Eigen::Vector3f translation, Eigen::Vector3f rotation, Eigen::Vector3f scale, std::string name, enum MeshType type, Material material)
-      : Mesh(std::move(name), type, material), _translation(translation), _rotation(rotation), _scale(scale) {};
+      : Mesh(std::move(name), type, material), _translation(translation), _rotation(rotation), _scale(scale),
+        _primitive(make_cube_primitive(translation, rotation, scale)) {};
     
     // print out the properties of the cube to std output 
     void show_properties() override;
@@ -74,6 +76,9 @@ class Cube : public Mesh {
     */
     bool check_intersect(Ray &r, Hit *hit) override;
 
+    // same slab test as check_intersect, but stops once any hit closer than t_max is found
+    bool occluded(Ray &r, float t_max) override;
+
     // getters/setters
     enum MeshType get_meshtype() { return MeshType::CUBE; };
 
@@ -83,18 +88,22 @@ class Cube : public Mesh {
 
     Eigen::Vector3f get_max_bound() {return _translation + Eigen::Vector3f(_scale[0], _scale[1], _scale[2]);};
 
+    const CubePrimitive& get_primitive() {return _primitive;};
+
     std::unique_ptr<Mesh> clone() const override {return std::make_unique<Cube>(*this);}
 
   private:
     Eigen::Vector3f _translation;
     Eigen::Vector3f _rotation;
     Eigen::Vector3f _scale;
+    CubePrimitive _primitive;
 };
 
 class Sphere : public Mesh {
   public:
     Sphere(Eigen::Vector3f location, Eigen::Vector3f rotation, Eigen::Vector3f scale, std::string name, enum MeshType type, Material material)
-      : Mesh(std::move(name), type, material), _location(location), _rotation(rotation), _scale(scale) {};
+      : Mesh(std::move(name), type, material), _location(location), _rotation(rotation), _scale(scale),
+        _primitive(make_sphere_primitive(location, rotation, scale)) {};
     
     // print out the properties of the sphere to the std output 
     void show_properties() override;
@@ -107,6 +116,9 @@ class Sphere : public Mesh {
     */
     bool check_intersect(Ray &r, Hit *hit) override;
 
+    // only solves for the nearest root, returning whether it is closer than t_max
+    bool occluded(Ray &r, float t_max) override;
+
     // getters/setters
     enum MeshType get_meshtype() override { return MeshType::SPHERE;};
 
@@ -116,22 +128,21 @@ class Sphere : public Mesh {
     
     Eigen::Vector3f get_max_bound() {return _location + Eigen::Vector3f(_scale[0], _scale[1], _scale[2]);};
 
+    const SpherePrimitive& get_primitive() {return _primitive;};
+
     std::unique_ptr<Mesh> clone() const override {return std::make_unique<Sphere>(*this);}
 
   private:
     Eigen::Vector3f _location;
     Eigen::Vector3f _rotation;
     Eigen::Vector3f _scale;
+    SpherePrimitive _primitive;
 };
 
 class Plane : public Mesh {
   public:
     Plane(const std::array<Eigen::Vector3f, NUMBER_OF_PLANE_CORNERS> &corners, std::string name, MeshType type, Material material)
-      : Mesh(std::move(name), type, material), _corners(corners) {
-      // find a point on the plane and a normal vector
-      _point = _corners[PlaneCorners::BOTTOM_LEFT];
-      _normal = (corners[PlaneCorners::BOTTOM_LEFT] - corners[PlaneCorners::BOTTOM_RIGHT]).cross((corners[PlaneCorners::BOTTOM_LEFT] - corners[PlaneCorners::TOP_LEFT])).normalized();
-    }
+      : Mesh(std::move(name), type, material), _corners(corners), _primitive(make_plane_primitive(corners)) {}
 
     // print out the properties of the plane to the std output
     void show_properties() override;
@@ -145,6 +156,9 @@ class Plane : public Mesh {
     */
     bool check_intersect(Ray &r, Hit *hit) override;
 
+    // same test as check_intersect without the texture coordinates, limited to t_max
+    bool occluded(Ray &r, float t_max) override;
+
     // getters/setters
     enum MeshType get_meshtype() { return MeshType::PLANE; };
 
@@ -168,10 +182,55 @@ class Plane : public Mesh {
         return max_bound;
     };
 
+    const PlanePrimitive& get_primitive() {return _primitive;};
+
     std::unique_ptr<Mesh> clone() const override {return std::make_unique<Plane>(*this);}
 
   private:
     std::array<Eigen::Vector3f, NUMBER_OF_PLANE_CORNERS> _corners;
-    Eigen::Vector3f _point;
-    Eigen::Vector3f _normal;
-};
\ No newline at end of file
+    PlanePrimitive _primitive;
+};
+
+class TriangleMesh : public Mesh {
+  /*
+    One instance of a triangle mesh, placing the shared data in the scene with its own
+    transform. Instances of the same mesh share the triangles and their tree.
+  */
+  public:
+    TriangleMesh(std::shared_ptr<const TriangleMeshData> data, const Eigen::Matrix4f& matrix_world, std::string name,
+                 MeshType type, Material material)
+      : Mesh(std::move(name), type, material), _data(std::move(data)), _matrix_world(matrix_world),
+        _primitive(make_triangle_mesh_instance(matrix_world, *_data)) {};
+
+    // print out the properties of the instance to std output
+    void show_properties() override;
+
+    /*
+    Function to find the intersection between a ray and the mesh. The ray is moved
+    into the local space of the mesh and walks the tree over its triangles there.
+    */
+    bool check_intersect(Ray &r, Hit *hit) override;
+
+    // same as check_intersect, but stops at the first triangle closer than t_max
+    bool occluded(Ray &r, float t_max) override;
+
+    // getters/setters
+    enum MeshType get_meshtype() { return MeshType::TRIANGLE_MESH; };
+
+    Eigen::Vector3f get_centroid() {
+      return (as_vec3(_primitive.min) + as_vec3(_primitive.max)) / 2.0f;
+    };
+
+    Eigen::Vector3f get_min_bound() { return as_vec3(_primitive.min); };
+    Eigen::Vector3f get_max_bound() { return as_vec3(_primitive.max); };
+
+    const TriangleMeshInstance& get_primitive() {return _primitive;};
+    const std::shared_ptr<const TriangleMeshData>& get_data() {return _data;};
+
+    std::unique_ptr<Mesh> clone() const override {return std::make_unique<TriangleMesh>(*this);}
+
+  private:
+    std::shared_ptr<const TriangleMeshData> _data;
+    Eigen::Matrix4f _matrix_world;
+    TriangleMeshInstance _primitive;
+};
@@ -0,0 +1,354 @@
+/*
+PacketKernels.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "AccelerationHierarchy.h"
+#include "RayPacket.h"
+#include <cstdint>
+#include <limits>
+
+/*
+  The packet traversal and intersection kernels, written once against a small SIMD
+  backend S and compiled into one implementation per instruction set (see RayPacket.cpp
+  and RayPacketAvx2.cpp). A backend provides:
+
+    S::Float, S::Mask            eight floats and eight lane flags
+    + - * / and unary -          on Float
+    < <= > >=                    on Float, giving a Mask
+    & |                          on Mask
+    S::load, S::store, S::set1   moving floats in and out
+    S::abs, S::sqrt              per lane maths
+    S::none()                    a Mask with no lanes set
+    S::andnot(a, b)              lanes set in b but not in a
+    S::select(m, a, b)           a where m is set, otherwise b
+    S::movemask(m)               one bit per lane
+
+  The kernels repeat the operations of the scalar tests in Primitives.h in the same
+  order (Eigen sums a 3 element dot product as x + (y + z)), so a packet finds exactly
+  the same distances as tracing its rays one at a time.
+
+  Everything here is a template on the backend, and each backend is declared in an
+  anonymous namespace, so no inline code is shared between files compiled for different
+  instruction sets.
+*/
+
+template <typename S>
+struct PacketRays {
+  typename S::Float origin[3];
+  typename S::Float direction[3];
+  typename S::Float inv_direction[3];
+};
+
+// function that rotates a vector of every lane by a column major 3x3 matrix
+template <typename S>
+void packet_rotate(const float* matrix, const typename S::Float vector[3], typename S::Float result[3]) {
+  for (int i = 0; i < 3; i++) {
+    result[i] = S::set1(matrix[i]) * vector[0]
+              + (S::set1(matrix[3 + i]) * vector[1] + S::set1(matrix[6 + i]) * vector[2]);
+  }
+}
+
+template <typename S>
+typename S::Float packet_dot(const typename S::Float a[3], const typename S::Float b[3]) {
+  return a[0] * b[0] + (a[1] * b[1] + a[2] * b[2]);
+}
+
+// function that moves every ray into the unit space of a cube or sphere
+template <typename S>
+void packet_to_local(const PacketRays<S>& rays, const float* translation, const float* inv_rotation,
+                     const float* inv_scale, typename S::Float local_origin[3], typename S::Float local_direction[3]) {
+  typename S::Float relative_origin[3];
+  for (int i = 0; i < 3; i++) relative_origin[i] = rays.origin[i] - S::set1(translation[i]);
+
+  packet_rotate<S>(inv_rotation, relative_origin, local_origin);
+  packet_rotate<S>(inv_rotation, rays.direction, local_direction);
+  for (int i = 0; i < 3; i++) {
+    local_origin[i] = local_origin[i] * S::set1(inv_scale[i]);
+    local_direction[i] = local_direction[i] * S::set1(inv_scale[i]);
+  }
+}
+
+// packet version of intersect_node, returns the lanes that enter the box before their closest hit
+template <typename S>
+typename S::Mask packet_intersect_node(const BoundingBoxNode& node, const PacketRays<S>& rays,
+                                       const int direction_is_negative[3], typename S::Float closest) {
+  typename S::Float tmin = S::set1(0.0f);
+  typename S::Float tmax = closest;
+
+  for (int i = 0; i < 3; ++i) {
+    float near_plane = direction_is_negative[i] ? node.max[i] : node.min[i];
+    float far_plane = direction_is_negative[i] ? node.min[i] : node.max[i];
+    typename S::Float t1 = (S::set1(near_plane) - rays.origin[i]) * rays.inv_direction[i];
+    typename S::Float t2 = (S::set1(far_plane) - rays.origin[i]) * rays.inv_direction[i];
+
+    // selects rather than min/max, so a NaN leaves the range untouched as in the scalar test
+    tmin = S::select(t1 > tmin, t1, tmin);
+    tmax = S::select(t2 < tmax, t2, tmax);
+  }
+
+  return tmin <= tmax;
+}
+
+struct PacketInterval {
+  /*
+    The bounds of a packet's origins and inverse directions on each axis, so one scalar
+    slab test covers every ray at once. Axes where some ray runs parallel to the planes
+    (an infinite inverse direction) are left out, which only ever lets more nodes through.
+  */
+  float origin_min[3];
+  float origin_max[3];
+  float inv_direction_min[3];
+  float inv_direction_max[3];
+  bool is_bounded[3];
+  float closest_max; // the furthest any ray in the packet still has to look
+};
+
+// the largest of RAY_PACKET_SIZE floats
+template <typename S>
+float packet_max_lane(const float* values) {
+  float result = values[0];
+  for (int lane = 1; lane < RAY_PACKET_SIZE; lane++) result = values[lane] > result ? values[lane] : result;
+  return result;
+}
+
+template <typename S>
+PacketInterval make_packet_interval(const RayPacket& packet, const float* closest) {
+  const float infinity = std::numeric_limits<float>::infinity();
+  PacketInterval interval;
+  for (int i = 0; i < 3; i++) {
+    interval.origin_min[i] = interval.origin_max[i] = packet.origin[i][0];
+    interval.inv_direction_min[i] = interval.inv_direction_max[i] = packet.inv_direction[i][0];
+    for (int lane = 1; lane < RAY_PACKET_SIZE; lane++) {
+      float origin = packet.origin[i][lane];
+      float inv_direction = packet.inv_direction[i][lane];
+      interval.origin_min[i] = origin < interval.origin_min[i] ? origin : interval.origin_min[i];
+      interval.origin_max[i] = origin > interval.origin_max[i] ? origin : interval.origin_max[i];
+      interval.inv_direction_min[i] = inv_direction < interval.inv_direction_min[i] ? inv_direction : interval.inv_direction_min[i];
+      interval.inv_direction_max[i] = inv_direction > interval.inv_direction_max[i] ? inv_direction : interval.inv_direction_max[i];
+    }
+    interval.is_bounded[i] = interval.inv_direction_min[i] > -infinity && interval.inv_direction_max[i] < infinity;
+  }
+  interval.closest_max = packet_max_lane<S>(closest);
+  return interval;
+}
+
+// interval arithmetic version of intersect_node for the whole packet. false only when no ray
+// of the packet can enter the box before its closest hit, so the lanes need not be tested.
+// the corners of each product bound every lane's product, as rounding keeps their order
+template <typename S>
+bool packet_interval_intersect_node(const BoundingBoxNode& node, const PacketInterval& interval,
+                                    const int direction_is_negative[3]) {
+  float tmin = 0.0f;
+  float tmax = interval.closest_max;
+
+  for (int i = 0; i < 3; ++i) {
+    if (!interval.is_bounded[i]) continue;
+    float near_plane = direction_is_negative[i] ? node.max[i] : node.min[i];
+    float far_plane = direction_is_negative[i] ? node.min[i] : node.max[i];
+
+    // the earliest any ray could enter and the latest any ray could leave the slab
+    float near_distances[2] = {near_plane - interval.origin_max[i], near_plane - interval.origin_min[i]};
+    float far_distances[2] = {far_plane - interval.origin_max[i], far_plane - interval.origin_min[i]};
+    float inv_directions[2] = {interval.inv_direction_min[i], interval.inv_direction_max[i]};
+    float t1 = std::numeric_limits<float>::infinity();
+    float t2 = -std::numeric_limits<float>::infinity();
+    for (float distance : near_distances) {
+      for (float inv_direction : inv_directions) t1 = distance * inv_direction < t1 ? distance * inv_direction : t1;
+    }
+    for (float distance : far_distances) {
+      for (float inv_direction : inv_directions) t2 = distance * inv_direction > t2 ? distance * inv_direction : t2;
+    }
+
+    tmin = t1 > tmin ? t1 : tmin;
+    tmax = t2 < tmax ? t2 : tmax;
+  }
+
+  return tmin <= tmax;
+}
+
+template <typename S>
+typename S::Mask packet_intersect_cube(const CubePrimitive& cube, const PacketRays<S>& rays, typename S::Float& t) {
+  using Float = typename S::Float;
+  using Mask = typename S::Mask;
+
+  Float local_origin[3], local_direction[3];
+  packet_to_local<S>(rays, cube.translation, cube.inv_rotation, cube.inv_scale, local_origin, local_direction);
+
+  Float t_min_curr = S::set1(-std::numeric_limits<float>::infinity());
+  Float t_max_curr = S::set1(std::numeric_limits<float>::infinity());
+  Mask missed = S::none();
+
+  // slab test against the unit cube, lanes that miss are masked off rather than returning early
+  for (int i = 0; i < 3; ++i) {
+    Mask parallel = S::abs(local_direction[i]) < S::set1(1e-6f);
+    Mask outside = (local_origin[i] < S::set1(-0.5f)) | (local_origin[i] > S::set1(0.5f));
+    missed = missed | (parallel & outside);
+
+    Float inv_d = S::set1(1.0f) / local_direction[i];
+    Float t0 = (S::set1(-0.5f) - local_origin[i]) * inv_d;
+    Float t1 = (S::set1(0.5f) - local_origin[i]) * inv_d;
+    Mask swap = t0 > t1;
+    Float near_t = S::select(swap, t1, t0);
+    Float far_t = S::select(swap, t0, t1);
+
+    // parallel lanes keep their range, like the scalar test skipping the axis
+    t_min_curr = S::select(S::andnot(parallel, near_t > t_min_curr), near_t, t_min_curr);
+    t_max_curr = S::select(S::andnot(parallel, far_t < t_max_curr), far_t, t_max_curr);
+    missed = missed | S::andnot(parallel, t_max_curr <= t_min_curr);
+  }
+
+  t = S::select(t_min_curr < S::set1(0.0f), t_max_curr, t_min_curr);
+  return S::andnot(missed, t > S::set1(0.0f));
+}
+
+template <typename S>
+typename S::Mask packet_intersect_sphere(const SpherePrimitive& sphere, const PacketRays<S>& rays, typename S::Float& t) {
+  using Float = typename S::Float;
+
+  Float local_origin[3], local_dir[3];
+  packet_to_local<S>(rays, sphere.location, sphere.inv_rotation, sphere.inv_scale, local_origin, local_dir);
+
+  Float a = packet_dot<S>(local_dir, local_dir);
+  Float b = S::set1(2.0f) * packet_dot<S>(local_origin, local_dir);
+  Float c = packet_dot<S>(local_origin, local_origin) - S::set1(1.0f);
+
+  Float discriminant = b * b - (S::set1(4.0f) * a) * c;
+  typename S::Mask valid = discriminant >= S::set1(0.0f);
+
+  // lanes that miss take the root of a negative number, but are masked off
+  Float sqrt_disc = S::sqrt(discriminant);
+  Float t0 = (-b - sqrt_disc) / (S::set1(2.0f) * a);
+  Float t1 = (-b + sqrt_disc) / (S::set1(2.0f) * a);
+  typename S::Mask swap = t0 > t1;
+  Float near_t = S::select(swap, t1, t0);
+  Float far_t = S::select(swap, t0, t1);
+
+  t = S::select(near_t < S::set1(0.0f), far_t, near_t);
+  return valid & (t >= S::set1(0.0f));
+}
+
+// packet version of the same_sign check in plane_contains
+template <typename S>
+typename S::Mask packet_same_sign(typename S::Float a, typename S::Float b) {
+  typename S::Float zero = S::set1(0.0f);
+  a = S::select(S::abs(a) < S::set1(PLANE_CONTAINS_TOLERANCE), zero, a);
+  b = S::select(S::abs(b) < S::set1(PLANE_CONTAINS_TOLERANCE), zero, b);
+  return ((a >= zero) & (b >= zero)) | ((a <= zero) & (b <= zero));
+}
+
+template <typename S>
+typename S::Mask packet_intersect_plane(const PlanePrimitive& plane, const PacketRays<S>& rays, typename S::Float& t) {
+  using Float = typename S::Float;
+
+  Float normal[3], p0l0[3];
+  for (int i = 0; i < 3; i++) {
+    normal[i] = S::set1(plane.normal[i]);
+    p0l0[i] = S::set1(plane.point[i]) - rays.origin[i];
+  }
+
+  // rays parallel to the plane or hitting behind their origin miss
+  Float denom = packet_dot<S>(rays.direction, normal);
+  t = packet_dot<S>(p0l0, normal) / denom;
+  typename S::Mask valid = S::andnot(S::abs(denom) < S::set1(1e-6f), t >= S::set1(0.0f));
+
+  for (int i = 0; i < 3; i++) {
+    Float ip = rays.origin[i] + t * rays.direction[i];
+    valid = valid & packet_same_sign<S>(ip - S::set1(plane.corners[0][i]), S::set1(plane.corners[3][i]) - ip);
+  }
+  return valid;
+}
+
+template <typename S>
+typename S::Mask packet_intersect_primitive(const PacketTraversalData& data, uint32_t reference,
+                                            const RayPacket& packet, const PacketRays<S>& rays,
+                                            typename S::Float closest, typename S::Float& t) {
+  // the reference is unpacked by hand, the helpers in Primitives.h are inline code built for
+  // the baseline instruction set
+  uint32_t index = reference & PRIMITIVE_INDEX_MASK;
+  switch (static_cast<MeshType>(reference >> PRIMITIVE_INDEX_BITS)) {
+    case MeshType::CUBE:   return packet_intersect_cube<S>(data.cubes[index], rays, t);
+    case MeshType::SPHERE: return packet_intersect_sphere<S>(data.spheres[index], rays, t);
+    case MeshType::PLANE:  return packet_intersect_plane<S>(data.planes[index], rays, t);
+    case MeshType::TRIANGLE_MESH: {
+      alignas(32) float distance[RAY_PACKET_SIZE];
+      S::store(distance, closest);
+      data.intersect_triangle_meshes(data.store, reference, packet, distance);
+      t = S::load(distance);
+      return t < S::set1(std::numeric_limits<float>::infinity());
+    }
+  }
+  t = S::set1(0.0f);
+  return S::none();
+}
+
+// the packet version of BoundingBoxHierarchyTree::check_intersect, every ray walks the tree together
+template <typename S>
+void traverse_packet(const PacketTraversalData& data, const RayPacket& packet, PacketHit& hit, RenderStatistics* statistics) {
+  using Float = typename S::Float;
+  using Mask = typename S::Mask;
+
+  PacketRays<S> rays;
+  for (int i = 0; i < 3; i++) {
+    rays.origin[i] = S::load(packet.origin[i]);
+    rays.direction[i] = S::load(packet.direction[i]);
+    rays.inv_direction[i] = S::load(packet.inv_direction[i]);
+  }
+  Float closest = S::load(hit.distance);
+  PacketInterval interval = make_packet_interval<S>(packet, hit.distance);
+
+  uint32_t stack[MAX_TRAVERSAL_STACK];
+  int stack_size = 0;
+  uint32_t node_index = 0;
+
+  while (true) {
+    const BoundingBoxNode& node = data.nodes[node_index];
+    statistics->node_visits += RAY_PACKET_SIZE;
+
+    // a box the packet's bounds miss is skipped with one scalar test, otherwise the packet
+    // enters a node if any of its rays do
+    Mask active = S::none();
+    if (packet_interval_intersect_node<S>(node, interval, packet.direction_is_negative)) {
+      active = packet_intersect_node<S>(node, rays, packet.direction_is_negative, closest);
+    }
+    if (S::movemask(active)) {
+      if (!node.is_leaf) {
+        // every ray shares its direction signs, so they agree on the near child
+        if (packet.direction_is_negative[node.axis]) {
+          stack[stack_size++] = node_index + 1;
+          node_index = node.offset;
+        } else {
+          stack[stack_size++] = node.offset;
+          node_index = node_index + 1;
+        }
+        continue;
+      }
+
+      for (uint32_t i = node.offset; i < node.offset + node.primitive_count; i++) {
+        statistics->primitive_tests[data.primitives[i] >> PRIMITIVE_INDEX_BITS] += RAY_PACKET_SIZE;
+        Float t;
+        Mask valid = packet_intersect_primitive<S>(data, data.primitives[i], packet, rays, closest, t);
+        Mask closer = valid & (t < closest) & active;
+        int lanes = S::movemask(closer);
+        if (lanes) {
+          closest = S::select(closer, t, closest);
+          for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            if (lanes & (1 << lane)) hit.primitive[lane] = data.primitives[i];
+          }
+
+          // the packet's bounds can only shrink once every ray has found something
+          alignas(32) float distances[RAY_PACKET_SIZE];
+          S::store(distances, closest);
+          interval.closest_max = packet_max_lane<S>(distances);
+        }
+      }
+    }
+
+    if (stack_size == 0) break;
+    node_index = stack[--stack_size];
+  }
+
+  S::store(hit.distance, closest);
+}
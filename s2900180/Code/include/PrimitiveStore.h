@@ -0,0 +1,160 @@
+/*
+PrimitiveStore.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Material.h"
+#include "Primitives.h"
+#include "TriangleMesh.h"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// forward declaration
+class Mesh;
+struct Hit;
+struct RayPacket;
+
+struct PrimitiveArrays {
+  /*
+    Views of the hot arrays of a store, in the order the primitives were added
+  */
+  std::span<const CubePrimitive> cubes;
+  std::span<const SpherePrimitive> spheres;
+  std::span<const PlanePrimitive> planes;
+  std::span<const TriangleMeshInstance> triangle_meshes;
+  std::span<const uint32_t> references;
+};
+
+class PrimitiveStore {
+  /*
+    Holds the geometry of every mesh in the scene, grouped by type into tightly packed
+    arrays of plain records, with the materials in their own table. Primitives are
+    referenced by a single value holding their type and index (see Primitives.h), and
+    the tests switch on the type rather than going through a virtual call.
+
+    Anything not needed for intersecting and shading (eg. names) is kept in a separate
+    metadata table, so the arrays walked by the traversal stay small.
+
+    The hot arrays are either owned by the store or borrowed from memory kept alive by
+    an owner, such as a memory mapped scene file (see SceneFile.h), so a compiled scene
+    is used without copying its primitives.
+
+    Triangle meshes are stored in two levels: each instance is a small record in the
+    hot arrays, which the scene's tree is built over, while the triangles and their own
+    tree live once per mesh in a shared TriangleMeshData.
+  */
+  public:
+    PrimitiveStore() = default;
+
+    // a store over borrowed arrays, with the meshes the instances point at and a material and
+    // name per metadata index. owner keeps the memory behind the arrays alive for as long as
+    // the store exists
+    PrimitiveStore(PrimitiveArrays arrays, std::vector<std::shared_ptr<const TriangleMeshData>> triangle_mesh_data,
+                   std::vector<Material> materials, std::vector<std::string> names, std::shared_ptr<const void> owner);
+
+    // the views point into the store, so it can be moved but not copied
+    PrimitiveStore(PrimitiveStore&&) = default;
+    PrimitiveStore& operator=(PrimitiveStore&&) = default;
+    PrimitiveStore(const PrimitiveStore&) = delete;
+    PrimitiveStore& operator=(const PrimitiveStore&) = delete;
+
+    // copies the geometry and material of a mesh into the store, returning its reference.
+    // only for stores that own their arrays
+    uint32_t add(Mesh& mesh);
+
+    // a store holding a copy of every mesh, in order
+    static PrimitiveStore from_meshes(const std::vector<std::unique_ptr<Mesh>>& meshes);
+
+    // distance only test of a single primitive, used while walking the tree. meshes skip
+    // anything past t_max, the closest hit so far, rather than walking their whole tree
+    bool intersect(uint32_t reference, const Ray& ray, float& t,
+                   float t_max = std::numeric_limits<float>::infinity()) const {
+      switch (primitive_type(reference)) {
+        case MeshType::CUBE:   return intersect_cube(_cubes[primitive_index(reference)], ray, t);
+        case MeshType::SPHERE: return intersect_sphere(_spheres[primitive_index(reference)], ray, t);
+        case MeshType::PLANE:  return intersect_plane(_planes[primitive_index(reference)], ray, t);
+        case MeshType::TRIANGLE_MESH: {
+          const TriangleMeshInstance& instance = _triangle_meshes[primitive_index(reference)];
+          return intersect_triangle_mesh(instance, *_triangle_mesh_data[instance.mesh_index], ray, t, t_max);
+        }
+      }
+      return false;
+    };
+
+    // whether the primitive blocks the ray before t_max
+    bool occluded(uint32_t reference, const Ray& ray, float t_max) const {
+      if (primitive_type(reference) == MeshType::TRIANGLE_MESH) {
+        // a mesh can stop at its first triangle in range rather than finding the closest
+        const TriangleMeshInstance& instance = _triangle_meshes[primitive_index(reference)];
+        return _triangle_mesh_data[instance.mesh_index]->occluded(to_instance_space(instance, ray), t_max);
+      }
+      float t;
+      return intersect(reference, ray, t) && t < t_max;
+    };
+
+    // runs the full test of a primitive, recording the normal, texture coordinates and material in the hit
+    bool check_intersect(uint32_t reference, const Ray& ray, Hit* hit) const;
+
+    // bounds and centroid of a primitive, used when building the tree
+    void get_bounds(uint32_t reference, Eigen::Vector3f& min, Eigen::Vector3f& max) const;
+    Eigen::Vector3f get_centroid(uint32_t reference) const;
+
+    // cold data
+    const std::string& get_name(uint32_t reference) const;
+
+    // every reference in the store, in the order they were added
+    std::span<const uint32_t> get_references() const { return _references; };
+
+    // getters
+    size_t size() const { return _references.size(); };
+    size_t get_number_of_materials() const { return _materials.size(); };
+    const Material& get_material(uint32_t material_index) const { return _materials[material_index]; };
+    const ShadingMaterial& get_shading_material(uint32_t material_index) const { return _shading_materials[material_index]; };
+    const std::string& get_name_by_index(uint32_t metadata_index) const { return _metadata[metadata_index].name; };
+    const std::vector<std::shared_ptr<const TriangleMeshData>>& get_triangle_mesh_data() const { return _triangle_mesh_data; };
+    PrimitiveArrays get_arrays() const { return {_cubes, _spheres, _planes, _triangle_meshes, _references}; };
+    const CubePrimitive* get_cubes() const { return _cubes.data(); };
+    const SpherePrimitive* get_spheres() const { return _spheres.data(); };
+    const PlanePrimitive* get_planes() const { return _planes.data(); };
+
+  private:
+    // returns the index into _metadata of a primitive
+    uint32_t metadata_index(uint32_t reference) const;
+
+    // hot data, one tightly packed array per type, viewing either the storage below or
+    // memory kept alive by _owner
+    std::span<const CubePrimitive> _cubes;
+    std::span<const SpherePrimitive> _spheres;
+    std::span<const PlanePrimitive> _planes;
+    std::span<const TriangleMeshInstance> _triangle_meshes;
+    std::span<const uint32_t> _references;
+    std::vector<Material> _materials;
+    std::vector<ShadingMaterial> _shading_materials; // _materials compiled for shade, what hits point at
+    std::vector<std::shared_ptr<const TriangleMeshData>> _triangle_mesh_data; // indexed by mesh_index
+    std::unordered_map<const TriangleMeshData*, uint32_t> _triangle_mesh_indices; // mesh_index of each mesh in add
+
+    std::vector<CubePrimitive> _cube_storage;
+    std::vector<SpherePrimitive> _sphere_storage;
+    std::vector<PlanePrimitive> _plane_storage;
+    std::vector<TriangleMeshInstance> _triangle_mesh_storage;
+    std::vector<uint32_t> _reference_storage;
+    std::shared_ptr<const void> _owner;
+
+    // cold data, only read when printing or looking up a primitive by name
+    struct PrimitiveMetadata {
+      std::string name;
+    };
+    std::vector<PrimitiveMetadata> _metadata;
+};
+
+// finds the distance to a triangle mesh of every ray in a packet, infinity where one misses. the
+// packet kernels call this for instances, walking the mesh's tree one ray at a time. distance
+// holds the closest hit of each ray so far on entry, and nothing past it is looked at
+void intersect_triangle_mesh_packet(const void* store, uint32_t reference, const RayPacket& packet, float* distance);
@@ -0,0 +1,206 @@
+/*
+Primitives.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Types.h"
+#include "Helpers.h"
+#include <Eigen/Dense>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+// forward declaration
+struct Hit;
+struct ShadingMaterial;
+
+enum class MeshType {
+  CUBE,
+  SPHERE,
+  PLANE,
+  TRIANGLE_MESH,
+};
+constexpr int NUMBER_OF_MESH_TYPES = 4; // for arrays indexed by MeshType
+constexpr float PLANE_CONTAINS_TOLERANCE = 1e-5f; // how far outside its corners a plane still counts a hit
+constexpr float PRIMITIVE_BOUNDS_PADDING = 10.0f * PLANE_CONTAINS_TOLERANCE; // added to every side of a primitive's box
+
+/*
+  Primitives are referenced by a single 32 bit value. The top bits hold the MeshType and
+  the rest hold the index into the array of that type.
+*/
+constexpr uint32_t PRIMITIVE_INDEX_BITS = 28;
+constexpr uint32_t PRIMITIVE_INDEX_MASK = (1u << PRIMITIVE_INDEX_BITS) - 1;
+constexpr uint32_t NO_PRIMITIVE = 0xffffffffu;
+
+inline uint32_t make_primitive_reference(MeshType type, uint32_t index) {
+  return (static_cast<uint32_t>(type) << PRIMITIVE_INDEX_BITS) | index;
+}
+
+inline MeshType primitive_type(uint32_t reference) {
+  return static_cast<MeshType>(reference >> PRIMITIVE_INDEX_BITS);
+}
+
+inline uint32_t primitive_index(uint32_t reference) {
+  return reference & PRIMITIVE_INDEX_MASK;
+}
+
+/*
+  The records below hold only plain floats, so they can be packed tightly into arrays.
+  Rotations are stored column major and precomputed once, rather than rebuilding the
+  matrix from euler angles on every intersection.
+*/
+struct CubePrimitive {
+  float translation[3];
+  float scale[3];
+  float inv_scale[3];
+  float rotation[9]; // local to world
+  float inv_rotation[9]; // world to local
+  uint32_t material_index;
+  uint32_t metadata_index;
+};
+
+struct SpherePrimitive {
+  float location[3];
+  float scale[3];
+  float inv_scale[3];
+  float rotation[9]; // local to world
+  float inv_rotation[9]; // world to local
+  uint32_t material_index;
+  uint32_t metadata_index;
+};
+
+struct PlanePrimitive {
+  float corners[4][3];
+  float point[3];
+  float normal[3];
+  float u_axis[3];
+  float v_axis[3];
+  float u_axis_squared_norm;
+  float v_axis_squared_norm;
+  uint32_t material_index;
+  uint32_t metadata_index;
+};
+
+// an instance of a triangle mesh, the triangles themselves are shared (see TriangleMesh.h)
+struct TriangleMeshInstance {
+  float translation[3];
+  float linear[9]; // local to world
+  float inv_translation[3];
+  float inv_linear[9]; // world to local
+  float min[3]; // world space bounds of the transformed mesh
+  float max[3];
+  uint32_t mesh_index;
+  uint32_t material_index;
+  uint32_t metadata_index;
+};
+
+// helpers to view the plain float arrays as Eigen types without copying
+inline Eigen::Map<const Eigen::Vector3f> as_vec3(const float* values) {
+  return Eigen::Map<const Eigen::Vector3f>(values);
+}
+
+inline Eigen::Map<const Eigen::Matrix3f> as_mat3(const float* values) {
+  return Eigen::Map<const Eigen::Matrix3f>(values);
+}
+
+// constructors for the records from the properties in the blender file
+CubePrimitive make_cube_primitive(Eigen::Vector3f translation, Eigen::Vector3f rotation, Eigen::Vector3f scale);
+SpherePrimitive make_sphere_primitive(Eigen::Vector3f location, Eigen::Vector3f rotation, Eigen::Vector3f scale);
+PlanePrimitive make_plane_primitive(const std::array<Eigen::Vector3f, 4>& corners);
+
+/*
+  Distance only intersection tests. These are what the traversal runs for every
+  primitive in a leaf, so they skip the normals and texture coordinates and return
+  the distance along the ray of a valid hit in t.
+*/
+inline bool intersect_cube(const CubePrimitive& cube, const Ray& ray, float& t) {
+  // rotate to local space, then scale into unit
+  Eigen::Vector3f local_origin = as_mat3(cube.inv_rotation) * (ray.origin - as_vec3(cube.translation));
+  Eigen::Vector3f local_direction = as_mat3(cube.inv_rotation) * ray.direction;
+  local_origin = local_origin.cwiseProduct(as_vec3(cube.inv_scale));
+  local_direction = local_direction.cwiseProduct(as_vec3(cube.inv_scale));
+
+  float t_min_curr = -std::numeric_limits<float>::infinity();
+  float t_max_curr = std::numeric_limits<float>::infinity();
+
+  // perform the 'slab test' against the unit cube
+  for (int i = 0; i < 3; ++i) {
+    if (std::abs(local_direction[i]) < 1e-6f) {
+      if (local_origin[i] < -0.5f || local_origin[i] > 0.5f) return false;
+    } else {
+      float inv_d = 1.0f / local_direction[i];
+      float t0 = (-0.5f - local_origin[i]) * inv_d;
+      float t1 = ( 0.5f - local_origin[i]) * inv_d;
+      if (t0 > t1) std::swap(t0, t1);
+      if (t0 > t_min_curr) t_min_curr = t0;
+      if (t1 < t_max_curr) t_max_curr = t1;
+      if (t_max_curr <= t_min_curr) return false;
+    }
+  }
+
+  t = (t_min_curr < 0) ? t_max_curr : t_min_curr;
+  return t > 0;
+}
+
+inline bool intersect_sphere(const SpherePrimitive& sphere, const Ray& ray, float& t) {
+  // rotate into local space, then turn ellipsoid into unit
+  Eigen::Vector3f local_origin = as_mat3(sphere.inv_rotation) * (ray.origin - as_vec3(sphere.location));
+  Eigen::Vector3f local_dir = as_mat3(sphere.inv_rotation) * ray.direction;
+  local_origin = local_origin.cwiseProduct(as_vec3(sphere.inv_scale));
+  local_dir = local_dir.cwiseProduct(as_vec3(sphere.inv_scale));
+
+  float a = local_dir.dot(local_dir);
+  float b = 2.0f * local_origin.dot(local_dir);
+  float c = local_origin.dot(local_origin) - 1.0f; // radius = 1 after scaling
+
+  float discriminant = b * b - 4.0f * a * c;
+  if (discriminant < 0.0f) return false;
+
+  float sqrt_disc = std::sqrt(discriminant);
+  float t0 = (-b - sqrt_disc) / (2.0f * a);
+  float t1 = (-b + sqrt_disc) / (2.0f * a);
+  if (t0 > t1) std::swap(t0, t1);
+
+  // nearest root in front of the ray
+  t = (t0 < 0) ? t1 : t0;
+  return t >= 0;
+}
+
+inline bool plane_contains(const PlanePrimitive& plane, const Eigen::Vector3f& ip) {
+  // check that the intersection point is within the bounds of the plane
+  auto same_sign = [](float a, float b, float tol = PLANE_CONTAINS_TOLERANCE) {
+    if (std::abs(a) < tol) a = 0.0f;
+    if (std::abs(b) < tol) b = 0.0f;
+
+    return (a >= 0 && b >= 0) || (a <= 0 && b <= 0);
+  };
+
+  Eigen::Vector3f v1 = ip - as_vec3(plane.corners[0]);
+  Eigen::Vector3f v2 = as_vec3(plane.corners[3]) - ip;
+
+  return same_sign(v1[0], v2[0]) && same_sign(v1[1], v2[1]) && same_sign(v1[2], v2[2]);
+}
+
+inline bool intersect_plane(const PlanePrimitive& plane, const Ray& ray, float& t) {
+  float denom = ray.direction.dot(as_vec3(plane.normal));
+  if (std::abs(denom) < 1e-6f) return false; // parallel
+
+  Eigen::Vector3f p0l0 = as_vec3(plane.point) - ray.origin;
+  t = p0l0.dot(as_vec3(plane.normal)) / denom;
+  if (t < 0) return false; // behind ray
+
+  return plane_contains(plane, ray.origin + t * ray.direction);
+}
+
+/*
+  Full intersection tests, which also find the normal and texture coordinates and
+  record them in the hit if it is the closest so far. Only run for the closest
+  primitive once a traversal is done, or by the Mesh classes directly.
+*/
+bool check_intersect_cube(const CubePrimitive& cube, const Ray& ray, const ShadingMaterial* material, Hit* hit);
+bool check_intersect_sphere(const SpherePrimitive& sphere, const Ray& ray, const ShadingMaterial* material, Hit* hit);
+bool check_intersect_plane(const PlanePrimitive& plane, const Ray& ray, const ShadingMaterial* material, Hit* hit);
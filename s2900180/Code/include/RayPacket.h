@@ -0,0 +1,72 @@
+/*
+RayPacket.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Primitives.h"
+#include "RenderStatistics.h"
+#include <cstdint>
+
+// forward declaration
+struct BoundingBoxNode;
+
+// constants
+constexpr int RAY_PACKET_SIZE = 8; // rays traced together, one per SIMD lane with AVX2
+
+struct RayPacket {
+  /*
+    A group of coherent rays stored as a structure of arrays, so one SIMD register holds
+    the same component of every ray. Packets are only built from rays whose directions
+    share signs on every axis, so the whole packet agrees on which child is nearer.
+  */
+  alignas(32) float origin[3][RAY_PACKET_SIZE];
+  alignas(32) float direction[3][RAY_PACKET_SIZE];
+  alignas(32) float inv_direction[3][RAY_PACKET_SIZE];
+  int direction_is_negative[3];
+};
+
+struct PacketHit {
+  /*
+    The closest hit of every ray in a packet, as the distance along the ray and the
+    primitive hit (NO_PRIMITIVE on a miss). The full details are found afterwards.
+  */
+  alignas(32) float distance[RAY_PACKET_SIZE];
+  uint32_t primitive[RAY_PACKET_SIZE];
+};
+
+// finds the distance to one triangle mesh instance of every ray in a packet, infinity on a miss.
+// distance holds the closest hit of each ray so far on entry. meshes walk their own tree,
+// which is left to baseline code (see intersect_triangle_mesh_packet)
+using TriangleMeshPacketFunction = void (*)(const void* store, uint32_t reference, const RayPacket& packet,
+                                            float* distance);
+
+struct PacketTraversalData {
+  /*
+    Plain pointers to everything the packet traversal reads, so the SIMD kernels only
+    ever see plain data.
+  */
+  const BoundingBoxNode* nodes;
+  const uint32_t* primitives;
+  const CubePrimitive* cubes;
+  const SpherePrimitive* spheres;
+  const PlanePrimitive* planes;
+  const void* store; // handed back to intersect_triangle_meshes
+  TriangleMeshPacketFunction intersect_triangle_meshes;
+};
+
+// finds the closest hit of every ray in a packet, updating hit where a closer one is found
+using PacketTraversalFunction = void (*)(const PacketTraversalData& data, const RayPacket& packet,
+                                         PacketHit& hit, RenderStatistics* statistics);
+
+// the implementations available, each built from the same kernels with a different SIMD width
+void traverse_packet_scalar(const PacketTraversalData& data, const RayPacket& packet, PacketHit& hit, RenderStatistics* statistics);
+void traverse_packet_sse(const PacketTraversalData& data, const RayPacket& packet, PacketHit& hit, RenderStatistics* statistics);
+void traverse_packet_avx2(const PacketTraversalData& data, const RayPacket& packet, PacketHit& hit, RenderStatistics* statistics);
+
+// picks the widest implementation the current CPU supports, checked once at runtime
+PacketTraversalFunction select_packet_traversal();
+
+// name of the implementation picked by select_packet_traversal, for printing
+const char* get_packet_traversal_name();
@@ -3,30 +3,62 @@
 #include <string>
 #include <memory> 
 #include "Image.h"
+#include "Framebuffer.h"
 #include "BlenderFileReader.h"
+#include "SceneFile.h"
+#include "BoundingBoxCache.h"
 #include "Camera.h"
+#include "CameraRayGenerator.h"
 #include "Mesh.h"
 #include <algorithm>
 #include <stdlib.h>
 #include <random>
+#include <optional>
 #include "Light.h"
+#include "LightGrid.h"
+#include "ShadowCache.h"
+#include "RenderStatistics.h"
 #include "AccelerationHierarchy.h"
+#include "ThreadPool.h"
+#include "Wavefront.h"
+#include <chrono>
 
 const Eigen::Vector3f blender_background = {70.0f, 70.0f, 70.0f};
 const int amount_of_antialiasing_samples_per_pixel = 1; // make this a setting
+const int ADAPTIVE_BASE_SAMPLES = 4; // fewest samples an adaptive pixel starts with, enough to judge its variance
 
 struct RayTracerSettings 
 {
     std::string input_filename = std::string("No input filename detected. use --input flag");
     std::string output_filename = std::string("No output filename detected. use --output flag");
     int amount_of_antialiasing_samples_per_pixel = 1;
+    SamplerType sampler = SamplerType::SOBOL; // places the antialiasing samples within each pixel
+    bool use_adaptive_sampling = false; // spend more samples only on the noisy pixels, see render_tile_adaptive
+    float noise_threshold = 2.0f; // standard error in 0-255 brightness a pixel stops sampling below
+    int max_samples_per_pixel = 64; // most samples an adaptive pixel is given, or progressive passes made
+    bool use_progressive_rendering = false; // refine the whole image a pass at a time, see render_progressive
+    int time_budget_ms = 0; // progressive renders stop once this is spent, 0 for no limit
+    int dump_interval_ms = 0; // progressive renders write the image so far this often, 0 for never
     int max_depth_of_reflection_recursion = 1;
+    float light_cutoff = 0.0f; // 0-255 brightness a light must be able to add to a point to be shaded, 0 for every light
+    int light_samples = 0; // most lights shaded per point, picked by their estimated brightness, 0 for all of them
+    int number_of_threads = 0; // 0 uses every hardware thread
+    int tile_size = 16; // width and height of the square tiles handed out to the threads
+    BoundingBoxBuilder bounding_box_builder = BoundingBoxBuilder::SAH;
+    int bounding_box_width = WIDE_NODE_WIDTH; // children per node walked by single rays, 2 or 4
+    bool use_ray_packets = true; // trace primary rays in SIMD packets
+    bool use_wavefront = false; // trace each tile a stage at a time over queues of rays, see render_tile_wavefront
+    std::string bounding_box_cache_directory; // set by --bvh-cache, built trees are kept here, see BoundingBoxCache.h
+    bool use_shadow_cache = true; // try the last blocker of each light before walking the tree, see ShadowCache.h
+    std::optional<ImageFormat> output_format; // picked from the output filename when not given
+    std::string compiled_scene_filename; // set by --compile-scene, the input is compiled here instead of rendered
+    std::string stats_json_filename; // the render statistics are also written here as JSON, when given
 };
 
 class RayTracer 
 {
     public:
-        RayTracer() : _bbht(nullptr) {
+        RayTracer() : _bbht(nullptr), _camera_rays(nullptr) {
             std::cout << "[     James Hocking's RAYTRACER     ]" << std::endl;
         };
 
@@ -43,14 +75,90 @@ class RayTracer
         void setup();
 
         /*
-        Function that iterates through every pixel in an image, creates a ray and projects it 
-        onto the scene.
+        This function reads the input blender file and writes it out as a compiled scene, which
+        later runs can take as their --input instead.
+        */
+        void compile_scene();
+
+        // whether the command line asked for compile_scene rather than a render
+        bool is_compiling_scene() { return !_ray_tracer_settings.compiled_scene_filename.empty(); };
+
+        /*
+        Function that splits the image into tiles and renders them across a pool of threads. 
+        Each tile creates its rays and projects them onto the scene.
         */
         void render_image();
 
     private:
+        /*
+        Function that renders the pixels of one tile, [x_start, x_end) by [y_start, y_end), firing 
+        every antialiasing sample and writing the averaged colours to the framebuffer. The primary rays 
+        are generated into buffer a whole tile at a time. Only reads shared state, so it can be 
+        called from any thread, with a buffer, shadow_cache (nullptr when off) and statistics of that
+        thread's own.
+        */
+        void render_tile(Framebuffer& framebuffer, int x_start, int y_start, int x_end, int y_end,
+                         CameraRayBuffer& buffer, ShadowCache* shadow_cache, RenderStatistics* statistics);
+
+        /*
+        The adaptive version of render_tile. Every pixel first gets a few base samples (the
+        antialiasing count, but at least ADAPTIVE_BASE_SAMPLES), then the pixels whose standard
+        error is still above the noise threshold keep doubling their samples until they drop
+        below it or reach the maximum. Returns the number of samples traced.
+        */
+        long long render_tile_adaptive(Framebuffer& framebuffer, int x_start, int y_start, int x_end, int y_end,
+                                       CameraRayBuffer& buffer, ShadowCache* shadow_cache, RenderStatistics* statistics);
+
+        /*
+        Wavefront version of render_tile, giving the same image. Rather than shading each
+        sample recursively, every sample of the tile is a path, and the paths go through
+        one stage at a time: all their rays are intersected, all the hits are shaded into
+        shadow rays and reflection rays, all the shadow rays are tested, then the
+        reflections start the next bounce. The shadow and reflection queues are sorted
+        first, so rays that follow each other walk the same part of the tree and runs of
+        them with matching signs travel as packets. state holds the queues and the
+        paths, and is reused between the tiles of one worker.
+        */
+        void render_tile_wavefront(Framebuffer& framebuffer, int x_start, int y_start, int x_end, int y_end,
+                                   CameraRayBuffer& buffer, WavefrontState& state, RenderStatistics* statistics);
+
+        /*
+        Progressive version of the tile loop. Every pass adds one sample to each pixel, the
+        first through the pixel corners (matching a 1 spp render) and the rest jittered, and
+        the samples accumulate in sums with a running count per pixel. Passes repeat until
+        the time budget runs out or every pixel has max_samples_per_pixel. Tiles not started
+        before the deadline are skipped, so a pass can stop part way and the image just
+        resolves each pixel by its own count. With adaptive sampling, tiles whose pixels are
+        all below the noise threshold stop taking part. Writes the resolved image into
+        framebuffer, returning the number of passes started.
+        */
+        int render_progressive(Framebuffer& framebuffer, WorkStealingThreadPool& pool,
+                               std::vector<CameraRayBuffer>& ray_buffers, std::vector<ShadowCache>& shadow_caches,
+                               std::vector<RenderStatistics>& statistics);
+
+        // resolves the accumulated samples of every pixel into framebuffer
+        void resolve_progressive(const Framebuffer& sums, const std::vector<SampleVariance>& variances,
+                                 const std::vector<char>& is_hit, Framebuffer& framebuffer);
+
+        // traces the primary rays of a whole tile in buffer, writing each pixel's shaded colour
+        // (zero on a miss) and whether it hit into colours and is_hit
+        void trace_tile(int width, int height, const CameraRayBuffer& buffer,
+                        std::vector<Eigen::Vector3f>& colours, std::vector<char>& is_hit,
+                        ShadowCache* shadow_cache, RenderStatistics* statistics);
+
+        // builds the tree over the store, or reads it from the cache when allowed
+        void build_tree(PrimitiveStore store);
+
+        // helpers for render_tile, shading the hit of a primary ray into rgb255 and averaging the
+        // samples into the final colour
+        Eigen::Vector3f shade_sample(Hit* hit, const Ray& ray, ShadowCache* shadow_cache, RenderStatistics* statistics);
+        Eigen::Vector3f resolve_pixel(Eigen::Vector3f overall_shade, int samples, bool is_hit);
+
         CameraProperties _props;
         RayTracerSettings _ray_tracer_settings;
         std::vector<Light> _lights;
+        std::unique_ptr<LightGrid> _light_grid;
         std::unique_ptr<BoundingBoxHierarchyTree> _bbht;
+        std::unique_ptr<CameraRayGenerator> _camera_rays;
+        RenderReport _report; // filled in as the phases finish, printed at the end of render_image
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+/*
+RenderStatistics.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Primitives.h"
+#include <chrono>
+#include <string>
+
+enum class RayType {
+  PRIMARY, // from the camera
+  SHADOW, // towards a light
+  REFLECTION, // mirrored off a hit
+};
+constexpr int NUMBER_OF_RAY_TYPES = 3;
+
+enum class RenderPhase {
+  LOAD, // reading the scene and its textures
+  BUILD, // building or reading back the bounding box tree
+  RENDER,
+  WRITE, // writing the image
+};
+constexpr int NUMBER_OF_RENDER_PHASES = 4;
+
+struct alignas(64) RenderStatistics {
+  /*
+    Counts of the work done by one thread. Every thread counts into its own, each on a
+    cache line of its own so the threads never write to a shared line, and they are
+    added together once the frame is done. The counters are 64 bit, so they do not
+    overflow on large renders.
+
+    A packet counts RAY_PACKET_SIZE node visits and primitive tests for each step it
+    takes together, as every lane does the work, so the counts compare with single rays.
+  */
+  long long rays[NUMBER_OF_RAY_TYPES] = {};
+  long long ray_hits[NUMBER_OF_RAY_TYPES] = {}; // primary and reflection rays that hit, shadow rays that were blocked
+  long long node_visits = 0;
+  long long primitive_tests[NUMBER_OF_MESH_TYPES] = {}; // indexed by MeshType
+  long long shadow_cache_lookups = 0; // shadow rays with a remembered blocker to try, see ShadowCache.h
+  long long shadow_cache_hits = 0; // of those, ones the remembered blocker still blocked
+
+  // function that counts one traced ray, and whether it hit (or for a shadow ray, was blocked)
+  void add_ray(RayType type, bool is_hit) {
+    rays[static_cast<int>(type)]++;
+    ray_hits[static_cast<int>(type)] += is_hit;
+  };
+
+  // adds the counts of another thread
+  void add(const RenderStatistics& other);
+
+  long long get_total_rays() const;
+  long long get_total_primitive_tests() const;
+};
+
+struct RenderReport {
+  /*
+    Everything measured over one render, the statistics of every thread added together
+    with the time spent in each phase. Printed at the end of a render, and written as
+    JSON when --stats-json is given.
+  */
+  std::string input_filename;
+  int width = 0;
+  int height = 0;
+  int threads = 0;
+  int samples_per_pixel = 0;
+  RenderStatistics statistics;
+  double phase_milliseconds[NUMBER_OF_RENDER_PHASES] = {};
+
+  // millions of rays of every type traced per second of the render phase
+  double get_mrays_per_second() const;
+};
+
+// milliseconds since start, for timing the phases
+inline double get_milliseconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// writes the report to std::cout
+void print_render_report(const RenderReport& report);
+
+// writes the report as JSON to filepath
+void write_render_report(const std::string& filepath, const RenderReport& report);
@@ -0,0 +1,47 @@
+/*
+Sampler.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include <cstdint>
+
+enum class SamplerType {
+  RANDOM, // white noise from a hash
+  R2, // Roberts' R2 sequence, shifted per pixel
+  SOBOL, // Sobol sequence with hashed Owen scrambling and a shuffled order per pixel
+};
+
+class Sampler {
+  /*
+    Gives the sample values used to place rays within a pixel. A value only depends on
+    the pixel, the sample index and the dimension (0 for x, 1 for y, and so on), so
+    samples need no state and come out the same whichever thread or order asks for them.
+
+    The low discrepancy sequences spread the samples of a pixel evenly rather than at
+    random, so the same noise is reached with fewer of them. Each pixel gets its own
+    scramble or shift of the sequence, which keeps neighbouring pixels unrelated and
+    turns the structured error into noise.
+  */
+  public:
+    Sampler(SamplerType type = SamplerType::SOBOL) : _type(type) {};
+
+    // value in [0, 1) for one dimension of one sample of the pixel (px, py)
+    float get(int px, int py, int sample_index, int dimension) const;
+
+    // getters
+    SamplerType get_type() const { return _type; };
+
+  private:
+    SamplerType _type;
+};
+
+// sample values of each kind, as used by Sampler::get
+float random_sample(int px, int py, int sample_index, int dimension);
+float r2_sample(int px, int py, int sample_index, int dimension);
+float sobol_sample(int px, int py, int sample_index, int dimension);
+
+// the sampler named on the command line, "random", "r2" or "sobol"
+SamplerType sampler_type_from_name(const char* name);
+const char* get_sampler_name(SamplerType type);
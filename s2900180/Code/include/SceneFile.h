@@ -0,0 +1,180 @@
+/*
+SceneFile.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Camera.h"
+#include "Light.h"
+#include "PrimitiveStore.h"
+#include "Texture.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+A compiled scene (.rtscene) holds the camera, lights, materials and primitives of a scene
+in the layout the renderer uses them, so it can be memory mapped and rendered without
+parsing. Every value is little endian, and each section starts on a 16 byte boundary:
+
+  SceneFileHeader
+  CAMERA      one SceneFileCamera
+  LIGHTS      SceneFileLight per light
+  MATERIALS   SceneFileMaterial per material, one per mesh in the order they were read
+  STRINGS     the names and texture paths the materials point into
+  CUBES       CubePrimitive records, as in a PrimitiveStore
+  SPHERES     SpherePrimitive records
+  PLANES      PlanePrimitive records
+  TRIANGLE_MESH_INSTANCES   TriangleMeshInstance records
+  TRIANGLE_MESHES           SceneFileTriangleMesh per mesh the instances share
+  TRIANGLE_MESH_FLOATS      the positions, normals and uvs the meshes point into
+  TRIANGLE_MESH_INDICES     the uint32_t vertex indices of their triangles
+  REFERENCES  uint32_t primitive references, in the order they were added
+
+The instances are mapped like the other primitives. The meshes are copied out of the
+file, as the tree over their triangles is built again when they are read.
+
+The version goes up whenever any of these records change, older files are then rejected
+and need compiling again.
+*/
+const char SCENE_FILE_MAGIC[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+const uint32_t SCENE_FILE_VERSION = 2;
+const uint32_t SCENE_FILE_BYTE_ORDER_MARK = 0x01020304;
+const size_t SCENE_FILE_ALIGNMENT = 16;
+
+enum SceneFileSectionId {
+  CAMERA_SECTION,
+  LIGHTS_SECTION,
+  MATERIALS_SECTION,
+  STRINGS_SECTION,
+  CUBES_SECTION,
+  SPHERES_SECTION,
+  PLANES_SECTION,
+  TRIANGLE_MESH_INSTANCES_SECTION,
+  TRIANGLE_MESHES_SECTION,
+  TRIANGLE_MESH_FLOATS_SECTION,
+  TRIANGLE_MESH_INDICES_SECTION,
+  REFERENCES_SECTION,
+  NUMBER_OF_SCENE_FILE_SECTIONS
+};
+
+struct SceneFileSection {
+  uint64_t offset; // in bytes from the start of the file
+  uint64_t count; // in records, or bytes for the strings
+};
+
+struct SceneFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order; // SCENE_FILE_BYTE_ORDER_MARK as written by the compiling machine
+  SceneFileSection sections[NUMBER_OF_SCENE_FILE_SECTIONS];
+};
+
+struct SceneFileCamera {
+  float location[3];
+  float gaze_vector_direction[3];
+  float up_vector[3];
+  uint32_t sensor_fit;
+  float focal_length;
+  float sensor_width;
+  float sensor_height;
+  float resolution_x;
+  float resolution_y;
+};
+
+struct SceneFileLight {
+  float location[3];
+  float id;
+  float is;
+};
+
+// a string within the STRINGS section, an empty one means none
+struct SceneFileString {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct SceneFileMaterial {
+  float ka;
+  float kd;
+  float ks;
+  float shininess;
+  float reflectivity;
+  float transparancy;
+  float ior;
+  int32_t base_colour[3];
+  SceneFileString name;
+  SceneFileString texture_path;
+};
+
+// a mesh as runs of TRIANGLE_MESH_FLOATS and TRIANGLE_MESH_INDICES, counted in values
+struct SceneFileTriangleMesh {
+  SceneFileString name;
+  uint32_t vertex_count;
+  uint32_t triangle_count;
+  uint32_t has_normals;
+  uint32_t has_uvs;
+  uint64_t positions_offset;
+  uint64_t normals_offset;
+  uint64_t uvs_offset;
+  uint64_t indices_offset;
+};
+
+class MappedFile {
+  /*
+    A whole file mapped read only into memory, unmapped again on destruction.
+  */
+  public:
+    MappedFile(const std::string& filepath);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // getters
+    const std::byte* data() const {return _data;};
+    size_t size() const {return _size;};
+
+  private:
+    const std::byte* _data = nullptr;
+    size_t _size = 0;
+};
+
+struct CompiledScene {
+  /*
+    Everything read from a compiled scene. The primitives of the store point straight
+    into the mapped file, which the store keeps alive.
+  */
+  Camera camera;
+  std::vector<Light> lights;
+  PrimitiveStore store;
+};
+
+class SceneFileReader {
+  /*
+    Reads compiled scenes, the counterpart of BlenderFileReader for .rtscene files.
+  */
+  public:
+    SceneFileReader(std::string filepath) : _filepath(filepath) {;};
+
+    // function that maps the file, checks its header and creates the scene from it.
+    // textures are read in the background, as with BlenderFileReader
+    CompiledScene load_scene();
+
+    // function that blocks until every texture of the scene has been read
+    void wait_for_textures();
+
+  private:
+    std::string _filepath;
+    TextureCache _texture_cache;
+};
+
+// function that writes a scene into a compiled scene file. the textures of the store must have
+// finished reading
+void write_scene_file(const std::string& filepath, const CameraProperties& camera, const std::vector<Light>& lights,
+                      const PrimitiveStore& store);
+
+// whether the path names a compiled scene, going by its extension
+bool is_scene_file(const std::string& filepath);
@@ -0,0 +1,33 @@
+/*
+ShadowCache.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "AccelerationHierarchy.h"
+#include "Primitives.h"
+#include "Types.h"
+#include <cstdint>
+#include <vector>
+
+class ShadowCache {
+  /*
+    Remembers, for each light, the last primitive that blocked a shadow ray towards
+    it. Neighbouring points tend to be shadowed by the same mesh, so that primitive
+    is tested first and the walk down the tree is only needed when it no longer
+    blocks the ray. The answer is always the same as the tree's, only cheaper.
+
+    The cache is changed by every query, so each thread keeps its own. How often it
+    is tried and how often it is right are counted in the thread's statistics.
+  */
+  public:
+    ShadowCache(size_t number_of_lights = 0) : _occluders(number_of_lights, NO_PRIMITIVE) {};
+
+    // function that checks whether anything blocks ray before t_max, trying light_index's last blocker first
+    bool occluded(const BoundingBoxHierarchyTree& tree, const Ray& ray, float t_max, uint32_t light_index,
+                  RenderStatistics* statistics);
+
+  private:
+    std::vector<uint32_t> _occluders; // per light, NO_PRIMITIVE when its last shadow ray was not blocked
+};
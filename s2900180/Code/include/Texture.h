@@ -0,0 +1,126 @@
+/*
+Texture.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// forward declaration
+class PPMImageFile;
+
+// texels are stored in square tiles of this many texels a side, so the four texels of a
+// bilinear lookup almost always sit next to each other in memory
+const int TEXTURE_TILE_SIZE = 4;
+const int TEXELS_PER_TEXTURE_TILE = TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE;
+
+enum class TexelFormat {
+  RGB8, // three bytes per texel, for ppm files
+  HALF_RGB // three half floats per texel, for pfm files, so values above 1 survive
+};
+
+struct TextureLevel {
+  /*
+    One level of the mip chain, each half the size of the one before it down to 1x1.
+    Its texels start at offset within the texture's storage and are laid out tile by
+    tile, row major, with the texels inside a tile also row major.
+  */
+  int width;
+  int height;
+  int tiles_x;
+  size_t offset;
+
+  // position of a texel of this level within the texture's storage, in texels
+  size_t texel_index(int px, int py) const {
+    size_t tile = static_cast<size_t>(py / TEXTURE_TILE_SIZE) * tiles_x + px / TEXTURE_TILE_SIZE;
+    return offset + tile * TEXELS_PER_TEXTURE_TILE
+                  + (py % TEXTURE_TILE_SIZE) * TEXTURE_TILE_SIZE + px % TEXTURE_TILE_SIZE;
+  };
+};
+
+class Texture {
+  /*
+    The texels of an image texture and its mip chain, packed in the smallest format that
+    keeps what the file holds. Read only once built, so one texture is shared by every 
+    material (and thread) that uses it.
+  */
+  public:
+    // an empty texture, for a TextureCache to move the real one into once it is read
+    Texture() = default;
+
+    // builds the texture from an image that has already been read
+    Texture(const PPMImageFile& image);
+
+    // reads the image at the path and builds the texture from it
+    static std::shared_ptr<const Texture> from_file(const std::string& path);
+
+    // colour in the 0-1 shading region at (u, v), where both are within [0, 1]. lod is the
+    // mip level to read, fractions blend the two nearest levels and 0 is the full image
+    Eigen::Vector3f sample(float u, float v, float lod = 0.0f) const;
+
+    // mip level that matches a footprint the given fraction of the texture wide
+    float get_lod(float uv_footprint) const;
+
+    // colour of one texel of a level
+    Eigen::Vector3f get_texel(int px, int py, int level = 0) const;
+
+    // getters
+    int get_width() const {return _levels[0].width;};
+    int get_height() const {return _levels[0].height;};
+    int get_number_of_levels() const {return static_cast<int>(_levels.size());};
+    TexelFormat get_format() const {return _format;};
+    const std::string& get_path() const {return _path;};
+    size_t get_size_in_bytes() const {return _rgb8.size() + _half.size() * sizeof(uint16_t);};
+
+  private:
+    // packs the rgb values of a level, given row by row, into its tiles
+    void store_level(int level, const std::vector<float>& values);
+
+    // bilinear lookup within one level
+    Eigen::Vector3f sample_level(float u, float v, int level) const;
+
+    std::string _path; // of the file it was read from
+    std::vector<TextureLevel> _levels;
+    TexelFormat _format = TexelFormat::RGB8;
+
+    // only the one matching _format is filled
+    std::vector<uint8_t> _rgb8;
+    std::vector<uint16_t> _half;
+};
+
+class TextureCache {
+  /*
+    Every texture of a scene, keyed by the canonical path of its file, so materials that
+    share an image (whichever way the path is written) share one copy of its texels.
+
+    Files are read and mipmapped in the background, so the scene can carry on loading
+    (and building its bounding box tree) meanwhile. The textures handed out stay empty
+    until wait returns, and must not be sampled before then.
+  */
+  public:
+    // the texture of the file at the path, which starts reading on first use
+    std::shared_ptr<const Texture> get(const std::string& path);
+
+    // blocks until every texture requested so far has been read, rethrowing any read error
+    void wait();
+
+    // amount of distinct textures requested so far
+    size_t size() const;
+
+  private:
+    mutable std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Texture>> _textures;
+    std::vector<std::future<void>> _pending;
+};
+
+// conversion between float and IEEE half precision, rounding to the nearest half
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
@@ -0,0 +1,42 @@
+/*
+ThreadPool.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class WorkStealingThreadPool {
+  /*
+  A pool of worker threads where every worker owns its own queue of task indices.
+  Workers take tasks from the front of their own queue and, once it is empty, steal
+  from the back of another worker's queue. This keeps every core busy even when some
+  tasks (eg. tiles full of reflective meshes) take much longer than others.
+  */
+  public:
+    // a value <= 0 uses every hardware thread available
+    WorkStealingThreadPool(int number_of_threads);
+
+    // calls task(task_index, worker_index) once for every task index, blocking until all are done
+    void run(int number_of_tasks, const std::function<void(int, int)>& task);
+
+    // getters
+    int get_number_of_threads() { return _number_of_threads; };
+
+  private:
+    struct WorkerQueue {
+      std::mutex mutex;
+      std::deque<int> tasks;
+    };
+
+    // finds the next task for a worker, returns false once there is no work left anywhere
+    bool next_task(int worker_index, int& task_index);
+
+    int _number_of_threads;
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+};
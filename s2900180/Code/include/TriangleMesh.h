@@ -0,0 +1,127 @@
+/*
+TriangleMesh.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Primitives.h"
+#include "Types.h"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// constants
+constexpr int TRIANGLE_MESH_MAX_LEAF_SIZE = 4; // triangles per leaf of a mesh's own tree
+constexpr int TRIANGLE_MESH_MAX_DEPTH = 48; // leaves room on the traversal stack
+
+struct TriangleMeshNode {
+  /*
+    A node of the tree over the triangles of one mesh, laid out like BoundingBoxNode. The
+    first child of an inner node follows it, offset holds the second. A leaf holds the
+    triangles from offset.
+  */
+  float min[3];
+  float max[3];
+  uint32_t offset;
+  uint16_t triangle_count;
+  uint8_t axis;
+  uint8_t is_leaf;
+};
+
+struct TriangleHit {
+  /*
+    Where a ray hit a mesh, as the triangle and the barycentric coordinates of the point
+    within it, so the surface is only interpolated for the closest hit.
+  */
+  float distance;
+  uint32_t triangle;
+  float b1;
+  float b2;
+};
+
+class TriangleMeshData {
+  /*
+    The geometry of a triangle mesh in its own local space: shared vertex positions with
+    optional normals and texture coordinates, and three indices into them per triangle.
+    A tree over the triangles (the bottom level) is built once when the data is created.
+
+    The data never changes afterwards, so any number of instances share one copy of it
+    and place it in the scene with their own transform (see TriangleMeshInstance).
+  */
+  public:
+    // checks every index lies within the vertices and builds the tree. normals and uvs
+    // are either empty or hold one entry per vertex
+    TriangleMeshData(std::string name, std::vector<float> positions, std::vector<float> normals,
+                     std::vector<float> uvs, std::vector<uint32_t> indices);
+
+    // closest triangle hit by a ray in local space before t_max
+    bool intersect(const Ray& ray, float t_max, TriangleHit& hit) const;
+
+    // whether any triangle blocks a ray in local space before t_max
+    bool occluded(const Ray& ray, float t_max) const;
+
+    // the interpolated local normal and texture coordinates at a hit. without normals the
+    // face normal is used, and without uvs both are -1 so no texture is sampled
+    void get_surface(const TriangleHit& hit, Eigen::Vector3f& normal, float& u, float& v) const;
+
+    // the corners of a triangle in local space, and their texture coordinates if the mesh has any
+    void get_corners(uint32_t triangle, Eigen::Vector3f corners[3]) const;
+    bool get_corner_uvs(uint32_t triangle, Eigen::Vector2f uvs[3]) const;
+
+    // getters
+    const std::string& get_name() const {return _name;};
+    size_t get_number_of_vertices() const {return _positions.size() / 3;};
+    size_t get_number_of_triangles() const {return _indices.size() / 3;};
+    const std::vector<float>& get_positions() const {return _positions;};
+    const std::vector<float>& get_normals() const {return _normals;};
+    const std::vector<float>& get_uvs() const {return _uvs;};
+    const std::vector<uint32_t>& get_indices() const {return _indices;};
+    const Eigen::Vector3f& get_min_bound() const {return _min_bound;};
+    const Eigen::Vector3f& get_max_bound() const {return _max_bound;};
+
+  private:
+    // splits the triangles from first to last at the median of the widest axis, returning the node
+    uint32_t build(std::vector<uint32_t>& order, std::vector<Eigen::Vector3f>& centroids, uint32_t first,
+                   uint32_t last, int depth);
+
+    // Möller–Trumbore test of one triangle, keeping it in hit if it is closer
+    bool intersect_triangle(uint32_t triangle, const Ray& ray, TriangleHit& hit) const;
+
+    Eigen::Vector3f get_position(uint32_t vertex) const {
+      return Eigen::Vector3f(_positions[3*vertex], _positions[3*vertex + 1], _positions[3*vertex + 2]);
+    };
+
+    std::string _name;
+    std::vector<float> _positions;
+    std::vector<float> _normals;
+    std::vector<float> _uvs;
+    std::vector<uint32_t> _indices; // reordered so each leaf holds a run of triangles
+    std::vector<TriangleMeshNode> _nodes;
+    Eigen::Vector3f _min_bound;
+    Eigen::Vector3f _max_bound;
+};
+
+// constructor for an instance record placing a mesh in the scene by its 4x4 local to world matrix
+TriangleMeshInstance make_triangle_mesh_instance(const Eigen::Matrix4f& matrix_world, const TriangleMeshData& mesh);
+
+// moves a world space ray into the local space of an instance, keeping distances along it the same
+Ray to_instance_space(const TriangleMeshInstance& instance, const Ray& ray);
+
+/*
+  The instance tests, as in Primitives.h. The ray is moved into the local space of the
+  mesh and walks its tree there, the direction is not normalised so distances agree and
+  t_max, the closest hit found so far in the scene, culls the mesh's tree unchanged.
+*/
+inline bool intersect_triangle_mesh(const TriangleMeshInstance& instance, const TriangleMeshData& mesh,
+                                    const Ray& ray, float& t,
+                                    float t_max = std::numeric_limits<float>::infinity()) {
+  TriangleHit hit;
+  if (!mesh.intersect(to_instance_space(instance, ray), t_max, hit)) return false;
+  t = hit.distance;
+  return true;
+}
+
+bool check_intersect_triangle_mesh(const TriangleMeshInstance& instance, const TriangleMeshData& mesh,
+                                   const Ray& ray, const ShadingMaterial* material, Hit* hit);
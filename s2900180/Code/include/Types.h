@@ -1,10 +1,26 @@
 #pragma once
 #include <Eigen/Dense>
 #include <iostream>
+#include <limits>
 
 struct Ray {
-    Eigen::Vector3f origin;
-    Eigen::Vector3f direction;
+    Eigen::Vector3f origin = Eigen::Vector3f::Zero();
+    Eigen::Vector3f direction = Eigen::Vector3f::Zero();
+
+    // precomputed once per ray for the slab tests against the bounding boxes. a default ray
+    // keeps them matching its zero direction, so a traversal never reads garbage
+    Eigen::Vector3f inv_direction = Eigen::Vector3f::Constant(std::numeric_limits<float>::infinity());
+    int direction_is_negative[3] = {0, 0, 0};
+
+    Ray() {};
+    Ray(Eigen::Vector3f ray_origin, Eigen::Vector3f ray_direction)
+        : origin(ray_origin), direction(ray_direction) {
+        // a zero component gives an infinite inverse, which the slab tests rely on
+        inv_direction = direction.cwiseInverse();
+        for (int i = 0; i < 3; i++) {
+            direction_is_negative[i] = inv_direction[i] < 0.0f;
+        }
+    };
 
     void print() {
         std::cout << "Origin:\n" << origin << std::endl;
@@ -0,0 +1,90 @@
+/*
+Wavefront.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Light.h"
+#include "ShadowCache.h"
+#include "Types.h"
+#include <Eigen/Dense>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// constants
+constexpr int RAY_SORT_BITS_PER_AXIS = 10; // quantisation of the origins and directions in a sort key
+
+class RayQueue {
+  /*
+    A batch of rays waiting for the same stage of the wavefront renderer, stored as one
+    array of rays (so runs of them can be handed to check_intersect_packet) and one id
+    per ray, which the stage uses to find the path or shadow test the ray belongs to.
+  */
+  public:
+    void clear() { _rays.clear(); _ids.clear(); };
+    void push(const Ray& ray, uint32_t id) { _rays.push_back(ray); _ids.push_back(id); };
+
+    /*
+    Function that reorders the rays so similar ones sit next to each other. Rays are
+    ordered by the octant of their direction, then by a Morton code of their origin
+    within the scene bounds, then by one of their direction, so neighbouring rays
+    share signs (as packets need) and tend to walk the same parts of the tree.
+    */
+    void sort(const Eigen::Vector3f& scene_min, const Eigen::Vector3f& scene_max);
+
+    // getters
+    size_t size() const { return _rays.size(); };
+    const Ray* rays() const { return _rays.data(); };
+    const Ray& get_ray(size_t i) const { return _rays[i]; };
+    uint32_t get_id(size_t i) const { return _ids[i]; };
+
+  private:
+    std::vector<Ray> _rays;
+    std::vector<uint32_t> _ids;
+
+    // scratch space for sort, kept so sorting does not allocate once the queue has grown
+    std::vector<std::pair<uint64_t, uint32_t>> _keys;
+    std::vector<Ray> _sorted_rays;
+    std::vector<uint32_t> _sorted_ids;
+};
+
+// the key RayQueue::sort orders rays by
+uint64_t get_ray_sort_key(const Ray& ray, const Eigen::Vector3f& scene_min, const Eigen::Vector3f& inv_scene_extent);
+
+struct WavefrontState {
+  /*
+    Everything the wavefront renderer keeps about the paths of one tile while it runs.
+    A path is one sample of one pixel, following its reflections. Each bounce of every
+    path records whether it hit, its own shaded colour and its reflectivity, which
+    are blended back to front once the last bounce is done, the same order the
+    recursive shade uses. One state is kept per worker and reused between tiles.
+  */
+  RayQueue extension; // rays looking for their closest hit
+  RayQueue shadow; // rays testing whether a light is blocked
+  std::vector<Hit> hits; // closest hit of each extension ray
+
+  // per bounce and path, bounce major
+  std::vector<Eigen::Vector3f> colours;
+  std::vector<float> reflectivities;
+  std::vector<char> is_bounce_hit;
+
+  // per path, the ray cone of its latest hit
+  std::vector<float> cone_widths;
+  std::vector<float> cone_spreads;
+
+  // per hit of the current bounce, with the shadow tests of point p running from
+  // point_shadow_starts[p] up to point_shadow_starts[p + 1]
+  std::vector<ShadingPoint> points;
+  std::vector<uint32_t> point_paths;
+  std::vector<uint32_t> point_shadow_starts;
+
+  // per shadow test, the light it is for as the light grid picked it
+  std::vector<uint32_t> shadow_lights;
+  std::vector<float> shadow_weights;
+  std::vector<float> shadow_distances;
+  std::vector<char> is_light_visible;
+
+  ShadowCache shadow_cache; // the worker's own, used when the shadow cache is on
+};
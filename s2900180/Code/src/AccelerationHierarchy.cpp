@@ -1,8 +1,20 @@
 #include "AccelerationHierarchy.h"
+#include "BoundingBoxCache.h"
 
-void find_max_and_min(Eigen::Vector3f& max, Eigen::Vector3f& min, const std::vector<std::unique_ptr<Mesh>>& meshes) {
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RAYTRACER_HAS_SSE_NODE_TEST
+#endif
+
+template <typename Iterator>
+void find_max_and_min(Eigen::Vector3f& max, Eigen::Vector3f& min, Iterator begin, Iterator end) {
     // function that finds the global max and min based on the meshes provided
-    
+
     Eigen::Vector3f global_min(std::numeric_limits<float>::max(),
                                std::numeric_limits<float>::max(),
                                std::numeric_limits<float>::max());
@@ -10,11 +22,9 @@ void find_max_and_min(Eigen::Vector3f& max, Eigen::Vector3f& min, const std::vec
                                -std::numeric_limits<float>::max(),
                                -std::numeric_limits<float>::max());
 
-    for (const auto& mesh : meshes) {
-        Eigen::Vector3f mesh_min = mesh->get_min_bound();
-        Eigen::Vector3f mesh_max = mesh->get_max_bound();
-        global_min = global_min.cwiseMin(mesh_min);
-        global_max = global_max.cwiseMax(mesh_max);
+    for (Iterator it = begin; it != end; ++it) {
+        global_min = global_min.cwiseMin(it->min);
+        global_max = global_max.cwiseMax(it->max);
     }
 
     max = global_max;
@@ -22,31 +32,212 @@ void find_max_and_min(Eigen::Vector3f& max, Eigen::Vector3f& min, const std::vec
 }
 
 
+template <typename BuildMeshes>
+void split_by_count(BuildMeshes& build_meshes, size_t begin, size_t end, const Eigen::Vector3f& node_min,
+                    const Eigen::Vector3f& node_max, size_t& split, int& axis) {
+    // halves a range at the median centroid along the longest axis, for ranges that have to be
+    // split to fit in a leaf once the builder would otherwise stop
+    (node_max - node_min).maxCoeff(&axis);
+    split = begin + (end - begin) / 2;
+    std::nth_element(build_meshes.begin() + begin, build_meshes.begin() + split, build_meshes.begin() + end,
+                     [axis](const auto& a, const auto& b) { return a.centroid[axis] < b.centroid[axis]; });
+}
+
+float surface_area(const Eigen::Vector3f& min, const Eigen::Vector3f& max) {
+    // surface area of a box, zero for the inverted box of an empty range
+    Eigen::Vector3f size = (max - min).cwiseMax(0.0f);
+    return 2.0f * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+}
+
 BoundingBoxHierarchyTree::BoundingBoxHierarchyTree(
-    std::vector<std::unique_ptr<Mesh>> meshes
-) {
-    _root = std::make_unique<BoundingBoxNode>();
-    
-    find_max_and_min(_root->max, _root->min, meshes);   
-    split_bounding_box(_root, meshes, 0);
+    std::vector<std::unique_ptr<Mesh>> meshes,
+    BoundingBoxBuilder builder,
+    int width
+) : BoundingBoxHierarchyTree(PrimitiveStore::from_meshes(meshes), builder, width) {}
+
+BoundingBoxHierarchyTree::BoundingBoxHierarchyTree(
+    PrimitiveStore store,
+    BoundingBoxBuilder builder,
+    int width,
+    const std::string& cache_filepath
+) : _builder(builder), _width(width), _store(std::move(store)) {
+    if (width != 2 && width != WIDE_NODE_WIDTH) {
+        throw std::runtime_error("Bounding box tree width must be 2 or " + std::to_string(WIDE_NODE_WIDTH));
+    }
+
+    uint64_t hash = 0;
+    if (!cache_filepath.empty()) {
+        hash = hash_bounding_box_inputs(_store, _builder, _width);
+        std::optional<BoundingBoxCache> cache = read_bounding_box_cache(cache_filepath, hash, _store, _width);
+        if (cache) {
+            _nodes = cache->nodes;
+            _wide_nodes = cache->wide_nodes;
+            _primitives = cache->primitives;
+            _cache_owner = std::move(cache->owner);
+            _is_from_cache = true;
+            return;
+        }
+    }
+
+    build();
+    _nodes = _node_storage;
+    _wide_nodes = _wide_node_storage;
+    _primitives = _primitive_storage;
+
+    if (!cache_filepath.empty()) {
+        write_bounding_box_cache(cache_filepath, hash, {_nodes, _wide_nodes, _primitives, nullptr});
+    }
+}
+
+void BoundingBoxHierarchyTree::build() {
+    // the bounds are read once up front, the build only ever touches these
+    std::vector<BuildMesh> build_meshes;
+    build_meshes.reserve(_store.size());
+    for (uint32_t reference : _store.get_references()) {
+        BuildMesh build_mesh;
+        _store.get_bounds(reference, build_mesh.min, build_mesh.max);
+        build_mesh.centroid = _store.get_centroid(reference);
+        build_mesh.reference = reference;
+        build_meshes.push_back(build_mesh);
+    }
+
+    _node_storage.reserve(2 * build_meshes.size() + 1);
+    split_bounding_box(build_meshes, 0, build_meshes.size(), 0);
+
+    // the leaves index into the references in the order the build left them
+    _primitive_storage.reserve(build_meshes.size());
+    for (const BuildMesh& build_mesh : build_meshes) {
+        _primitive_storage.push_back(build_mesh.reference);
+    }
+
+    if (_width == WIDE_NODE_WIDTH) {
+        _wide_node_storage.reserve(_node_storage.size() / 2 + 1);
+        collapse_wide_node(0);
+    }
+}
+
+uint32_t BoundingBoxHierarchyTree::collapse_wide_node(uint32_t binary_index) {
+    uint32_t wide_index = static_cast<uint32_t>(_wide_node_storage.size());
+    _wide_node_storage.emplace_back();
+
+    // start from the two children, or the node itself when the whole tree is one leaf
+    uint32_t children[WIDE_NODE_WIDTH];
+    int child_count = 0;
+    if (_node_storage[binary_index].is_leaf) {
+        children[child_count++] = binary_index;
+    } else {
+        children[child_count++] = binary_index + 1;
+        children[child_count++] = _node_storage[binary_index].offset;
+    }
+
+    // replace the inner child with the biggest surface area by its own two children, as
+    // that is the one rays are most likely to enter, until the node is full
+    while (child_count < WIDE_NODE_WIDTH) {
+        int largest = -1;
+        float largest_area = -1.0f;
+        for (int i = 0; i < child_count; i++) {
+            const BoundingBoxNode& child = _node_storage[children[i]];
+            if (child.is_leaf) continue;
+            float area = surface_area(as_vec3(child.min), as_vec3(child.max));
+            if (area > largest_area) {
+                largest_area = area;
+                largest = i;
+            }
+        }
+        if (largest == -1) break;
+
+        uint32_t opened = children[largest];
+        children[largest] = opened + 1;
+        children[child_count++] = _node_storage[opened].offset;
+    }
+
+    WideBoundingBoxNode wide{};
+    wide.child_count = static_cast<uint8_t>(child_count);
+    for (int a = 0; a < 3; a++) {
+        for (int i = 0; i < WIDE_NODE_WIDTH; i++) {
+            wide.min[a][i] = std::numeric_limits<float>::infinity();
+            wide.max[a][i] = -std::numeric_limits<float>::infinity();
+        }
+    }
+
+    for (int i = 0; i < child_count; i++) {
+        const BoundingBoxNode& child = _node_storage[children[i]];
+        for (int a = 0; a < 3; a++) {
+            wide.min[a][i] = child.min[a];
+            wide.max[a][i] = child.max[a];
+        }
+
+        if (child.is_leaf) {
+            wide.leaf_mask |= static_cast<uint8_t>(1 << i);
+            wide.child[i] = child.offset;
+            wide.primitive_count[i] = child.primitive_count;
+        } else {
+            wide.child[i] = collapse_wide_node(children[i]);
+        }
+    }
+
+    _wide_node_storage[wide_index] = wide;
+    return wide_index;
 }
 
 void BoundingBoxHierarchyTree::split_bounding_box(
-    std::unique_ptr<BoundingBoxNode>& node, 
-    std::vector<std::unique_ptr<Mesh>>& meshes, 
+    std::vector<BuildMesh>& build_meshes,
+    size_t begin, size_t end,
     int depth
 ) {
-    if (meshes.empty()) return;
-    
-    // if they reach leaf or max depth
-    if (meshes.size() <= 2 || depth > MAX_DEPTH) {
-        node->meshes = std::move(meshes);
+    auto first = build_meshes.begin() + begin;
+    auto last = build_meshes.begin() + end;
+
+    uint32_t node_index = static_cast<uint32_t>(_node_storage.size());
+    _node_storage.emplace_back();
+
+    Eigen::Vector3f node_min, node_max;
+    find_max_and_min(node_max, node_min, first, last);
+    for (int i = 0; i < 3; ++i) {
+        _node_storage[node_index].min[i] = node_min[i];
+        _node_storage[node_index].max[i] = node_max[i];
+    }
+
+    size_t split;
+    int axis;
+    bool is_split = (_builder == BoundingBoxBuilder::SAH)
+        ? partition_sah(build_meshes, begin, end, depth, node_min, node_max, split, axis)
+        : partition_midpoint(build_meshes, begin, end, depth, node_min, node_max, split, axis);
+
+    if (!is_split) {
+        // both builders keep splitting past their depth limit until the range fits
+        assert(end - begin <= MAX_LEAF_PRIMITIVES);
+        _node_storage[node_index].is_leaf = 1;
+        _node_storage[node_index].offset = static_cast<uint32_t>(begin);
+        _node_storage[node_index].primitive_count = static_cast<uint16_t>(end - begin);
         return;
     }
-    
+
+    // recurse into it, the left child lands directly after this node
+    _node_storage[node_index].is_leaf = 0;
+    _node_storage[node_index].axis = static_cast<uint8_t>(axis);
+    _node_storage[node_index].primitive_count = 0;
+    split_bounding_box(build_meshes, begin, split, depth + 1);
+    _node_storage[node_index].offset = static_cast<uint32_t>(_node_storage.size());
+    split_bounding_box(build_meshes, split, end, depth + 1);
+}
+
+bool BoundingBoxHierarchyTree::partition_midpoint(
+    std::vector<BuildMesh>& build_meshes,
+    size_t begin, size_t end, int depth,
+    const Eigen::Vector3f& node_min, const Eigen::Vector3f& node_max,
+    size_t& split, int& axis
+) {
+    // if they reach leaf or max depth. a range too big for one leaf is halved by count instead
+    if (end - begin <= 2) return false;
+    if (depth > MAX_DEPTH) {
+        if (end - begin <= MAX_LEAF_PRIMITIVES) return false;
+        split_by_count(build_meshes, begin, end, node_min, node_max, split, axis);
+        return true;
+    }
+
     // find what axis to split on (find the longest)
-    Eigen::Vector3f size = node->max - node->min;
-    int axis;
+    Eigen::Vector3f size = node_max - node_min;
     if (size.x() >= size.y() && size.x() >= size.z()) {
         axis = 0;
     } else if (size.y() >= size.z()) {
@@ -54,95 +245,452 @@ void BoundingBoxHierarchyTree::split_bounding_box(
     } else {
         axis = 2;
     }
-    float split_pos = node->min[axis] + size[axis] / 2.0f;
-    
+    float split_pos = node_min[axis] + size[axis] / 2.0f;
+
     // based on the axis, find which should be left and right
-    std::vector<std::unique_ptr<Mesh>> left_meshes;
-    std::vector<std::unique_ptr<Mesh>> right_meshes;
-    for (auto& mesh : meshes) {
-        float centroid = mesh->get_centroid()[axis];
-        if (centroid < split_pos) {
-            left_meshes.push_back(std::move(mesh));
-        } else {
-            right_meshes.push_back(std::move(mesh));
+    auto first = build_meshes.begin() + begin;
+    auto middle = std::stable_partition(first, build_meshes.begin() + end, [axis, split_pos](const BuildMesh& build_mesh) {
+        return build_mesh.centroid[axis] < split_pos;
+    });
+    split = begin + (middle - first);
+
+    // every centroid on one side leaves the range as it is, so one too big for a leaf is halved by count
+    if ((split == begin || split == end) && end - begin > MAX_LEAF_PRIMITIVES) {
+        split_by_count(build_meshes, begin, end, node_min, node_max, split, axis);
+    }
+    return true;
+}
+
+bool BoundingBoxHierarchyTree::partition_sah(
+    std::vector<BuildMesh>& build_meshes,
+    size_t begin, size_t end, int depth,
+    const Eigen::Vector3f& node_min, const Eigen::Vector3f& node_max,
+    size_t& split, int& axis
+) {
+    size_t count = end - begin;
+    if (count <= 1) return false;
+    if (depth >= SAH_MAX_DEPTH) {
+        // a range too big for one leaf is halved by count, which takes at most 16 more levels
+        if (count <= MAX_LEAF_PRIMITIVES) return false;
+        split_by_count(build_meshes, begin, end, node_min, node_max, split, axis);
+        return true;
+    }
+
+    auto first = build_meshes.begin() + begin;
+    auto last = build_meshes.begin() + end;
+
+    // the bins are spread over the bounds of the centroids rather than the meshes
+    Eigen::Vector3f centroid_min = first->centroid;
+    Eigen::Vector3f centroid_max = first->centroid;
+    for (auto it = first; it != last; ++it) {
+        centroid_min = centroid_min.cwiseMin(it->centroid);
+        centroid_max = centroid_max.cwiseMax(it->centroid);
+    }
+    Eigen::Vector3f centroid_size = centroid_max - centroid_min;
+
+    struct Bin {
+        Eigen::Vector3f min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+        Eigen::Vector3f max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+        size_t count = 0;
+    };
+
+    auto bin_index = [&](const BuildMesh& build_mesh, int a) {
+        int b = static_cast<int>(SAH_NUMBER_OF_BINS * (build_mesh.centroid[a] - centroid_min[a]) / centroid_size[a]);
+        return std::clamp(b, 0, SAH_NUMBER_OF_BINS - 1);
+    };
+
+    float parent_area = surface_area(node_min, node_max);
+    float best_cost = std::numeric_limits<float>::infinity();
+    int best_axis = -1;
+    int best_bin = -1;
+
+    for (int a = 0; a < 3; ++a) {
+        if (centroid_size[a] <= 0.0f) continue;
+
+        Bin bins[SAH_NUMBER_OF_BINS];
+        for (auto it = first; it != last; ++it) {
+            Bin& bin = bins[bin_index(*it, a)];
+            bin.min = bin.min.cwiseMin(it->min);
+            bin.max = bin.max.cwiseMax(it->max);
+            bin.count++;
+        }
+
+        // sweep from the right to find the area and count of everything right of each plane
+        float right_area[SAH_NUMBER_OF_BINS];
+        size_t right_count[SAH_NUMBER_OF_BINS];
+        Bin right;
+        for (int b = SAH_NUMBER_OF_BINS - 1; b > 0; --b) {
+            right.min = right.min.cwiseMin(bins[b].min);
+            right.max = right.max.cwiseMax(bins[b].max);
+            right.count += bins[b].count;
+            right_area[b] = surface_area(right.min, right.max);
+            right_count[b] = right.count;
+        }
+
+        // then sweep from the left, the plane sits between bin b - 1 and bin b
+        Bin left;
+        for (int b = 1; b < SAH_NUMBER_OF_BINS; ++b) {
+            left.min = left.min.cwiseMin(bins[b - 1].min);
+            left.max = left.max.cwiseMax(bins[b - 1].max);
+            left.count += bins[b - 1].count;
+            if (left.count == 0 || right_count[b] == 0) continue;
+
+            float cost = SAH_TRAVERSAL_COST + SAH_INTERSECTION_COST *
+                (surface_area(left.min, left.max) * left.count + right_area[b] * right_count[b]) / parent_area;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = a;
+                best_bin = b;
+            }
         }
     }
-    node->left = std::make_unique<BoundingBoxNode>();
-    node->right = std::make_unique<BoundingBoxNode>();
 
-    // recurse into it
-    find_max_and_min(node->left->max, node->left->min, left_meshes);
-    find_max_and_min(node->right->max, node->right->min, right_meshes);   
-    split_bounding_box(node->left, left_meshes, depth + 1);
-    split_bounding_box(node->right, right_meshes, depth + 1);
+    if (best_axis == -1) {
+        // every centroid lands in the same spot, so no plane can separate them. small
+        // groups become a leaf, bigger ones are halved by count so leaves stay bounded
+        if (count <= static_cast<size_t>(SAH_MAX_LEAF_SIZE)) return false;
+        axis = 0;
+        split = begin + count / 2;
+        return true;
+    }
+
+    // only split when it is estimated to be cheaper than testing every mesh in a leaf
+    float leaf_cost = SAH_INTERSECTION_COST * count;
+    if (best_cost >= leaf_cost && count <= static_cast<size_t>(SAH_MAX_LEAF_SIZE)) return false;
+
+    axis = best_axis;
+    auto middle = std::stable_partition(first, last, [&](const BuildMesh& build_mesh) {
+        return bin_index(build_mesh, best_axis) < best_bin;
+    });
+    split = begin + (middle - first);
+    return true;
 }
 
-bool BoundingBoxNode::check_intersect(Ray ray, Hit* hit, int* counter) {
-    (*counter)++; // purely for testing
+bool intersect_node(const BoundingBoxNode& node, const Ray& ray, float t_max) {
+    // do slab test, the direction signs pick the near and far plane so no swap is needed.
+    // starting from [0, t_max] rejects boxes behind the ray or beyond the closest hit
+    float tmin = 0.0f;
+    float tmax = t_max;
+
+    for (int i = 0; i < 3; ++i) {
+        float near_plane = ray.direction_is_negative[i] ? node.max[i] : node.min[i];
+        float far_plane = ray.direction_is_negative[i] ? node.min[i] : node.max[i];
+        float t1 = (near_plane - ray.origin[i]) * ray.inv_direction[i];
+        float t2 = (far_plane - ray.origin[i]) * ray.inv_direction[i];
 
-    // do slab test
-    float tmin = -std::numeric_limits<float>::infinity();
-    float tmax =  std::numeric_limits<float>::infinity();
+        // written so a NaN (origin on a plane the ray runs parallel to) leaves the range untouched
+        tmin = t1 > tmin ? t1 : tmin;
+        tmax = t2 < tmax ? t2 : tmax;
+    }
+
+    return tmin <= tmax;
+}
+
+int intersect_wide_node(const WideBoundingBoxNode& node, const Ray& ray, float t_max, float entry[WIDE_NODE_WIDTH]) {
+    // the same slab test as intersect_node, run on every child at once. returns a bitmask of
+    // the children entered and the distance each one is entered at
+#ifdef RAYTRACER_HAS_SSE_NODE_TEST
+    __m128 tmin = _mm_setzero_ps();
+    __m128 tmax = _mm_set1_ps(t_max);
 
     for (int i = 0; i < 3; ++i) {
-        if (fabs(ray.direction[i]) < 1e-6f) {
-            if (ray.origin[i] < min[i] || ray.origin[i] > max[i])
-                return false;
-        } else {
-            float t1 = (min[i] - ray.origin[i]) / ray.direction[i];
-            float t2 = (max[i] - ray.origin[i]) / ray.direction[i];
-            if (t1 > t2) std::swap(t1, t2);
-            tmin = std::max(tmin, t1);
-            tmax = std::min(tmax, t2);
-            if (tmin > tmax) return false;
+        const float* near_plane = ray.direction_is_negative[i] ? node.max[i] : node.min[i];
+        const float* far_plane = ray.direction_is_negative[i] ? node.min[i] : node.max[i];
+        __m128 origin = _mm_set1_ps(ray.origin[i]);
+        __m128 inv_direction = _mm_set1_ps(ray.inv_direction[i]);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(near_plane), origin), inv_direction);
+        __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(far_plane), origin), inv_direction);
+
+        // max and min return their second operand on a NaN, matching the scalar test
+        tmin = _mm_max_ps(t1, tmin);
+        tmax = _mm_min_ps(t2, tmax);
+    }
+
+    _mm_storeu_ps(entry, tmin);
+    return _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+#else
+    int hit_mask = 0;
+    for (int child = 0; child < WIDE_NODE_WIDTH; child++) {
+        float tmin = 0.0f;
+        float tmax = t_max;
+        for (int i = 0; i < 3; ++i) {
+            float near_plane = ray.direction_is_negative[i] ? node.max[i][child] : node.min[i][child];
+            float far_plane = ray.direction_is_negative[i] ? node.min[i][child] : node.max[i][child];
+            float t1 = (near_plane - ray.origin[i]) * ray.inv_direction[i];
+            float t2 = (far_plane - ray.origin[i]) * ray.inv_direction[i];
+            tmin = t1 > tmin ? t1 : tmin;
+            tmax = t2 < tmax ? t2 : tmax;
+        }
+        entry[child] = tmin;
+        if (tmin <= tmax) hit_mask |= 1 << child;
+    }
+    return hit_mask;
+#endif
+}
+
+// an entry on the stack of the wide traversal, either a wide node or a leaf to test
+struct WideStackEntry {
+    uint32_t index;
+    uint16_t primitive_count;
+    uint8_t is_leaf;
+    float distance; // where the ray enters it
+};
+
+bool BoundingBoxHierarchyTree::check_intersect(Ray ray, Hit* hit, RenderStatistics* statistics) const {
+    if (_width == WIDE_NODE_WIDTH) return check_intersect_wide(ray, hit, statistics);
+    return check_intersect_binary(ray, hit, statistics);
+}
+
+bool BoundingBoxHierarchyTree::occluded(Ray ray, float t_max, RenderStatistics* statistics, uint32_t* occluder) const {
+    if (_width == WIDE_NODE_WIDTH) return occluded_wide(ray, t_max, statistics, occluder);
+    return occluded_binary(ray, t_max, statistics, occluder);
+}
+
+bool BoundingBoxHierarchyTree::is_occluded_by(uint32_t reference, const Ray& ray, float t_max, RenderStatistics* statistics) const {
+    statistics->primitive_tests[static_cast<int>(primitive_type(reference))]++;
+    return _store.occluded(reference, ray, t_max);
+}
+
+bool BoundingBoxHierarchyTree::check_intersect_wide(const Ray& ray, Hit* hit, RenderStatistics* statistics) const {
+    WideStackEntry stack[MAX_WIDE_TRAVERSAL_STACK];
+    int stack_size = 0;
+    stack[stack_size++] = {0, 0, 0, 0.0f};
+
+    float closest = hit->is_hit ? hit->distance_along_ray : std::numeric_limits<float>::infinity();
+    uint32_t closest_primitive = NO_PRIMITIVE;
+
+    while (stack_size > 0) {
+        WideStackEntry entry = stack[--stack_size];
+
+        // the closest hit may have moved closer since this was pushed
+        if (entry.distance > closest) continue;
+
+        if (entry.is_leaf) {
+            for (uint32_t i = entry.index; i < entry.index + entry.primitive_count; i++) {
+                statistics->primitive_tests[static_cast<int>(primitive_type(_primitives[i]))]++;
+                float t;
+                if (_store.intersect(_primitives[i], ray, t, closest) && t < closest) {
+                    closest = t;
+                    closest_primitive = _primitives[i];
+                }
+            }
+            continue;
+        }
+
+        const WideBoundingBoxNode& node = _wide_nodes[entry.index];
+        statistics->node_visits++;
+
+        float distances[WIDE_NODE_WIDTH];
+        int hit_mask = intersect_wide_node(node, ray, closest, distances);
+
+        // push the children entered, then sort them so the nearest is on top
+        int first = stack_size;
+        for (int i = 0; i < node.child_count; i++) {
+            if (!(hit_mask & (1 << i))) continue;
+            WideStackEntry child{node.child[i], node.primitive_count[i],
+                                 static_cast<uint8_t>((node.leaf_mask >> i) & 1), distances[i]};
+            int j = stack_size++;
+            while (j > first && stack[j - 1].distance < child.distance) {
+                stack[j] = stack[j - 1];
+                j--;
+            }
+            stack[j] = child;
+        }
+    }
+
+    if (closest_primitive == NO_PRIMITIVE) return false;
+    return _store.check_intersect(closest_primitive, ray, hit);
+}
+
+bool BoundingBoxHierarchyTree::occluded_wide(const Ray& ray, float t_max, RenderStatistics* statistics, uint32_t* occluder) const {
+    WideStackEntry stack[MAX_WIDE_TRAVERSAL_STACK];
+    int stack_size = 0;
+    stack[stack_size++] = {0, 0, 0, 0.0f};
+
+    while (stack_size > 0) {
+        WideStackEntry entry = stack[--stack_size];
+
+        if (entry.is_leaf) {
+            // any blocker will do, so return on the first one
+            for (uint32_t i = entry.index; i < entry.index + entry.primitive_count; i++) {
+                statistics->primitive_tests[static_cast<int>(primitive_type(_primitives[i]))]++;
+                if (_store.occluded(_primitives[i], ray, t_max)) {
+                    if (occluder != nullptr) *occluder = _primitives[i];
+                    return true;
+                }
+            }
+            continue;
+        }
+
+        const WideBoundingBoxNode& node = _wide_nodes[entry.index];
+        statistics->node_visits++;
+
+        // order does not matter for an any-hit query
+        float distances[WIDE_NODE_WIDTH];
+        int hit_mask = intersect_wide_node(node, ray, t_max, distances);
+        for (int i = 0; i < node.child_count; i++) {
+            if (!(hit_mask & (1 << i))) continue;
+            stack[stack_size++] = {node.child[i], node.primitive_count[i],
+                                   static_cast<uint8_t>((node.leaf_mask >> i) & 1), distances[i]};
         }
     }
 
-    if (tmax < 0) return false; 
+    return false;
+}
+
+bool BoundingBoxHierarchyTree::check_intersect_binary(const Ray& ray, Hit* hit, RenderStatistics* statistics) const {
+    uint32_t stack[MAX_TRAVERSAL_STACK];
+    int stack_size = 0;
+    uint32_t node_index = 0;
+
+    // only the distance is found while walking the tree, the details are filled in at the end
+    float closest = hit->is_hit ? hit->distance_along_ray : std::numeric_limits<float>::infinity();
+    uint32_t closest_primitive = NO_PRIMITIVE;
 
-    // left node, check intersect with actual meshes
-    if (!left && !right) {
-        bool hit_any = false;
-        for (auto& mesh_ptr : meshes) {
-            (*counter)++; 
-            Mesh* mesh = mesh_ptr.get();   // get raw pointer
-            if (mesh->check_intersect(ray, hit)) {
-                hit_any = true;
+    while (true) {
+        const BoundingBoxNode& node = _nodes[node_index];
+        statistics->node_visits++;
+
+        // nothing inside a box that starts past the closest hit so far can be closer
+        if (intersect_node(node, ray, closest)) {
+            if (!node.is_leaf) {
+                // visit the child on the near side of the split first, leaving the far one for later
+                if (ray.direction_is_negative[node.axis]) {
+                    stack[stack_size++] = node_index + 1;
+                    node_index = node.offset;
+                } else {
+                    stack[stack_size++] = node.offset;
+                    node_index = node_index + 1;
+                }
+                continue;
+            }
+
+            // leaf node, check intersect with actual primitives
+            for (uint32_t i = node.offset; i < node.offset + node.primitive_count; i++) {
+                statistics->primitive_tests[static_cast<int>(primitive_type(_primitives[i]))]++;
+                float t;
+                if (_store.intersect(_primitives[i], ray, t, closest) && t < closest) {
+                    closest = t;
+                    closest_primitive = _primitives[i];
+                }
             }
         }
-        return hit_any;
+
+        if (stack_size == 0) break;
+        node_index = stack[--stack_size];
     }
 
-    // interanl node, recurse
-    bool hit_left = left && left->check_intersect(ray, hit, counter);
-    bool hit_right = right && right->check_intersect(ray, hit, counter);
+    if (closest_primitive == NO_PRIMITIVE) return false;
+    return _store.check_intersect(closest_primitive, ray, hit);
+}
 
-    return hit_left || hit_right;
+void BoundingBoxHierarchyTree::get_bounds(Eigen::Vector3f& min, Eigen::Vector3f& max) const {
+    min = max = Eigen::Vector3f::Zero();
+    if (_nodes.empty()) return;
+    min = Eigen::Vector3f(_nodes[0].min[0], _nodes[0].min[1], _nodes[0].min[2]);
+    max = Eigen::Vector3f(_nodes[0].max[0], _nodes[0].max[1], _nodes[0].max[2]);
 }
 
-bool BoundingBoxHierarchyTree::check_intersect(Ray ray, Hit* hit, int* counter){
-    return (_root->check_intersect(ray, hit, counter));
+PacketTraversalData BoundingBoxHierarchyTree::get_packet_traversal_data() const {
+    return {_nodes.data(), _primitives.data(), _store.get_cubes(), _store.get_spheres(), _store.get_planes(),
+            &_store, intersect_triangle_mesh_packet};
 }
 
-void print_subtree(const std::unique_ptr<BoundingBoxNode>& node, int depth) {
-    if (!node->meshes.empty()) {
-        std::cout << "Current Leaf at depth " << depth << " has " 
-              << node->meshes.size() << " meshes" << std::endl;
+int BoundingBoxHierarchyTree::check_intersect_packet(const Ray* rays, Hit* hits, RenderStatistics* statistics) const {
+    int hit_lanes = 0;
+
+    // the packet shares one near child order, so it only works when every ray agrees on the signs
+    bool is_coherent = true;
+    for (int lane = 1; lane < RAY_PACKET_SIZE; lane++) {
+        for (int i = 0; i < 3; i++) {
+            is_coherent &= rays[lane].direction_is_negative[i] == rays[0].direction_is_negative[i];
+        }
+    }
+
+    if (!is_coherent) {
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            if (check_intersect(rays[lane], &hits[lane], statistics)) hit_lanes |= 1 << lane;
+        }
+        return hit_lanes;
+    }
+
+    RayPacket packet;
+    PacketHit packet_hit;
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        for (int i = 0; i < 3; i++) {
+            packet.origin[i][lane] = rays[lane].origin[i];
+            packet.direction[i][lane] = rays[lane].direction[i];
+            packet.inv_direction[i][lane] = rays[lane].inv_direction[i];
+        }
+        packet_hit.distance[lane] = hits[lane].is_hit ? hits[lane].distance_along_ray : std::numeric_limits<float>::infinity();
+        packet_hit.primitive[lane] = NO_PRIMITIVE;
+    }
+    for (int i = 0; i < 3; i++) packet.direction_is_negative[i] = rays[0].direction_is_negative[i];
+
+    _traverse_packet(get_packet_traversal_data(), packet, packet_hit, statistics);
+
+    // as with single rays, the details are only found for the closest primitive of each ray
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        if (packet_hit.primitive[lane] != NO_PRIMITIVE &&
+            _store.check_intersect(packet_hit.primitive[lane], rays[lane], &hits[lane])) {
+            hit_lanes |= 1 << lane;
+        }
+    }
+    return hit_lanes;
+}
+
+bool BoundingBoxHierarchyTree::occluded_binary(const Ray& ray, float t_max, RenderStatistics* statistics, uint32_t* occluder) const {
+    uint32_t stack[MAX_TRAVERSAL_STACK];
+    int stack_size = 0;
+    uint32_t node_index = 0;
+
+    while (true) {
+        const BoundingBoxNode& node = _nodes[node_index];
+        statistics->node_visits++;
+
+        // boxes starting beyond t_max can not hold a blocker
+        if (intersect_node(node, ray, t_max)) {
+            if (!node.is_leaf) {
+                stack[stack_size++] = node.offset;
+                node_index = node_index + 1;
+                continue;
+            }
+
+            // any blocker will do, so return on the first one
+            for (uint32_t i = node.offset; i < node.offset + node.primitive_count; i++) {
+                statistics->primitive_tests[static_cast<int>(primitive_type(_primitives[i]))]++;
+                if (_store.occluded(_primitives[i], ray, t_max)) {
+                    if (occluder != nullptr) *occluder = _primitives[i];
+                    return true;
+                }
+            }
+        }
+
+        if (stack_size == 0) break;
+        node_index = stack[--stack_size];
+    }
+
+    return false;
+}
+
+void BoundingBoxHierarchyTree::print_subtree(uint32_t node_index, int depth) {
+    const BoundingBoxNode& node = _nodes[node_index];
+    if (node.is_leaf) {
+        std::cout << "Current Leaf at depth " << depth << " has "
+              << node.primitive_count << " primitives" << std::endl;
     } else {
         std::cout << "Current Branch at depth " << depth << std::endl;
     }
-    
-    std::cout << "Min val:\n" << node->min << std::endl;
-    std::cout << "Max val:\n" << node->max << "\n\n";
-    
-    if (node->left) {
-        print_subtree(node->left, depth + 1);
-    }
-    if (node->right) {
-        print_subtree(node->right, depth + 1);
+
+    std::cout << "Min val:\n" << Eigen::Vector3f(node.min[0], node.min[1], node.min[2]) << std::endl;
+    std::cout << "Max val:\n" << Eigen::Vector3f(node.max[0], node.max[1], node.max[2]) << "\n\n";
+
+    if (!node.is_leaf) {
+        print_subtree(node_index + 1, depth + 1);
+        print_subtree(node.offset, depth + 1);
     }
 }
 
 void BoundingBoxHierarchyTree::print() {
-    print_subtree(_root, 0);
-}
\ No newline at end of file
+    print_subtree(0, 0);
+}
@@ -1,34 +1,13 @@
 #include "BlenderFileReader.h"
 
-Camera BlenderFileReader::get_camera_from_blender_file() {
-  // read the json file
-  std::ifstream file(_filepath);
-  if (!file.is_open()) {
-    std::cerr << "Error: Could not open the file at " << _filepath << std::endl;
-    throw std::runtime_error("Could not open file");
-  }
-
-  nlohmann::json file_json; 
-  file >> file_json;
-
-  // seperate relevant camera json
-  nlohmann::json camera_json; 
-  for (const auto& object : file_json["objects"]) {
-    if (object["type"] == "CAMERA") {
-      camera_json = object;
-    }
-  }
-  if (camera_json.is_null()) {
-    throw std::runtime_error("No camera object found in file");
-  }
-
+Camera get_camera_from_blender_object(const nlohmann::json& camera_json) {
   // construct camera object
   Eigen::Vector3f location = vec3_from_json(camera_json["location"]);
   Eigen::Vector3f gaze_vector = vec3_from_json(camera_json["gaze_vector_direction"]);
   Eigen::Vector3f up_vector = vec3_from_json(camera_json["up_vector"]);
 
   // classify the sensor fit (if AUTO, depends on which is larger between height and width)
-  SensorFit sensor_fit = (camera_json["sensor_fit"] == "VERTICAL" || 
+  SensorFit sensor_fit = (camera_json["sensor_fit"] == "VERTICAL" ||
     (camera_json["sensor_fit"] == "AUTO" && camera_json["sensor_height"] > camera_json["sensor_width"]))
    ? SensorFit::VERTICAL : SensorFit::HORIZONTAL;
 
@@ -45,7 +24,7 @@ Camera BlenderFileReader::get_camera_from_blender_file() {
   return camera;
 }
 
-Material get_material_from_blender_object(const nlohmann::json& material_json) {
+Material get_material_from_blender_object(const nlohmann::json& material_json, TextureCache& texture_cache) {
     Material material;
     material.ka = material_json["ka"];
     material.kd = material_json["kd"];
@@ -56,78 +35,116 @@ Material get_material_from_blender_object(const nlohmann::json& material_json) {
 
     if (material_json.contains("texture")) { // only include texture if given
         std::string path = material_json["texture"]["absolute_path"];
-        material.texture = new PPMImageFile(path);
-        material.texture->read_image_from_file(); // TODO. add some caching here
+        material.texture = texture_cache.get(path);
     }
     return material;
 }
 
-std::vector<std::unique_ptr<Mesh>> BlenderFileReader::get_meshes_from_blender_file() {
-  // read the json file
-  std::ifstream file(_filepath);
-  if (!file.is_open()) {
-    std::cerr << "Error: Could not open the file.\n";
-    throw std::runtime_error("Could not open file");
-  }
-
-  nlohmann::json file_json; 
-  file >> file_json;
+std::shared_ptr<const TriangleMeshData> get_triangle_mesh_from_blender_object(const std::string& name,
+                                                                             const nlohmann::json& mesh_json) {
+  // normals and uvs are optional, an empty buffer means the mesh has none
+  std::vector<float> normals, uvs;
+  if (mesh_json.contains("normals")) normals = mesh_json["normals"].get<std::vector<float>>();
+  if (mesh_json.contains("uvs")) uvs = mesh_json["uvs"].get<std::vector<float>>();
+  return std::make_shared<const TriangleMeshData>(name, mesh_json["positions"].get<std::vector<float>>(),
+                                                  std::move(normals), std::move(uvs),
+                                                  mesh_json["indices"].get<std::vector<uint32_t>>());
+}
 
-  std::vector<std::unique_ptr<Mesh>> meshes;
+std::unique_ptr<Mesh> get_mesh_from_blender_object(const nlohmann::json& object, TextureCache& texture_cache,
+                                                   const TriangleMeshLibrary& triangle_meshes) {
+  std::string shape = object["shape"];
+  std::string name = object["name"];
+
+  if (shape == "CUBE") {
+      Eigen::Vector3f translation = vec3_from_json(object["translation"]);
+      Eigen::Vector3f rotation = vec3_from_json(object["rotation_euler_rad"]);
+      Eigen::Vector3f scale = vec3_from_json(object["scale"]);
+      Material material = get_material_from_blender_object(object["material"], texture_cache);
+      return std::make_unique<Cube>(translation, rotation, 2*scale, name, MeshType::CUBE, material);
+  }
+  else if (shape == "SPHERE") {
+      Eigen::Vector3f location = vec3_from_json(object["location"]); // TODO. change naming convention
+      Eigen::Vector3f rotation = vec3_from_json(object["rotation_euler_rad"]);
+      Eigen::Vector3f scale = vec3_from_json(object["scale"]);
+      Material material = get_material_from_blender_object(object["material"], texture_cache);
+      return std::make_unique<Sphere>(location, rotation, scale, name, MeshType::SPHERE, material);
+  }
+  else if (shape == "PLANE") {
+      std::array<Eigen::Vector3f, NUMBER_OF_PLANE_CORNERS> corners;
+      for (int i = 0; i < NUMBER_OF_PLANE_CORNERS; ++i) {
+          corners[i] = vec3_from_json(object["corners_world"][i]);
+      }
+      Material material = get_material_from_blender_object(object["material"], texture_cache);
+      return std::make_unique<Plane>(corners, name, MeshType::PLANE, material);
+  }
+  else if (shape == "TRIANGLE_MESH") {
+      auto data = triangle_meshes.find(object["mesh"]);
+      if (data == triangle_meshes.end()) {
+        std::cerr << "Error: " << name << " uses the mesh " << object["mesh"] << " which is not in the file" << std::endl;
+        throw std::runtime_error("Unknown triangle mesh");
+      }
 
-  for (const auto& object : file_json["objects"]) {
-      if (object["type"] != "MESH") continue;
-
-      std::string shape = object["shape"];
-      std::string name = object["name"];
-
-      if (shape == "CUBE") {
-          Eigen::Vector3f translation = vec3_from_json(object["translation"]);
-          Eigen::Vector3f rotation = vec3_from_json(object["rotation_euler_rad"]);
-          Eigen::Vector3f scale = vec3_from_json(object["scale"]);
-          Material material = get_material_from_blender_object(object["material"]);
-          meshes.push_back(std::make_unique<Cube>(translation, rotation, 2*scale, name, MeshType::CUBE, material));
-      } 
-      else if (shape == "SPHERE") {
-          Eigen::Vector3f location = vec3_from_json(object["location"]); // TODO. change naming convention
-          Eigen::Vector3f rotation = vec3_from_json(object["rotation_euler_rad"]);
-          Eigen::Vector3f scale = vec3_from_json(object["scale"]);
-          Material material = get_material_from_blender_object(object["material"]);
-          meshes.push_back(std::make_unique<Sphere>(location, rotation, scale, name, MeshType::SPHERE, material));
-      } 
-      else if (shape == "PLANE") {
-          std::array<Eigen::Vector3f, NUMBER_OF_PLANE_CORNERS> corners;
-          for (int i = 0; i < NUMBER_OF_PLANE_CORNERS; ++i) {
-              corners[i] = vec3_from_json(object["corners_world"][i]);
-          }
-          Material material = get_material_from_blender_object(object["material"]);
-          meshes.push_back(std::make_unique<Plane>(corners, name, MeshType::PLANE, material));
+      // matrix_world is stored row by row, as blender prints it
+      Eigen::Matrix4f matrix_world;
+      for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 4; column++) {
+          matrix_world(row, column) = object["matrix_world"][row][column];
+        }
       }
+      Material material = get_material_from_blender_object(object["material"], texture_cache);
+      return std::make_unique<TriangleMesh>(data->second, matrix_world, name, MeshType::TRIANGLE_MESH, material);
   }
-  return meshes;
+  return nullptr; // unknown shapes are skipped
+}
+
+Light get_light_from_blender_object(const nlohmann::json& object) {
+  Eigen::Vector3f position = vec3_from_json(object["location"]); // TODO. change naming convention here
+  float id = object["id"];
+  float is = object["is"];
+  return Light(position, id, is);
 }
 
-std::vector<Light> BlenderFileReader::get_lights_from_blender_file() {
+Scene BlenderFileReader::load_scene() {
   // read the json file
   std::ifstream file(_filepath);
   if (!file.is_open()) {
-    std::cerr << "Error: Could not open the file.\n";
+    std::cerr << "Error: Could not open the file at " << _filepath << std::endl;
     throw std::runtime_error("Could not open file");
   }
 
-  nlohmann::json file_json; 
+  nlohmann::json file_json;
   file >> file_json;
 
-  std::vector<Light> l;
+  // the triangle meshes are shared by name between every object that instances them
+  TriangleMeshLibrary triangle_meshes;
+  if (file_json.contains("meshes")) {
+    for (const auto& [name, mesh_json] : file_json["meshes"].items()) {
+      triangle_meshes[name] = get_triangle_mesh_from_blender_object(name, mesh_json);
+    }
+  }
+
+  // one pass over the objects, if there are several cameras the last one is used
+  const nlohmann::json* camera_json = nullptr;
+  std::vector<std::unique_ptr<Mesh>> meshes;
+  std::vector<Light> lights;
   for (const auto& object : file_json["objects"]) {
-    if (object["type"] == "LIGHT") {
-        Eigen::Vector3f position = vec3_from_json(object["location"]); // TODO. change naming convention here
-        float id = object["id"];
-        float is = object["is"];
-        Light curr_l(position, id, is);
-        l.push_back(curr_l);
+    if (object["type"] == "CAMERA") {
+      camera_json = &object;
+    } else if (object["type"] == "MESH") {
+      std::unique_ptr<Mesh> mesh = get_mesh_from_blender_object(object, _texture_cache, triangle_meshes);
+      if (mesh) meshes.push_back(std::move(mesh));
+    } else if (object["type"] == "LIGHT") {
+      lights.push_back(get_light_from_blender_object(object));
     }
   }
+  if (camera_json == nullptr) {
+    throw std::runtime_error("No camera object found in file");
+  }
 
-  return l;
-};
+  return Scene{get_camera_from_blender_object(*camera_json), std::move(meshes), std::move(lights)};
+}
+
+void BlenderFileReader::wait_for_textures() {
+  _texture_cache.wait();
+}
@@ -0,0 +1,220 @@
+#include "BoundingBoxCache.h"
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+const size_t CACHE_ALIGNMENT = 16;
+
+void hash_bytes(uint64_t& hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+}
+
+template <typename T>
+void hash_value(uint64_t& hash, const T& value) {
+    hash_bytes(hash, &value, sizeof(value));
+}
+
+// the length goes in first, so moving a record from one array to the next changes the hash
+template <typename T>
+void hash_array(uint64_t& hash, std::span<const T> values) {
+    hash_value(hash, static_cast<uint64_t>(values.size()));
+    hash_bytes(hash, values.data(), values.size_bytes());
+}
+
+// points array at count records from offset within the file, as long as they lie within it
+template <typename T>
+bool get_array(const MappedFile& file, uint64_t offset, uint64_t count, std::span<const T>& array) {
+    if (offset % alignof(T) != 0 || offset > file.size() || count > (file.size() - offset) / sizeof(T)) return false;
+    array = std::span<const T>(reinterpret_cast<const T*>(file.data() + offset), count);
+    return true;
+}
+
+uint64_t align_offset(uint64_t offset) {
+    return (offset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+}
+
+// every child and leaf range must stay within the arrays, and every child must come after its
+// parent, so a damaged file can never send a traversal outside of them or around in a loop.
+// the depth of every node is found on the way, since the traversals keep fixed size stacks:
+// each inner node on a path pushes one entry for binary nodes and up to three for wide ones
+bool has_valid_indices(const BoundingBoxCache& cache) {
+    // the number of inner nodes on the longest path to each node, 0 for nodes never reached
+    std::vector<int> depths(cache.nodes.size(), 0);
+    if (!depths.empty()) depths[0] = 1;
+    for (size_t i = 0; i < cache.nodes.size(); i++) {
+        const BoundingBoxNode& node = cache.nodes[i];
+        if (node.is_leaf) {
+            if (node.offset > cache.primitives.size() ||
+                node.primitive_count > cache.primitives.size() - node.offset) return false;
+        } else if (node.offset <= i + 1 || node.offset >= cache.nodes.size()) {
+            return false;
+        } else if (depths[i] > 0) {
+            if (depths[i] > MAX_TRAVERSAL_STACK) return false;
+            depths[i + 1] = std::max(depths[i + 1], depths[i] + 1);
+            depths[node.offset] = std::max(depths[node.offset], depths[i] + 1);
+        }
+    }
+
+    std::vector<int> wide_depths(cache.wide_nodes.size(), 0);
+    if (!wide_depths.empty()) wide_depths[0] = 1;
+    for (size_t i = 0; i < cache.wide_nodes.size(); i++) {
+        const WideBoundingBoxNode& node = cache.wide_nodes[i];
+        if (node.child_count > WIDE_NODE_WIDTH) return false;
+        if (wide_depths[i] > 0 && 1 + (WIDE_NODE_WIDTH - 1) * wide_depths[i] > MAX_WIDE_TRAVERSAL_STACK) return false;
+        for (int j = 0; j < node.child_count; j++) {
+            if (node.leaf_mask & (1 << j)) {
+                if (node.child[j] > cache.primitives.size() ||
+                    node.primitive_count[j] > cache.primitives.size() - node.child[j]) return false;
+            } else if (node.child[j] <= i || node.child[j] >= cache.wide_nodes.size()) {
+                return false;
+            } else if (wide_depths[i] > 0) {
+                wide_depths[node.child[j]] = std::max(wide_depths[node.child[j]], wide_depths[i] + 1);
+            }
+        }
+    }
+    return true;
+}
+
+// the hash covers the store rather than the file, so every reference is checked to name a
+// primitive the store holds
+bool has_valid_references(const BoundingBoxCache& cache, const PrimitiveStore& store) {
+    PrimitiveArrays arrays = store.get_arrays();
+    const size_t counts[NUMBER_OF_MESH_TYPES] = {arrays.cubes.size(), arrays.spheres.size(), arrays.planes.size(),
+                                                 arrays.triangle_meshes.size()};
+    for (uint32_t reference : cache.primitives) {
+        uint32_t type = reference >> PRIMITIVE_INDEX_BITS;
+        if (type >= NUMBER_OF_MESH_TYPES || primitive_index(reference) >= counts[type]) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t hash_bounding_box_inputs(const PrimitiveStore& store, BoundingBoxBuilder builder, int width) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    PrimitiveArrays arrays = store.get_arrays();
+    hash_array(hash, arrays.cubes);
+    hash_array(hash, arrays.spheres);
+    hash_array(hash, arrays.planes);
+    hash_array(hash, arrays.triangle_meshes);
+    hash_array(hash, arrays.references);
+
+    hash_value(hash, builder);
+    hash_value(hash, width);
+    for (int constant : {MAX_DEPTH, SAH_MAX_DEPTH, SAH_NUMBER_OF_BINS, SAH_MAX_LEAF_SIZE, WIDE_NODE_WIDTH}) {
+        hash_value(hash, constant);
+    }
+    hash_value(hash, SAH_TRAVERSAL_COST);
+    hash_value(hash, SAH_INTERSECTION_COST);
+    return hash;
+}
+
+std::string get_bounding_box_cache_filepath(const std::string& directory, const std::string& scene_filepath) {
+    std::filesystem::path filename = std::filesystem::path(scene_filepath).filename();
+    filename += BOUNDING_BOX_CACHE_EXTENSION;
+    return (std::filesystem::path(directory) / filename).string();
+}
+
+std::optional<BoundingBoxCache> read_bounding_box_cache(const std::string& filepath, uint64_t hash,
+                                                        const PrimitiveStore& store, int width) {
+    std::error_code error;
+    if (!std::filesystem::exists(filepath, error)) return std::nullopt;
+
+    std::shared_ptr<const MappedFile> file;
+    try {
+        file = std::make_shared<const MappedFile>(filepath);
+    } catch (const std::runtime_error&) {
+        return std::nullopt;
+    }
+
+    BoundingBoxCacheHeader header;
+    if (file->size() < sizeof(header)) return std::nullopt;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, BOUNDING_BOX_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != BOUNDING_BOX_CACHE_VERSION || header.byte_order != SCENE_FILE_BYTE_ORDER_MARK ||
+        header.hash != hash || header.width != static_cast<uint32_t>(width) ||
+        header.primitive_count != store.size()) {
+        return std::nullopt;
+    }
+
+    BoundingBoxCache cache;
+    bool in_bounds = get_array(*file, header.node_offset, header.node_count, cache.nodes) &&
+                     get_array(*file, header.wide_node_offset, header.wide_node_count, cache.wide_nodes) &&
+                     get_array(*file, header.primitive_offset, header.primitive_count, cache.primitives);
+    if (!in_bounds || cache.nodes.empty() || (width == WIDE_NODE_WIDTH) == cache.wide_nodes.empty() ||
+        !has_valid_indices(cache) || !has_valid_references(cache, store)) {
+        std::cerr << "Warning: ignoring the damaged bounding box cache at " << filepath << std::endl;
+        return std::nullopt;
+    }
+
+    cache.owner = file;
+    return cache;
+}
+
+void write_bounding_box_cache(const std::string& filepath, uint64_t hash, const BoundingBoxCache& cache) {
+    BoundingBoxCacheHeader header{};
+    std::memcpy(header.magic, BOUNDING_BOX_CACHE_MAGIC, sizeof(header.magic));
+    header.version = BOUNDING_BOX_CACHE_VERSION;
+    header.byte_order = SCENE_FILE_BYTE_ORDER_MARK;
+    header.hash = hash;
+    header.width = cache.wide_nodes.empty() ? 2 : WIDE_NODE_WIDTH;
+    header.primitive_count = static_cast<uint32_t>(cache.primitives.size());
+    header.node_offset = align_offset(sizeof(header));
+    header.node_count = cache.nodes.size();
+    header.wide_node_offset = align_offset(header.node_offset + cache.nodes.size_bytes());
+    header.wide_node_count = cache.wide_nodes.size();
+    header.primitive_offset = align_offset(header.wide_node_offset + cache.wide_nodes.size_bytes());
+
+    std::vector<char> bytes(header.primitive_offset + cache.primitives.size_bytes(), 0);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + header.node_offset, cache.nodes.data(), cache.nodes.size_bytes());
+    std::memcpy(bytes.data() + header.wide_node_offset, cache.wide_nodes.data(), cache.wide_nodes.size_bytes());
+    std::memcpy(bytes.data() + header.primitive_offset, cache.primitives.data(), cache.primitives.size_bytes());
+
+    // the rename replaces any old file in one step. the temporary file has a name of its own, so
+    // renders of the same scene at once never move each other's half written file into place
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::path(filepath).parent_path();
+    if (!directory.empty()) std::filesystem::create_directories(directory, error);
+
+    std::string temporary_filepath = filepath + ".XXXXXX";
+    int descriptor = mkstemp(temporary_filepath.data());
+    if (descriptor < 0) {
+        std::cerr << "Warning: could not write the bounding box cache to " << filepath << std::endl;
+        return;
+    }
+    fchmod(descriptor, 0644); // mkstemp only lets the owner read the file
+    close(descriptor);
+    {
+        std::ofstream file(temporary_filepath, std::ios::binary);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        if (!file.good()) {
+            std::cerr << "Warning: could not write the bounding box cache to " << temporary_filepath << std::endl;
+            std::filesystem::remove(temporary_filepath, error);
+            return;
+        }
+    }
+
+    std::filesystem::rename(temporary_filepath, filepath, error);
+    if (error) {
+        std::cerr << "Warning: could not write the bounding box cache to " << filepath << std::endl;
+        std::filesystem::remove(temporary_filepath, error);
+    }
+}
@@ -0,0 +1,79 @@
+#include "CameraRayGenerator.h"
+#include <cmath>
+
+CameraRayGenerator::CameraRayGenerator(const CameraProperties& props, Sampler sampler)
+    : _origin(props.location), _resolution_x(props.resolution_x), _resolution_y(props.resolution_y),
+      _sampler(sampler) {
+    // find the camera basis vectors
+    Eigen::Vector3f w_vec = props.gaze_vector_direction.normalized();
+    Eigen::Vector3f up_vec = props.up_vector.normalized();
+    Eigen::Vector3f u_vec = up_vec.cross(w_vec).normalized();
+    Eigen::Vector3f v_vec = w_vec.cross(u_vec).normalized();
+
+    _forward = w_vec * props.focal_length;
+    _right = -u_vec;
+    _down = -v_vec;
+
+    // depending on the sensor fit, find the FOV
+    if (props.sensor_fit == SensorFit::HORIZONTAL) {
+        _sensor_width = props.sensor_width;
+        _sensor_height = _sensor_width * (props.resolution_y/props.resolution_x);
+    } else {
+        _sensor_height = props.sensor_height;
+        _sensor_width = _sensor_height * (props.resolution_x/props.resolution_y);
+    }
+
+    // the sensor distance between neighbouring columns, as seen from the focal point
+    _pixel_spread_angle = std::atan((horizontal_offset(1.0f) - horizontal_offset(0.0f)) / props.focal_length);
+
+    int width = static_cast<int>(props.resolution_x);
+    int height = static_cast<int>(props.resolution_y);
+    _column_offsets.resize(width);
+    _row_offsets.resize(height);
+    for (int px = 0; px < width; px++) _column_offsets[px] = horizontal_offset(static_cast<float>(px));
+    for (int py = 0; py < height; py++) _row_offsets[py] = vertical_offset(static_cast<float>(py));
+}
+
+Eigen::Vector3f CameraRayGenerator::get_direction(float x, float y) const {
+    return direction_from_offsets(horizontal_offset(x), vertical_offset(y));
+}
+
+Ray CameraRayGenerator::get_ray(float x, float y) const {
+    return Ray(_origin, get_direction(x, y));
+}
+
+void CameraRayGenerator::generate_tile(int x_start, int y_start, int width, int height, CameraRayBuffer& buffer) const {
+    buffer.resize(static_cast<size_t>(width) * height);
+
+    size_t i = 0;
+    for (int py = y_start; py < y_start + height; py++) {
+        float v = _row_offsets[py];
+        for (int px = x_start; px < x_start + width; px++, i++) {
+            Eigen::Vector3f direction = direction_from_offsets(_column_offsets[px], v);
+            buffer.direction[0][i] = direction[0];
+            buffer.direction[1][i] = direction[1];
+            buffer.direction[2][i] = direction[2];
+        }
+    }
+}
+
+void CameraRayGenerator::generate_jittered_tile(int x_start, int y_start, int width, int height,
+                                                int sample_index, CameraRayBuffer& buffer) const {
+    buffer.resize(static_cast<size_t>(width) * height);
+
+    size_t i = 0;
+    for (int py = y_start; py < y_start + height; py++) {
+        for (int px = x_start; px < x_start + width; px++, i++) {
+            Eigen::Vector3f direction = get_jittered_ray(px, py, sample_index).direction;
+            buffer.direction[0][i] = direction[0];
+            buffer.direction[1][i] = direction[1];
+            buffer.direction[2][i] = direction[2];
+        }
+    }
+}
+
+Ray CameraRayGenerator::get_jittered_ray(int px, int py, int sample_index) const {
+    float x = static_cast<float>(px) + _sampler.get(px, py, sample_index, 0);
+    float y = static_cast<float>(py) + _sampler.get(px, py, sample_index, 1);
+    return get_ray(x, y);
+}
@@ -0,0 +1,28 @@
+#include "Framebuffer.h"
+#include "Image.h"
+
+#include <algorithm>
+
+void Framebuffer::quantize(PPMImageFile& image) const {
+    image.set_width_and_height(_width, _height);
+
+    for (int py = 0; py < _height; py++) {
+        std::span<const float> source = row(py);
+        uint8_t* destination = image.row(py);
+        for (size_t i = 0; i < source.size(); i++) {
+            // truncates like the int conversion it replaces, but never wraps past the 8 bits
+            destination[i] = static_cast<uint8_t>(std::clamp(source[i], 0.0f, 255.0f));
+        }
+    }
+}
+
+void Framebuffer::write_to_file(const std::string& filename, ImageFormat format) const {
+    if (format == ImageFormat::PFM) {
+        write_pfm_file(filename, _width, _height, data(), 1.0f / 255.0f);
+        return;
+    }
+
+    PPMImageFile image("");
+    quantize(image);
+    image.write_current_image_to_file(filename, format);
+}
@@ -1,67 +1,239 @@
 #include "Image.h"
 
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+
+std::string read_header_token(std::istream& file) {
+    // function that reads the next word of a ppm or pfm header, skipping whitespace and comments
+    std::string token;
+    int c;
+    while ((c = file.get()) != EOF) {
+        if (c == '#') {
+            while ((c = file.get()) != EOF && c != '\n') {}
+        } else if (!std::isspace(c)) {
+            token.push_back(static_cast<char>(c));
+            break;
+        }
+    }
+    while ((c = file.peek()) != EOF && !std::isspace(c)) {
+        token.push_back(static_cast<char>(file.get()));
+    }
+    return token;
+}
+
+int read_header_int(std::istream& file, const std::string& filename) {
+    std::string token = read_header_token(file);
+    int value = 0;
+    auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+    if (error != std::errc() || end != token.data() + token.size()) {
+        std::cerr << "Error: Malformed image header in " << filename << std::endl;
+        throw std::runtime_error(filename);
+    }
+    return value;
+}
+
+uint8_t to_eight_bits(float value) {
+    // rounds a 0-1 value to the nearest 8 bit value
+    return static_cast<uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+uint8_t to_stored_value(int value, int max_colour) {
+    // values are kept as they are in the file (as before), unless they need more than 8 bits,
+    // in which case they are scaled down to 0-255
+    value = std::clamp(value, 0, max_colour);
+    return static_cast<uint8_t>(max_colour > 255 ? value * 255 / max_colour : value);
+}
+
+ImageFormat image_format_from_filename(const std::string& filename) {
+    std::string extension = std::filesystem::path(filename).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension == ".pfm" ? ImageFormat::PFM : ImageFormat::P6;
+}
+
+void write_image_file(const std::string& filename, const std::string& header, const char* data, size_t size) {
+    // everything goes out in two writes, rather than a value at a time
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error: Could not open file for writing\n";
+        return;
+    }
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    out.write(data, static_cast<std::streamsize>(size));
+}
+
+void write_pfm_file(const std::string& filename, int width, int height, const float* rgb, float scale) {
+    // pfm stores rows bottom to top, a negative scale in the header marks the floats as little endian
+    std::vector<float> data(static_cast<size_t>(width) * height * 3);
+    size_t row_size = static_cast<size_t>(width) * 3;
+    for (int py = 0; py < height; py++) {
+        const float* source = rgb + static_cast<size_t>(height - 1 - py) * row_size;
+        float* destination = data.data() + static_cast<size_t>(py) * row_size;
+        for (size_t i = 0; i < row_size; i++) destination[i] = source[i] * scale;
+    }
+
+    bool is_little_endian = std::endian::native == std::endian::little;
+    std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n" 
+                       + (is_little_endian ? "-1.0" : "1.0") + "\n";
+    write_image_file(filename, header, reinterpret_cast<const char*>(data.data()), data.size() * sizeof(float));
+}
+
 void PPMImageFile::read_image_from_file() {
     // open the file 
-    std::ifstream file(_filename);
+    std::ifstream file(_filename, std::ios::binary);
     if (!file.is_open()) {
         std::cerr << "Error: Could not open the file.\n";
         throw std::runtime_error(_filename);
     }
 
-    std::string format;
-    file >> format;
-    if (format != "P3") {
-        std::cerr << "Error: Unsupported PPM format (expected P3, got " << format << ")" << std::endl;
+    // the magic number at the start picks the format
+    std::string format = read_header_token(file);
+    if (format != "P3" && format != "P6" && format != "PF" && format != "Pf") {
+        std::cerr << "Error: Unsupported image format (expected P3, P6 or PFM, got " << format << ")" << std::endl;
         return;
     }
 
-    file >> _width >> _height;
-
-    int max_colour;
-    file >> max_colour;
-
-    _image_map.clear();
+    int width = read_header_int(file, _filename);
+    int height = read_header_int(file, _filename);
+    if (width <= 0 || height <= 0) {
+        std::cerr << "Error: Invalid image size in " << _filename << std::endl;
+        throw std::runtime_error(_filename);
+    }
+    set_width_and_height(width, height);
+    _float_data.clear();
 
-    for (int py = 0; py < _height; py++) {
-        std::vector<Pixel> row = {};
-        for (int px = 0; px < _width; px++) {
-            int r, g, b;
-            file >> r >> g >> b;
-            
-            // create the pixel from the row
-            Pixel p;
-            p.px = px;
-            p.py = py;
-            Colour colour(r, g, b);
-            p.colour = colour;
-            row.push_back(p);
+    if (format == "PF" || format == "Pf") {
+        read_pfm(file, format == "PF" ? 3 : 1);
+    } else {
+        int max_colour = read_header_int(file, _filename);
+        if (max_colour <= 0 || max_colour > 65535) {
+            std::cerr << "Error: Invalid maximum colour value in " << _filename << std::endl;
+            throw std::runtime_error(_filename);
+        }
+        if (format == "P6") {
+            read_p6(file, max_colour);
+        } else {
+            read_p3(file, max_colour);
         }
-        _image_map.push_back(row);
     }
 
     _has_image = true;
 }
 
-void PPMImageFile::update_pixel(int px, int py, struct Colour new_colour) {
-    _image_map.at(py).at(px).colour = new_colour;
+void PPMImageFile::read_p3(std::istream& file, int max_colour) {
+    // read the rest of the file in one go, then parse the numbers straight from memory
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const char* position = text.data();
+    const char* end = text.data() + text.size();
+
+    for (uint8_t& value : _data) {
+        while (position < end && (std::isspace(static_cast<unsigned char>(*position)) || *position == '#')) {
+            if (*position == '#') {
+                while (position < end && *position != '\n') position++;
+            } else {
+                position++;
+            }
+        }
+
+        int number = 0;
+        auto [next, error] = std::from_chars(position, end, number);
+        if (error != std::errc()) {
+            std::cerr << "Error: Not enough pixel values in " << _filename << std::endl;
+            throw std::runtime_error(_filename);
+        }
+        position = next;
+        value = to_stored_value(number, max_colour);
+    }
 }
 
-void PPMImageFile::write_current_image_to_file(std::string export_filename) {
-    std::ofstream out(export_filename);
-    if (!out) {
-        std::cerr << "Error: Could not open file for writing\n";
+void PPMImageFile::read_p6(std::istream& file, int max_colour) {
+    // a single whitespace byte separates the header from the pixels
+    file.get();
+
+    // up to 255 every value is one byte, above that two bytes, most significant first
+    size_t bytes_per_value = max_colour > 255 ? 2 : 1;
+    std::vector<uint8_t> raw(_data.size() * bytes_per_value);
+    if (!file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(raw.size()))) {
+        std::cerr << "Error: Not enough pixel values in " << _filename << std::endl;
+        throw std::runtime_error(_filename);
+    }
+
+    if (bytes_per_value == 1) {
+        _data = std::move(raw);
         return;
     }
+    for (size_t i = 0; i < _data.size(); i++) {
+        _data[i] = to_stored_value((raw[2 * i] << 8) | raw[2 * i + 1], max_colour);
+    }
+}
 
-    // header
-    out << "P3\n" << _image_map.at(0).size() << " " << _image_map.size() << "\n255\n";
+void PPMImageFile::read_pfm(std::istream& file, int channels) {
+    // the sign of the scale gives the byte order, its size is only a hint so is ignored
+    std::string scale_token = read_header_token(file);
+    bool is_little_endian = !scale_token.empty() && scale_token[0] == '-';
+    file.get();
 
-    for (std::vector<Pixel> row: _image_map) {
-        for (Pixel p: row) {
-            out << p.colour.r << " " << p.colour.g << " " << p.colour.b << "  ";
+    std::vector<float> values(static_cast<size_t>(_width) * _height * channels);
+    if (!file.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(float)))) {
+        std::cerr << "Error: Not enough pixel values in " << _filename << std::endl;
+        throw std::runtime_error(_filename);
+    }
+
+    if (is_little_endian != (std::endian::native == std::endian::little)) {
+        for (float& value : values) {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            bits = (bits >> 24) | ((bits >> 8) & 0xff00u) | ((bits << 8) & 0xff0000u) | (bits << 24);
+            std::memcpy(&value, &bits, sizeof(bits));
+        }
+    }
+
+    // rows are stored bottom to top, greyscale files repeat their one channel
+    _float_data.resize(_data.size());
+    for (int py = 0; py < _height; py++) {
+        const float* source = values.data() + static_cast<size_t>(_height - 1 - py) * _width * channels;
+        float* destination = _float_data.data() + static_cast<size_t>(py) * _width * 3;
+        for (int px = 0; px < _width; px++) {
+            for (int c = 0; c < 3; c++) {
+                destination[px * 3 + c] = source[px * channels + (channels == 3 ? c : 0)];
+            }
         }
-        out << "\n";
     }
 
-    out.close();    
-}
\ No newline at end of file
+    for (size_t i = 0; i < _data.size(); i++) _data[i] = to_eight_bits(_float_data[i]);
+}
+
+void PPMImageFile::update_pixel(int px, int py, struct Colour new_colour) {
+    uint8_t* p = row(py) + px * 3;
+    p[0] = static_cast<uint8_t>(std::clamp(new_colour.r, 0, 255));
+    p[1] = static_cast<uint8_t>(std::clamp(new_colour.g, 0, 255));
+    p[2] = static_cast<uint8_t>(std::clamp(new_colour.b, 0, 255));
+}
+
+void PPMImageFile::write_current_image_to_file(std::string export_filename, ImageFormat format) {
+    std::string size = std::to_string(_width) + " " + std::to_string(_height);
+
+    if (format == ImageFormat::PFM) {
+        std::vector<float> rgb(_data.begin(), _data.end());
+        write_pfm_file(export_filename, _width, _height, rgb.data(), 1.0f / 255.0f);
+    } else if (format == ImageFormat::P6) {
+        write_image_file(export_filename, "P6\n" + size + "\n255\n",
+                         reinterpret_cast<const char*>(_data.data()), _data.size());
+    } else {
+        // format the text into memory first, at most 4 characters per value and 1 per pixel
+        std::string text(_data.size() * 4 + static_cast<size_t>(_width) * _height + _height, ' ');
+        char* position = text.data();
+        for (int py = 0; py < _height; py++) {
+            const uint8_t* p = row(py);
+            for (int i = 0; i < _width * 3; i++) {
+                position = std::to_chars(position, position + 3, static_cast<int>(p[i])).ptr;
+                position += (i % 3 == 2) ? 2 : 1;
+            }
+            *position++ = '\n';
+        }
+        write_image_file(export_filename, "P3\n" + size + "\n255\n", text.data(), position - text.data());
+    }
+}
@@ -1,97 +1,125 @@
 #include "Light.h"
+#include "LightGrid.h"
+#include "RenderStatistics.h"
+#include "ShadowCache.h"
+#include "Texture.h"
 
 void update_hit_from_intersection(Hit *h, Eigen::Vector3f intersection_point,
                                   Eigen::Vector3f normal,
-                                  float distance_along_ray, Mesh *mesh, float u,
-                                  float v) {
+                                  float distance_along_ray, const ShadingMaterial *material,
+                                  float u, float v, float uv_scale) {
   // update only if not hit yet or closer then best hit so far
   if (!h->is_hit || (h->is_hit && distance_along_ray < h->distance_along_ray)) {
     h->normal = normal;
     h->distance_along_ray = distance_along_ray;
     h->is_hit = true;
     h->intersection_point = intersection_point;
-    h->mesh = mesh;
+    h->material = material;
     h->u = u;
     h->v = v;
+    h->uv_scale = uv_scale;
   }
 };
 
-Eigen::Vector3f shade(Hit *hit, std::vector<Light> lights,
-                      CameraProperties *props, float Ia,
-                      std::unique_ptr<BoundingBoxHierarchyTree> &bbht,
-                      int depth, int max_depth) 
-{
-  Eigen::Vector3f P = hit->intersection_point;
-  Eigen::Vector3f N = hit->normal.normalized();
-  Eigen::Vector3f V = (P - props->location).normalized();
-  Eigen::Vector3f shaded = Eigen::Vector3f::Zero();
-
-  // convert to 0-1 colour space
-  Eigen::Vector3f base_colour(hit->mesh->get_material().base_colour.r / 255.0f,
-                              hit->mesh->get_material().base_colour.g / 255.0f,
-                              hit->mesh->get_material().base_colour.b / 255.0f);
+void update_hit_ray_cone(Hit *h, const Ray &ray, float width, float spread) {
+  // the cone grows linearly with distance, the bending of curved surfaces is ignored
+  h->cone_width = width + spread * h->distance_along_ray;
+  h->cone_spread = spread;
+  h->cone_cosine = std::abs(h->normal.normalized().dot(ray.direction.normalized()));
+}
+
+ShadingPoint get_shading_point(const Hit *hit, const CameraProperties *props) {
+  ShadingPoint point;
+  point.P = hit->intersection_point;
+  point.N = hit->normal.normalized();
+  point.V = (point.P - props->location).normalized();
+  point.material = hit->material;
+  point.base_colour = hit->material->base_colour;
 
   // if material has a image texture, read base colour
-  PPMImageFile *texture = hit->mesh->get_material().texture;
+  const Texture *texture = hit->material->texture;
   if (texture != nullptr && hit->u >= 0 && hit->v >= 0 && hit->u <= 1 &&
       hit->v <= 1) {
-    // Clamp coordinates to avoid segfaults at edges
-    float u_coord = std::min(hit->u, 0.999f);
-    float v_coord = std::min(hit->v, 0.999f);
-    Pixel pixel = texture->get_pixel(u_coord * texture->get_width(),
-                                     v_coord * texture->get_height());
-    base_colour[0] *= pixel.colour.r / 255.0f;
-    base_colour[1] *= pixel.colour.g / 255.0f;
-    base_colour[2] *= pixel.colour.b / 255.0f;
+    // the cone's footprint in uv units picks the mip level, it stretches at grazing angles
+    float lod = 0.0f;
+    if (hit->uv_scale > 0.0f && hit->cone_width > 0.0f) {
+      float uv_footprint = hit->cone_width / (std::max(hit->cone_cosine, 1e-3f) * hit->uv_scale);
+      lod = texture->get_lod(uv_footprint);
+    }
+    point.base_colour = point.base_colour.cwiseProduct(texture->sample(hit->u, hit->v, lod));
   }
+  return point;
+}
 
-  float kd = hit->mesh->get_material().kd;
-  float ks = hit->mesh->get_material().ks;
-  float ka = hit->mesh->get_material().ka;
-  float shininess = hit->mesh->get_material().shininess;
-  float reflectivity = hit->mesh->get_material().reflectivity;
-  float transparancy = hit->mesh->get_material().transparancy;
-  float ior = hit->mesh->get_material().ior;
-  int intersection_test_counter = 0;
-
-  shaded += ka * Ia * base_colour; // ambiant
-
-  for (Light &light : lights) {
-    float id = light.get_id();
-    float is = light.get_is();
-
-    Eigen::Vector3f light_vec = light.get_location() - P;
-    Eigen::Vector3f L = light_vec.normalized();
-    float distance_to_light = light_vec.norm();
-    float attenuation = std::min(1.0f / distance_to_light, 1.0f);
-
-    Ray shadow_ray(P + (N * 0.001f), L);
-    Hit shadow_hit;
-    bool in_shadow = false;
-
-    if (bbht->check_intersect(shadow_ray, &shadow_hit,
-                              &intersection_test_counter)) {
-      in_shadow = true;
-    }
+Eigen::Vector3f get_ambient(const ShadingPoint &point, float Ia) {
+  return point.material->ka * Ia * point.base_colour;
+}
 
-    if (!in_shadow) {
-      float diff_factor = std::max(0.0f, N.dot(L));
-      shaded += base_colour * kd * diff_factor * id * attenuation; // diffuse
+Ray get_shadow_ray(const ShadingPoint &point, const Light &light, float &distance_to_blocker) {
+  // only meshes between the point and the light can cast a shadow
+  Eigen::Vector3f L = (light.get_location() - point.P).normalized();
+  Ray shadow_ray(point.P + (point.N * 0.001f), L);
+  distance_to_blocker = (light.get_location() - shadow_ray.origin).norm();
+  return shadow_ray;
+}
 
-      Eigen::Vector3f H = (L - V).normalized();
-      float spec_factor = std::pow(std::max(0.0f, N.dot(H)), shininess);
-      shaded += base_colour * ks * spec_factor * is * attenuation; // specular
-    }
-  }
+void add_light(Eigen::Vector3f &shaded, const ShadingPoint &point, const Light &light, float weight) {
+  float id = light.get_id();
+  float is = light.get_is();
+  const Eigen::Vector3f &base_colour = point.base_colour;
+
+  Eigen::Vector3f light_vec = light.get_location() - point.P;
+  Eigen::Vector3f L = light_vec.normalized();
+  float distance_to_light = light_vec.norm();
+  float attenuation = std::min(1.0f / distance_to_light, 1.0f);
+
+  float diff_factor = std::max(0.0f, point.N.dot(L));
+  shaded += base_colour * point.material->kd * diff_factor * id * attenuation * weight; // diffuse
+
+  Eigen::Vector3f H = (L - point.V).normalized();
+  float spec_factor = std::pow(std::max(0.0f, point.N.dot(H)), point.material->shininess);
+  shaded += base_colour * point.material->ks * spec_factor * is * attenuation * weight; // specular
+}
+
+Ray get_reflection_ray(const ShadingPoint &point) {
+  Eigen::Vector3f R = (point.V - 2.0f * (point.N.dot(point.V)) * point.N).normalized();
+  return Ray(point.P + R * 0.001f, R);
+}
+
+Eigen::Vector3f blend_reflection(const Eigen::Vector3f &shaded, const Eigen::Vector3f &reflected_colour,
+                                 float reflectivity) {
+  return shaded * (1.0f - reflectivity) + reflected_colour * reflectivity;
+}
+
+Eigen::Vector3f shade(Hit *hit, const ShadingContext &context, ShadowCache *shadow_cache,
+                      RenderStatistics *statistics, int depth) {
+  ShadingPoint point = get_shading_point(hit, &context.camera);
+  float reflectivity = point.material->reflectivity;
+
+  Eigen::Vector3f shaded = get_ambient(point, context.ambient); // ambiant
+
+  context.light_grid.for_each_light(point.P, [&](uint32_t light_index, float weight) {
+    const Light &light = context.lights[light_index];
+    float distance_to_blocker;
+    Ray shadow_ray = get_shadow_ray(point, light, distance_to_blocker);
+    bool in_shadow = shadow_cache != nullptr
+        ? shadow_cache->occluded(context.tree, shadow_ray, distance_to_blocker, light_index, statistics)
+        : context.tree.occluded(shadow_ray, distance_to_blocker, statistics);
+    statistics->add_ray(RayType::SHADOW, in_shadow);
+
+    if (!in_shadow) add_light(shaded, point, light, weight);
+  });
 
   // reflection
-  if (reflectivity > 0.0f && depth < max_depth) {
-    Eigen::Vector3f R = (V - 2.0f * (N.dot(V)) * N).normalized();
-    Ray reflect_ray(P + R * 0.001f, R);
+  if (reflectivity > 0.0f && depth < context.max_depth) {
+    Ray reflect_ray = get_reflection_ray(point);
     Hit reflect_hit;
-    if (bbht->check_intersect(reflect_ray, &reflect_hit, &intersection_test_counter)) {
-      Eigen::Vector3f reflected_colour = shade(&reflect_hit, lights, props, Ia, bbht, depth + 1, max_depth);
-      shaded = shaded * (1.0f - reflectivity) + reflected_colour * reflectivity;
+    bool is_reflection_hit = context.tree.check_intersect(reflect_ray, &reflect_hit, statistics);
+    statistics->add_ray(RayType::REFLECTION, is_reflection_hit);
+    if (is_reflection_hit) {
+      update_hit_ray_cone(&reflect_hit, reflect_ray, hit->cone_width, hit->cone_spread);
+      Eigen::Vector3f reflected_colour = shade(&reflect_hit, context, shadow_cache, statistics, depth + 1);
+      shaded = blend_reflection(shaded, reflected_colour, reflectivity);
     }
   }
 
@@ -0,0 +1,92 @@
+#include "LightGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+LightGrid::LightGrid(const std::vector<Light>& lights, float cutoff, int samples)
+    : _cutoff(std::max(cutoff, 0.0f)), _samples(std::max(samples, 0)) {
+    for (uint32_t i = 0; i < lights.size(); i++) {
+        const Light& light = lights[i];
+        float power = light.get_id() + light.get_is();
+        float radius = get_is_culling() ? power * 255.0f / _cutoff : std::numeric_limits<float>::infinity();
+        _positions.push_back(light.get_location());
+        _radii_squared.push_back(radius * radius);
+        _powers.push_back(power);
+        _all_lights.push_back(i);
+    }
+    if (!get_is_culling() || lights.empty()) return;
+
+    // the grid covers every sphere of influence, a point outside it is reached by no light
+    Eigen::Vector3f min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f max = Eigen::Vector3f::Constant(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < lights.size(); i++) {
+        float radius = get_radius(i);
+        min = min.cwiseMin(_positions[i] - Eigen::Vector3f::Constant(radius));
+        max = max.cwiseMax(_positions[i] + Eigen::Vector3f::Constant(radius));
+    }
+
+    // roughly cubic cells, as many as the lights call for
+    Eigen::Vector3f extent = (max - min).cwiseMax(Eigen::Vector3f::Constant(1e-6f));
+    float cells_wanted = static_cast<float>(lights.size() * LIGHT_GRID_CELLS_PER_LIGHT);
+    float cell_size = std::cbrt(extent.prod() / cells_wanted);
+    for (int axis = 0; axis < 3; axis++) {
+        _resolution[axis] = std::clamp(static_cast<int>(std::ceil(extent[axis] / cell_size)), 1, LIGHT_GRID_MAX_RESOLUTION);
+    }
+    _min = min;
+    _inv_cell_size = Eigen::Vector3f(_resolution[0] / extent[0], _resolution[1] / extent[1], _resolution[2] / extent[2]);
+
+    // each light is listed in every cell its sphere's box overlaps, counted first then filled in
+    auto get_cell_range = [&](size_t i, int lo[3], int hi[3]) {
+        float radius = get_radius(i);
+        for (int axis = 0; axis < 3; axis++) {
+            lo[axis] = std::clamp(static_cast<int>((_positions[i][axis] - radius - _min[axis]) * _inv_cell_size[axis]),
+                                  0, _resolution[axis] - 1);
+            hi[axis] = std::clamp(static_cast<int>((_positions[i][axis] + radius - _min[axis]) * _inv_cell_size[axis]),
+                                  0, _resolution[axis] - 1);
+        }
+    };
+    size_t number_of_cells = static_cast<size_t>(_resolution[0]) * _resolution[1] * _resolution[2];
+    _cell_starts.assign(number_of_cells + 1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        std::vector<uint32_t> cursor(_cell_starts.begin(), _cell_starts.end() - 1);
+        for (size_t i = 0; i < lights.size(); i++) {
+            int lo[3], hi[3];
+            get_cell_range(i, lo, hi);
+            for (int z = lo[2]; z <= hi[2]; z++) {
+                for (int y = lo[1]; y <= hi[1]; y++) {
+                    for (int x = lo[0]; x <= hi[0]; x++) {
+                        size_t cell = (static_cast<size_t>(z) * _resolution[1] + y) * _resolution[0] + x;
+                        if (pass == 0) {
+                            _cell_starts[cell + 1]++;
+                        } else {
+                            _cell_lights[cursor[cell]++] = static_cast<uint32_t>(i);
+                        }
+                    }
+                }
+            }
+        }
+        if (pass == 0) {
+            for (size_t cell = 0; cell < number_of_cells; cell++) _cell_starts[cell + 1] += _cell_starts[cell];
+            _cell_lights.resize(_cell_starts.back());
+        }
+    }
+}
+
+std::span<const uint32_t> LightGrid::get_candidates(const Eigen::Vector3f& P) const {
+    if (!get_is_culling()) return _all_lights;
+    if (_cell_starts.empty()) return {};
+
+    size_t cell = 0;
+    for (int axis = 2; axis >= 0; axis--) {
+        float offset = (P[axis] - _min[axis]) * _inv_cell_size[axis];
+        if (!(offset >= 0.0f && offset < static_cast<float>(_resolution[axis]))) return {};
+        cell = cell * _resolution[axis] + static_cast<size_t>(offset);
+    }
+    return std::span<const uint32_t>(_cell_lights).subspan(_cell_starts[cell], _cell_starts[cell + 1] - _cell_starts[cell]);
+}
+
+float LightGrid::get_average_lights_per_cell() const {
+    if (get_number_of_cells() == 0) return static_cast<float>(_all_lights.size());
+    return static_cast<float>(_cell_lights.size()) / get_number_of_cells();
+}
@@ -0,0 +1,187 @@
+#include "PrimitiveStore.h"
+#include "Mesh.h"
+#include "RayPacket.h"
+
+PrimitiveStore::PrimitiveStore(PrimitiveArrays arrays,
+                               std::vector<std::shared_ptr<const TriangleMeshData>> triangle_mesh_data,
+                               std::vector<Material> materials, std::vector<std::string> names,
+                               std::shared_ptr<const void> owner)
+    : _cubes(arrays.cubes), _spheres(arrays.spheres), _planes(arrays.planes), _triangle_meshes(arrays.triangle_meshes),
+      _references(arrays.references), _materials(std::move(materials)),
+      _triangle_mesh_data(std::move(triangle_mesh_data)), _owner(std::move(owner)) {
+    _metadata.reserve(names.size());
+    for (std::string& name : names) _metadata.push_back({std::move(name)});
+    _shading_materials.reserve(_materials.size());
+    for (const Material& material : _materials) _shading_materials.push_back(compile_material(material));
+    for (uint32_t i = 0; i < _triangle_mesh_data.size(); i++) _triangle_mesh_indices.emplace(_triangle_mesh_data[i].get(), i);
+}
+
+PrimitiveStore PrimitiveStore::from_meshes(const std::vector<std::unique_ptr<Mesh>>& meshes) {
+    PrimitiveStore store;
+    for (const auto& mesh : meshes) {
+        store.add(*mesh);
+    }
+    return store;
+}
+
+uint32_t PrimitiveStore::add(Mesh& mesh) {
+    uint32_t material_index = static_cast<uint32_t>(_materials.size());
+    uint32_t metadata_index = static_cast<uint32_t>(_metadata.size());
+    _materials.push_back(mesh.get_material());
+    _shading_materials.push_back(compile_material(_materials.back()));
+    _metadata.push_back({mesh.get_name()});
+
+    uint32_t reference = NO_PRIMITIVE;
+    switch (mesh.get_meshtype()) {
+        case MeshType::CUBE: {
+            CubePrimitive cube = static_cast<Cube&>(mesh).get_primitive();
+            cube.material_index = material_index;
+            cube.metadata_index = metadata_index;
+            reference = make_primitive_reference(MeshType::CUBE, static_cast<uint32_t>(_cube_storage.size()));
+            _cube_storage.push_back(cube);
+            break;
+        }
+        case MeshType::SPHERE: {
+            SpherePrimitive sphere = static_cast<Sphere&>(mesh).get_primitive();
+            sphere.material_index = material_index;
+            sphere.metadata_index = metadata_index;
+            reference = make_primitive_reference(MeshType::SPHERE, static_cast<uint32_t>(_sphere_storage.size()));
+            _sphere_storage.push_back(sphere);
+            break;
+        }
+        case MeshType::PLANE: {
+            PlanePrimitive plane = static_cast<Plane&>(mesh).get_primitive();
+            plane.material_index = material_index;
+            plane.metadata_index = metadata_index;
+            reference = make_primitive_reference(MeshType::PLANE, static_cast<uint32_t>(_plane_storage.size()));
+            _plane_storage.push_back(plane);
+            break;
+        }
+        case MeshType::TRIANGLE_MESH: {
+            TriangleMesh& triangle_mesh = static_cast<TriangleMesh&>(mesh);
+            TriangleMeshInstance instance = triangle_mesh.get_primitive();
+
+            // instances of the same mesh share one copy of its data
+            auto [data, is_new] = _triangle_mesh_indices.try_emplace(triangle_mesh.get_data().get(),
+                                                                     static_cast<uint32_t>(_triangle_mesh_data.size()));
+            if (is_new) _triangle_mesh_data.push_back(triangle_mesh.get_data());
+            instance.mesh_index = data->second;
+            instance.material_index = material_index;
+            instance.metadata_index = metadata_index;
+            reference = make_primitive_reference(MeshType::TRIANGLE_MESH,
+                                                 static_cast<uint32_t>(_triangle_mesh_storage.size()));
+            _triangle_mesh_storage.push_back(instance);
+            break;
+        }
+    }
+
+    _reference_storage.push_back(reference);
+
+    // the storage may have moved, so the views are pointed at it again
+    _cubes = _cube_storage;
+    _spheres = _sphere_storage;
+    _planes = _plane_storage;
+    _triangle_meshes = _triangle_mesh_storage;
+    _references = _reference_storage;
+    return reference;
+}
+
+bool PrimitiveStore::check_intersect(uint32_t reference, const Ray& ray, Hit* hit) const {
+    uint32_t index = primitive_index(reference);
+    switch (primitive_type(reference)) {
+        case MeshType::CUBE:
+            return check_intersect_cube(_cubes[index], ray, &_shading_materials[_cubes[index].material_index], hit);
+        case MeshType::SPHERE:
+            return check_intersect_sphere(_spheres[index], ray, &_shading_materials[_spheres[index].material_index], hit);
+        case MeshType::PLANE:
+            return check_intersect_plane(_planes[index], ray, &_shading_materials[_planes[index].material_index], hit);
+        case MeshType::TRIANGLE_MESH: {
+            const TriangleMeshInstance& instance = _triangle_meshes[index];
+            return check_intersect_triangle_mesh(instance, *_triangle_mesh_data[instance.mesh_index], ray,
+                                                 &_shading_materials[instance.material_index], hit);
+        }
+    }
+    return false;
+}
+
+void PrimitiveStore::get_bounds(uint32_t reference, Eigen::Vector3f& min, Eigen::Vector3f& max) const {
+    uint32_t index = primitive_index(reference);
+    switch (primitive_type(reference)) {
+        case MeshType::CUBE: {
+            const CubePrimitive& cube = _cubes[index];
+            min = as_vec3(cube.translation) - as_vec3(cube.scale);
+            max = as_vec3(cube.translation) + as_vec3(cube.scale);
+            break;
+        }
+        case MeshType::SPHERE: {
+            const SpherePrimitive& sphere = _spheres[index];
+            min = as_vec3(sphere.location) - as_vec3(sphere.scale);
+            max = as_vec3(sphere.location) + as_vec3(sphere.scale);
+            break;
+        }
+        case MeshType::PLANE: {
+            const PlanePrimitive& plane = _planes[index];
+            min = as_vec3(plane.corners[0]);
+            max = as_vec3(plane.corners[0]);
+            for (int i = 1; i < 4; i++) {
+                min = min.cwiseMin(as_vec3(plane.corners[i]));
+                max = max.cwiseMax(as_vec3(plane.corners[i]));
+            }
+            break;
+        }
+        case MeshType::TRIANGLE_MESH: {
+            min = as_vec3(_triangle_meshes[index].min);
+            max = as_vec3(_triangle_meshes[index].max);
+            break;
+        }
+    }
+
+    // a plane is flat and still counts hits just past its corners, so every box is padded to keep
+    // the tree from culling a hit the primitive's own test would accept
+    min -= Eigen::Vector3f::Constant(PRIMITIVE_BOUNDS_PADDING);
+    max += Eigen::Vector3f::Constant(PRIMITIVE_BOUNDS_PADDING);
+}
+
+Eigen::Vector3f PrimitiveStore::get_centroid(uint32_t reference) const {
+    uint32_t index = primitive_index(reference);
+    switch (primitive_type(reference)) {
+        case MeshType::CUBE:
+            return as_vec3(_cubes[index].translation);
+        case MeshType::SPHERE:
+            return as_vec3(_spheres[index].location);
+        case MeshType::PLANE: {
+            // matches Plane::get_centroid
+            const PlanePrimitive& plane = _planes[index];
+            return as_vec3(plane.corners[0]) + (as_vec3(plane.corners[3]) - as_vec3(plane.corners[0]));
+        }
+        case MeshType::TRIANGLE_MESH:
+            return (as_vec3(_triangle_meshes[index].min) + as_vec3(_triangle_meshes[index].max)) / 2.0f;
+    }
+    return Eigen::Vector3f::Zero();
+}
+
+uint32_t PrimitiveStore::metadata_index(uint32_t reference) const {
+    uint32_t index = primitive_index(reference);
+    switch (primitive_type(reference)) {
+        case MeshType::CUBE:   return _cubes[index].metadata_index;
+        case MeshType::SPHERE: return _spheres[index].metadata_index;
+        case MeshType::PLANE:  return _planes[index].metadata_index;
+        case MeshType::TRIANGLE_MESH: return _triangle_meshes[index].metadata_index;
+    }
+    return 0;
+}
+
+const std::string& PrimitiveStore::get_name(uint32_t reference) const {
+    return _metadata[metadata_index(reference)].name;
+}
+
+void intersect_triangle_mesh_packet(const void* store, uint32_t reference, const RayPacket& packet, float* distance) {
+    const PrimitiveStore& primitive_store = *static_cast<const PrimitiveStore*>(store);
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        Ray ray(Eigen::Vector3f(packet.origin[0][lane], packet.origin[1][lane], packet.origin[2][lane]),
+                Eigen::Vector3f(packet.direction[0][lane], packet.direction[1][lane], packet.direction[2][lane]));
+        float t;
+        distance[lane] = primitive_store.intersect(reference, ray, t, distance[lane]) ? t
+                                                                                    : std::numeric_limits<float>::infinity();
+    }
+}
@@ -0,0 +1,243 @@
+#include "Primitives.h"
+#include "Light.h"
+
+void copy_vec3(float* destination, const Eigen::Vector3f& source) {
+    for (int i = 0; i < 3; i++) destination[i] = source[i];
+}
+
+void copy_mat3(float* destination, const Eigen::Matrix3f& source) {
+    Eigen::Map<Eigen::Matrix3f> map(destination);
+    map = source;
+}
+
+CubePrimitive make_cube_primitive(Eigen::Vector3f translation, Eigen::Vector3f rotation, Eigen::Vector3f scale) {
+    CubePrimitive cube{};
+    Eigen::Matrix3f R = euler_to_matrix(rotation);
+    copy_vec3(cube.translation, translation);
+    copy_vec3(cube.scale, scale);
+    copy_vec3(cube.inv_scale, scale.cwiseInverse());
+    copy_mat3(cube.rotation, R);
+    copy_mat3(cube.inv_rotation, R.transpose());
+    return cube;
+}
+
+SpherePrimitive make_sphere_primitive(Eigen::Vector3f location, Eigen::Vector3f rotation, Eigen::Vector3f scale) {
+    SpherePrimitive sphere{};
+    Eigen::Matrix3f R = euler_to_matrix(rotation);
+    copy_vec3(sphere.location, location);
+    copy_vec3(sphere.scale, scale);
+    copy_vec3(sphere.inv_scale, scale.cwiseInverse());
+    copy_mat3(sphere.rotation, R);
+    copy_mat3(sphere.inv_rotation, R.transpose());
+    return sphere;
+}
+
+PlanePrimitive make_plane_primitive(const std::array<Eigen::Vector3f, 4>& corners) {
+    PlanePrimitive plane{};
+    for (int i = 0; i < 4; i++) copy_vec3(plane.corners[i], corners[i]);
+
+    // find a point on the plane and a normal vector
+    Eigen::Vector3f normal = (corners[0] - corners[1]).cross(corners[0] - corners[2]).normalized();
+    Eigen::Vector3f u_axis = corners[2] - corners[0];
+    Eigen::Vector3f v_axis = corners[3] - corners[0];
+    copy_vec3(plane.point, corners[0]);
+    copy_vec3(plane.normal, normal);
+    copy_vec3(plane.u_axis, u_axis);
+    copy_vec3(plane.v_axis, v_axis);
+    plane.u_axis_squared_norm = u_axis.squaredNorm();
+    plane.v_axis_squared_norm = v_axis.squaredNorm();
+    return plane;
+}
+
+bool check_intersect_cube(const CubePrimitive& cube, const Ray& ray, const ShadingMaterial* material, Hit* hit) {
+    // rotate to local space
+    Eigen::Vector3f local_origin = as_mat3(cube.inv_rotation) * (ray.origin - as_vec3(cube.translation));
+    Eigen::Vector3f local_direction = as_mat3(cube.inv_rotation) * ray.direction;
+
+    // scale into unit
+    Eigen::Vector3f inv_scale = as_vec3(cube.inv_scale);
+    local_origin = local_origin.cwiseProduct(inv_scale);
+    local_direction = local_direction.cwiseProduct(inv_scale);
+
+    const Eigen::Vector3f box_min(-0.5f, -0.5f, -0.5f);
+    const Eigen::Vector3f box_max( 0.5f,  0.5f,  0.5f);
+
+    float t_min_curr = -std::numeric_limits<float>::infinity();
+    float t_max_curr = std::numeric_limits<float>::infinity();
+
+    Eigen::Vector3f t_min_normal = Eigen::Vector3f::Zero();
+    Eigen::Vector3f t_max_normal = Eigen::Vector3f::Zero();
+
+    // perform the 'slab test'
+    for (int i = 0; i < 3; ++i) {
+        if (std::abs(local_direction[i]) < 1e-6f) {
+            if (local_origin[i] < box_min[i] || local_origin[i] > box_max[i]) {
+                return false;
+            }
+        } else {
+            float inv_d = 1.0f / local_direction[i];
+            float t0 = (box_min[i] - local_origin[i]) * inv_d;
+            float t1 = (box_max[i] - local_origin[i]) * inv_d;
+
+            float sign = (inv_d < 0.0f) ? 1.0f : -1.0f;
+            Eigen::Vector3f current_normal = Eigen::Vector3f::Zero();
+            current_normal[i] = 1.0f;
+
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+
+            if (t0 > t_min_curr) {
+                t_min_curr = t0;
+                t_min_normal = current_normal * sign;
+            }
+
+            if (t1 < t_max_curr) {
+                t_max_curr = t1;
+                t_max_normal = current_normal * -sign;
+            }
+
+            if (t_max_curr <= t_min_curr) return false;
+        }
+    }
+
+    if (t_max_curr < 0) return false;
+
+    float t_hit;
+    Eigen::Vector3f local_normal;
+
+    if (t_min_curr < 0) {
+        t_hit = t_max_curr;
+        local_normal = t_max_normal;
+    } else {
+        t_hit = t_min_curr;
+        local_normal = t_min_normal;
+    }
+
+    if (t_hit > 0) {
+        Eigen::Vector3f local_hit = local_origin + (local_direction * t_hit);
+
+        float u = 0.0f;
+        float v = 0.0f;
+        float uv_scale = 0.0f; // each face maps the unit square onto two of the scaled axes
+
+        if (std::abs(local_normal.x()) > 0.5f) {
+            u = local_hit.y() + 0.5f;
+            v = local_hit.z() + 0.5f;
+            uv_scale = std::sqrt(cube.scale[1] * cube.scale[2]);
+        }
+        else if (std::abs(local_normal.y()) > 0.5f) {
+            u = 0.5f - local_hit.x();
+            v = 0.5f - local_hit.z();
+            uv_scale = std::sqrt(cube.scale[0] * cube.scale[2]);
+        }
+        else {
+            u = local_hit.x() + 0.5f;
+            v = local_hit.y() + 0.5f;
+            uv_scale = std::sqrt(cube.scale[0] * cube.scale[1]);
+        }
+
+        // rotate hit and normal back into world coordinates
+        Eigen::Vector3f world_hit = as_mat3(cube.rotation) * (local_hit.cwiseProduct(as_vec3(cube.scale))) + as_vec3(cube.translation);
+        Eigen::Vector3f world_normal = (as_mat3(cube.rotation) * local_normal.cwiseProduct(inv_scale)).normalized();
+
+        update_hit_from_intersection(hit, world_hit, world_normal, t_hit, material, u, v, uv_scale);
+
+        return true;
+    }
+
+    return false;
+}
+
+bool check_intersect_sphere(const SpherePrimitive& sphere, const Ray& ray, const ShadingMaterial* material, Hit* hit) {
+    // rotate into local space
+    Eigen::Vector3f local_origin = as_mat3(sphere.inv_rotation) * (ray.origin - as_vec3(sphere.location));
+    Eigen::Vector3f local_dir = as_mat3(sphere.inv_rotation) * ray.direction;
+
+    // turn ellipsoid into unit
+    Eigen::Vector3f inv_scale = as_vec3(sphere.inv_scale);
+    local_origin = local_origin.cwiseProduct(inv_scale);
+    local_dir = local_dir.cwiseProduct(inv_scale);
+
+    // ray intersect
+    float a = local_dir.dot(local_dir);
+    float b = 2.0f * local_origin.dot(local_dir);
+    float c = local_origin.dot(local_origin) - 1.0f; // radius = 1 after scaling
+
+    float discriminant = b * b - 4.0f * a * c;
+    if (discriminant < 0.0f) return false;
+
+    float sqrt_disc = std::sqrt(discriminant);
+    float t0 = (-b - sqrt_disc) / (2.0f * a);
+    float t1 = (-b + sqrt_disc) / (2.0f * a);
+    if (t0 > t1) std::swap(t0, t1);
+
+    if (t0 < 0) {
+        t0 = t1;
+        if (t0 < 0) return false;
+    }
+
+    // compute intersection point in local space
+    Eigen::Vector3f local_hit = local_origin + t0 * local_dir;
+    Eigen::Vector3f local_normal = local_hit.normalized();
+
+    // transform hit back to world space
+    Eigen::Vector3f world_hit = as_mat3(sphere.rotation) * (local_hit.cwiseProduct(as_vec3(sphere.scale))) + as_vec3(sphere.location);
+    Eigen::Vector3f world_normal = (as_mat3(sphere.rotation) * (local_normal.cwiseProduct(inv_scale))).normalized();
+
+    float u = 0.5f + (std::atan2(local_hit.z(), local_hit.x()) / (2.0f * M_PI));
+    float v = 0.5f - (std::asin(local_hit.y()) / M_PI);
+
+    // u goes around the equator and v from pole to pole, take the mean of the two lengths
+    float radius = std::cbrt(sphere.scale[0] * sphere.scale[1] * sphere.scale[2]);
+    float uv_scale = static_cast<float>(M_PI * M_SQRT2) * radius;
+
+    update_hit_from_intersection(
+        hit,
+        world_hit,
+        world_normal,
+        t0,
+        material,
+        u,
+        v,
+        uv_scale
+    );
+
+    return true;
+}
+
+bool check_intersect_plane(const PlanePrimitive& plane, const Ray& ray, const ShadingMaterial* material, Hit* hit) {
+    Eigen::Vector3f normal = as_vec3(plane.normal);
+    float denom = ray.direction.dot(normal);
+    if (std::abs(denom) < 1e-6f) return false; // parallel
+
+    Eigen::Vector3f p0l0 = as_vec3(plane.point) - ray.origin;
+    float t = p0l0.dot(normal) / denom;
+    if (t < 0) return false; // behind ray
+
+    Eigen::Vector3f ip = ray.origin + t * ray.direction;
+
+    Eigen::Vector3f hit_vec = ip - as_vec3(plane.corners[0]);
+
+    float u = hit_vec.dot(as_vec3(plane.u_axis)) / plane.u_axis_squared_norm;
+    float v = hit_vec.dot(as_vec3(plane.v_axis)) / plane.v_axis_squared_norm;
+
+    if (plane_contains(plane, ip)) {
+        // u and v run along the two edges, take the mean of their lengths
+        float uv_scale = std::sqrt(std::sqrt(plane.u_axis_squared_norm * plane.v_axis_squared_norm));
+
+        update_hit_from_intersection(
+            hit,
+            ip,
+            normal,
+            t,
+            material,
+            u,
+            v,
+            uv_scale
+        );
+        return true;
+    }
+
+    return false;
+}
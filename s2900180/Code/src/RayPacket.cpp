@@ -0,0 +1,144 @@
+#include "RayPacket.h"
+#include "PacketKernels.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RAYTRACER_HAS_SSE_KERNELS
+#endif
+
+namespace {
+
+// plain C++ backend, one loop per operation, for CPUs without SSE
+struct ScalarBackend {
+    struct Float { float v[RAY_PACKET_SIZE]; };
+    struct Mask { bool v[RAY_PACKET_SIZE]; };
+
+    template <typename F>
+    static Float map(F f) {
+        Float result;
+        for (int i = 0; i < RAY_PACKET_SIZE; i++) result.v[i] = f(i);
+        return result;
+    }
+
+    template <typename F>
+    static Mask test(F f) {
+        Mask result;
+        for (int i = 0; i < RAY_PACKET_SIZE; i++) result.v[i] = f(i);
+        return result;
+    }
+
+    static Float load(const float* values) { return map([&](int i) { return values[i]; }); }
+    static void store(float* values, Float a) { std::memcpy(values, a.v, sizeof(a.v)); }
+    static Float set1(float value) { return map([&](int) { return value; }); }
+    static Float abs(Float a) { return map([&](int i) { return std::fabs(a.v[i]); }); }
+    static Float sqrt(Float a) { return map([&](int i) { return std::sqrt(a.v[i]); }); }
+    static Mask none() { return test([](int) { return false; }); }
+    static Mask andnot(Mask a, Mask b) { return test([&](int i) { return !a.v[i] && b.v[i]; }); }
+    static Float select(Mask m, Float a, Float b) { return map([&](int i) { return m.v[i] ? a.v[i] : b.v[i]; }); }
+    static int movemask(Mask m) {
+        int bits = 0;
+        for (int i = 0; i < RAY_PACKET_SIZE; i++) bits |= m.v[i] << i;
+        return bits;
+    }
+};
+
+ScalarBackend::Float operator+(ScalarBackend::Float a, ScalarBackend::Float b) { return ScalarBackend::map([&](int i) { return a.v[i] + b.v[i]; }); }
+ScalarBackend::Float operator-(ScalarBackend::Float a, ScalarBackend::Float b) { return ScalarBackend::map([&](int i) { return a.v[i] - b.v[i]; }); }
+ScalarBackend::Float operator*(ScalarBackend::Float a, ScalarBackend::Float b) { return ScalarBackend::map([&](int i) { return a.v[i] * b.v[i]; }); }
+ScalarBackend::Float operator/(ScalarBackend::Float a, ScalarBackend::Float b) { return ScalarBackend::map([&](int i) { return a.v[i] / b.v[i]; }); }
+ScalarBackend::Float operator-(ScalarBackend::Float a) { return ScalarBackend::map([&](int i) { return -a.v[i]; }); }
+ScalarBackend::Mask operator<(ScalarBackend::Float a, ScalarBackend::Float b) { return ScalarBackend::test([&](int i) { return a.v[i] < b.v[i]; }); }
+ScalarBackend::Mask operator<=(ScalarBackend::Float a, ScalarBackend::Float b) { return ScalarBackend::test([&](int i) { return a.v[i] <= b.v[i]; }); }
+ScalarBackend::Mask operator>(ScalarBackend::Float a, ScalarBackend::Float b) { return ScalarBackend::test([&](int i) { return a.v[i] > b.v[i]; }); }
+ScalarBackend::Mask operator>=(ScalarBackend::Float a, ScalarBackend::Float b) { return ScalarBackend::test([&](int i) { return a.v[i] >= b.v[i]; }); }
+ScalarBackend::Mask operator&(ScalarBackend::Mask a, ScalarBackend::Mask b) { return ScalarBackend::test([&](int i) { return a.v[i] && b.v[i]; }); }
+ScalarBackend::Mask operator|(ScalarBackend::Mask a, ScalarBackend::Mask b) { return ScalarBackend::test([&](int i) { return a.v[i] || b.v[i]; }); }
+
+#ifdef RAYTRACER_HAS_SSE_KERNELS
+// SSE2 backend, part of every x86-64 CPU. Eight lanes are held as two registers of four
+struct SseBackend {
+    struct Float { __m128 lo, hi; };
+    struct Mask { __m128 lo, hi; };
+
+    static Float load(const float* values) { return {_mm_loadu_ps(values), _mm_loadu_ps(values + 4)}; }
+    static void store(float* values, Float a) { _mm_storeu_ps(values, a.lo); _mm_storeu_ps(values + 4, a.hi); }
+    static Float set1(float value) { return {_mm_set1_ps(value), _mm_set1_ps(value)}; }
+    static Float abs(Float a) {
+        __m128 sign = _mm_set1_ps(-0.0f);
+        return {_mm_andnot_ps(sign, a.lo), _mm_andnot_ps(sign, a.hi)};
+    }
+    static Float sqrt(Float a) { return {_mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi)}; }
+    static Mask none() { return {_mm_setzero_ps(), _mm_setzero_ps()}; }
+    static Mask andnot(Mask a, Mask b) { return {_mm_andnot_ps(a.lo, b.lo), _mm_andnot_ps(a.hi, b.hi)}; }
+    static Float select(Mask m, Float a, Float b) {
+        return {_mm_or_ps(_mm_and_ps(m.lo, a.lo), _mm_andnot_ps(m.lo, b.lo)),
+                _mm_or_ps(_mm_and_ps(m.hi, a.hi), _mm_andnot_ps(m.hi, b.hi))};
+    }
+    static int movemask(Mask m) { return _mm_movemask_ps(m.lo) | (_mm_movemask_ps(m.hi) << 4); }
+};
+
+SseBackend::Float operator+(SseBackend::Float a, SseBackend::Float b) { return {_mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi)}; }
+SseBackend::Float operator-(SseBackend::Float a, SseBackend::Float b) { return {_mm_sub_ps(a.lo, b.lo), _mm_sub_ps(a.hi, b.hi)}; }
+SseBackend::Float operator*(SseBackend::Float a, SseBackend::Float b) { return {_mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi)}; }
+SseBackend::Float operator/(SseBackend::Float a, SseBackend::Float b) { return {_mm_div_ps(a.lo, b.lo), _mm_div_ps(a.hi, b.hi)}; }
+SseBackend::Float operator-(SseBackend::Float a) {
+    __m128 sign = _mm_set1_ps(-0.0f);
+    return {_mm_xor_ps(a.lo, sign), _mm_xor_ps(a.hi, sign)};
+}
+SseBackend::Mask operator<(SseBackend::Float a, SseBackend::Float b) { return {_mm_cmplt_ps(a.lo, b.lo), _mm_cmplt_ps(a.hi, b.hi)}; }
+SseBackend::Mask operator<=(SseBackend::Float a, SseBackend::Float b) { return {_mm_cmple_ps(a.lo, b.lo), _mm_cmple_ps(a.hi, b.hi)}; }
+SseBackend::Mask operator>(SseBackend::Float a, SseBackend::Float b) { return {_mm_cmpgt_ps(a.lo, b.lo), _mm_cmpgt_ps(a.hi, b.hi)}; }
+SseBackend::Mask operator>=(SseBackend::Float a, SseBackend::Float b) { return {_mm_cmpge_ps(a.lo, b.lo), _mm_cmpge_ps(a.hi, b.hi)}; }
+SseBackend::Mask operator&(SseBackend::Mask a, SseBackend::Mask b) { return {_mm_and_ps(a.lo, b.lo), _mm_and_ps(a.hi, b.hi)}; }
+SseBackend::Mask operator|(SseBackend::Mask a, SseBackend::Mask b) { return {_mm_or_ps(a.lo, b.lo), _mm_or_ps(a.hi, b.hi)}; }
+#endif
+
+} // namespace
+
+void traverse_packet_scalar(const PacketTraversalData& data, const RayPacket& packet, PacketHit& hit, RenderStatistics* statistics) {
+    traverse_packet<ScalarBackend>(data, packet, hit, statistics);
+}
+
+void traverse_packet_sse(const PacketTraversalData& data, const RayPacket& packet, PacketHit& hit, RenderStatistics* statistics) {
+#ifdef RAYTRACER_HAS_SSE_KERNELS
+    traverse_packet<SseBackend>(data, packet, hit, statistics);
+#else
+    traverse_packet_scalar(data, packet, hit, statistics);
+#endif
+}
+
+namespace {
+
+struct PacketTraversalChoice {
+    PacketTraversalFunction function;
+    const char* name;
+};
+
+PacketTraversalChoice choose_packet_traversal() {
+#if defined(RAYTRACER_HAS_AVX2_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+    // CPUs with AVX-512 also take this path, eight lanes match the packet size
+    if (__builtin_cpu_supports("avx2")) return {traverse_packet_avx2, "AVX2"};
+#endif
+#ifdef RAYTRACER_HAS_SSE_KERNELS
+    return {traverse_packet_sse, "SSE2"};
+#else
+    return {traverse_packet_scalar, "scalar"};
+#endif
+}
+
+const PacketTraversalChoice& get_packet_traversal_choice() {
+    static const PacketTraversalChoice choice = choose_packet_traversal();
+    return choice;
+}
+
+} // namespace
+
+PacketTraversalFunction select_packet_traversal() {
+    return get_packet_traversal_choice().function;
+}
+
+const char* get_packet_traversal_name() {
+    return get_packet_traversal_choice().name;
+}
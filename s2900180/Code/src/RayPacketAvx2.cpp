@@ -0,0 +1,40 @@
+// built with -mavx2 (see CMakeLists.txt), only ever called once the CPU is known to support it
+#include "RayPacket.h"
+#include "PacketKernels.h"
+#include <immintrin.h>
+
+namespace {
+
+// AVX2 backend, all eight lanes in one register
+struct Avx2Backend {
+    struct Float { __m256 v; };
+    struct Mask { __m256 v; };
+
+    static Float load(const float* values) { return {_mm256_loadu_ps(values)}; }
+    static void store(float* values, Float a) { _mm256_storeu_ps(values, a.v); }
+    static Float set1(float value) { return {_mm256_set1_ps(value)}; }
+    static Float abs(Float a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+    static Float sqrt(Float a) { return {_mm256_sqrt_ps(a.v)}; }
+    static Mask none() { return {_mm256_setzero_ps()}; }
+    static Mask andnot(Mask a, Mask b) { return {_mm256_andnot_ps(a.v, b.v)}; }
+    static Float select(Mask m, Float a, Float b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+    static int movemask(Mask m) { return _mm256_movemask_ps(m.v); }
+};
+
+Avx2Backend::Float operator+(Avx2Backend::Float a, Avx2Backend::Float b) { return {_mm256_add_ps(a.v, b.v)}; }
+Avx2Backend::Float operator-(Avx2Backend::Float a, Avx2Backend::Float b) { return {_mm256_sub_ps(a.v, b.v)}; }
+Avx2Backend::Float operator*(Avx2Backend::Float a, Avx2Backend::Float b) { return {_mm256_mul_ps(a.v, b.v)}; }
+Avx2Backend::Float operator/(Avx2Backend::Float a, Avx2Backend::Float b) { return {_mm256_div_ps(a.v, b.v)}; }
+Avx2Backend::Float operator-(Avx2Backend::Float a) { return {_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))}; }
+Avx2Backend::Mask operator<(Avx2Backend::Float a, Avx2Backend::Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+Avx2Backend::Mask operator<=(Avx2Backend::Float a, Avx2Backend::Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+Avx2Backend::Mask operator>(Avx2Backend::Float a, Avx2Backend::Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+Avx2Backend::Mask operator>=(Avx2Backend::Float a, Avx2Backend::Float b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+Avx2Backend::Mask operator&(Avx2Backend::Mask a, Avx2Backend::Mask b) { return {_mm256_and_ps(a.v, b.v)}; }
+Avx2Backend::Mask operator|(Avx2Backend::Mask a, Avx2Backend::Mask b) { return {_mm256_or_ps(a.v, b.v)}; }
+
+} // namespace
+
+void traverse_packet_avx2(const PacketTraversalData& data, const RayPacket& packet, PacketHit& hit, RenderStatistics* statistics) {
+    traverse_packet<Avx2Backend>(data, packet, hit, statistics);
+}
@@ -9,71 +9,649 @@ void RayTracer::create_settings_from_command_args(int argc, char* argv[]) {
             _ray_tracer_settings.output_filename = argv[i+1];
         } else if (!strcmp(current_setting, "--antialiasing")) {
             _ray_tracer_settings.amount_of_antialiasing_samples_per_pixel = atoi(argv[i+1]); 
+        } else if (!strcmp(current_setting, "--sampler")) {
+            _ray_tracer_settings.sampler = sampler_type_from_name(argv[i+1]);
+        } else if (!strcmp(current_setting, "--adaptive")) {
+            _ray_tracer_settings.use_adaptive_sampling = true;
+        } else if (!strcmp(current_setting, "--noise-threshold")) {
+            _ray_tracer_settings.noise_threshold = atof(argv[i+1]);
+        } else if (!strcmp(current_setting, "--max-samples")) {
+            _ray_tracer_settings.max_samples_per_pixel = atoi(argv[i+1]);
+        } else if (!strcmp(current_setting, "--progressive")) {
+            _ray_tracer_settings.use_progressive_rendering = true;
+        } else if (!strcmp(current_setting, "--time-budget")) {
+            // a deadline only makes sense for a render that can stop early
+            _ray_tracer_settings.use_progressive_rendering = true;
+            _ray_tracer_settings.time_budget_ms = atoi(argv[i+1]);
+        } else if (!strcmp(current_setting, "--dump-interval")) {
+            _ray_tracer_settings.dump_interval_ms = atoi(argv[i+1]);
+        } else if (!strcmp(current_setting, "--light-cutoff")) {
+            _ray_tracer_settings.light_cutoff = atof(argv[i+1]);
+        } else if (!strcmp(current_setting, "--light-samples")) {
+            _ray_tracer_settings.light_samples = atoi(argv[i+1]);
         } else if (!strcmp(current_setting, "--recursion-depth")) {
             _ray_tracer_settings.max_depth_of_reflection_recursion = atoi(argv[i+1]);
+        } else if (!strcmp(current_setting, "--threads")) {
+            _ray_tracer_settings.number_of_threads = atoi(argv[i+1]);
+        } else if (!strcmp(current_setting, "--tile-size")) {
+            _ray_tracer_settings.tile_size = atoi(argv[i+1]);
+        } else if (!strcmp(current_setting, "--bvh-builder")) {
+            _ray_tracer_settings.bounding_box_builder = !strcmp(argv[i+1], "midpoint")
+                ? BoundingBoxBuilder::MIDPOINT : BoundingBoxBuilder::SAH;
+        } else if (!strcmp(current_setting, "--bvh-width")) {
+            _ray_tracer_settings.bounding_box_width = atoi(argv[i+1]);
+        } else if (!strcmp(current_setting, "--output-format")) {
+            if (!strcmp(argv[i+1], "p3")) {
+                _ray_tracer_settings.output_format = ImageFormat::P3;
+            } else if (!strcmp(argv[i+1], "pfm")) {
+                _ray_tracer_settings.output_format = ImageFormat::PFM;
+            } else {
+                _ray_tracer_settings.output_format = ImageFormat::P6;
+            }
+        } else if (!strcmp(current_setting, "--compile-scene")) {
+            _ray_tracer_settings.input_filename = argv[i+1];
+            _ray_tracer_settings.compiled_scene_filename = argv[i+2];
+        } else if (!strcmp(current_setting, "--bvh-cache")) {
+            _ray_tracer_settings.bounding_box_cache_directory = argv[i+1];
+        } else if (!strcmp(current_setting, "--no-shadow-cache")) {
+            _ray_tracer_settings.use_shadow_cache = false;
+        } else if (!strcmp(current_setting, "--no-ray-packets")) {
+            _ray_tracer_settings.use_ray_packets = false;
+        } else if (!strcmp(current_setting, "--wavefront")) {
+            _ray_tracer_settings.use_wavefront = true;
+        } else if (!strcmp(current_setting, "--stats-json")) {
+            _ray_tracer_settings.stats_json_filename = argv[i+1];
         } // TODO. added distributed rt, lens effects
     }
 }
 
 void RayTracer::setup() {
+    std::chrono::steady_clock::time_point load_start = std::chrono::steady_clock::now();
+    if (is_scene_file(_ray_tracer_settings.input_filename)) {
+        // the primitives are used straight from the mapped file, only the tree is built
+        SceneFileReader sfr(_ray_tracer_settings.input_filename);
+        CompiledScene scene = sfr.load_scene();
+        _lights = std::move(scene.lights);
+        _light_grid = std::make_unique<LightGrid>(_lights, _ray_tracer_settings.light_cutoff,
+                                                  _ray_tracer_settings.light_samples);
+
+        _props = scene.camera.get_camera_properties();
+        _camera_rays = std::make_unique<CameraRayGenerator>(_props, Sampler(_ray_tracer_settings.sampler));
+        double load_milliseconds = get_milliseconds_since(load_start);
+        build_tree(std::move(scene.store));
+
+        // only the time still spent waiting on the textures after the build counts as loading
+        std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+        sfr.wait_for_textures();
+        _report.phase_milliseconds[static_cast<int>(RenderPhase::LOAD)] = load_milliseconds +
+                                                                          get_milliseconds_since(wait_start);
+        return;
+    }
+
     BlenderFileReader bfr(_ray_tracer_settings.input_filename);
 
     // read the blender file
-    Camera camera =                             bfr.get_camera_from_blender_file();
-    std::vector<std::unique_ptr<Mesh>> meshes = bfr.get_meshes_from_blender_file();
-    _lights =                                   bfr.get_lights_from_blender_file();
+    Scene scene = bfr.load_scene();
+    _lights = std::move(scene.lights);
+    _light_grid = std::make_unique<LightGrid>(_lights, _ray_tracer_settings.light_cutoff,
+                                              _ray_tracer_settings.light_samples);
 
-    _props = camera.get_camera_properties();
-    _bbht = std::make_unique<BoundingBoxHierarchyTree>(std::move(meshes));
+    _props = scene.camera.get_camera_properties();
+    _camera_rays = std::make_unique<CameraRayGenerator>(_props, Sampler(_ray_tracer_settings.sampler));
+
+    // the textures keep reading while the tree is built, so only the wait after it counts as loading
+    double load_milliseconds = get_milliseconds_since(load_start);
+    build_tree(PrimitiveStore::from_meshes(scene.meshes));
+    std::chrono::steady_clock::time_point wait_start = std::chrono::steady_clock::now();
+    bfr.wait_for_textures();
+    _report.phase_milliseconds[static_cast<int>(RenderPhase::LOAD)] = load_milliseconds +
+                                                                      get_milliseconds_since(wait_start);
 }
 
-void RayTracer::render_image() {
-    std::cout << "Rendering image, please be patient...\n";
-    
-    PPMImageFile image("");
-    image.set_width_and_height(_props.resolution_x, _props.resolution_y);
-
-    // create uniform distribution for antialiasing sampling
-    std::mt19937 generator(0); 
-    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
-
-    int intersection_test_counter = 0;
-    // iterate through each pixel, shade correspondingly
-    for (int px = 0; px < image.get_width(); px++) {
-        for (int py = 0; py < image.get_height(); py++) {            
-            Eigen::Vector3f overall_shade = Eigen::Vector3f::Zero();
-            bool is_hit = false;
-            for (int sample_i = 0; sample_i < _ray_tracer_settings.amount_of_antialiasing_samples_per_pixel; sample_i++) {
-                float sample_offset_x = distribution(generator);
-                float sample_offset_y = distribution(generator);
-
-                // lock into bounds of image
-                float sample_px = std::min((float)px + sample_offset_x, (float)image.get_width()-1.0f);
-                float sample_py = std::min((float)py + sample_offset_y, (float)image.get_height()-1.0f);
-
-                Pixel p = image.get_pixel(sample_px, sample_py);
-                Ray r = p.as_ray(_props);
-                Hit h;
-
-                if (_bbht->check_intersect(r, &h, &intersection_test_counter)) {
-                    Eigen::Vector3f s = shade(&h, _lights, &_props, 1.0f, _bbht, 0, _ray_tracer_settings.max_depth_of_reflection_recursion);
-                    
-                    // shade operates in 0-1 shading region, convert back to rgb255
-                    overall_shade[0] += s[0] * 255.0f;
-                    overall_shade[1] += s[1] * 255.0f;
-                    overall_shade[2] += s[2] * 255.0f;
-
-                    is_hit = true;
+void RayTracer::build_tree(PrimitiveStore store) {
+    // the cache is only kept when asked for, and only reused while the scene and settings match
+    std::string cache_filepath;
+    if (!_ray_tracer_settings.bounding_box_cache_directory.empty()) {
+        cache_filepath = get_bounding_box_cache_filepath(_ray_tracer_settings.bounding_box_cache_directory,
+                                                         _ray_tracer_settings.input_filename);
+    }
+
+    std::chrono::steady_clock::time_point build_start = std::chrono::steady_clock::now();
+    _bbht = std::make_unique<BoundingBoxHierarchyTree>(std::move(store), _ray_tracer_settings.bounding_box_builder,
+                                                       _ray_tracer_settings.bounding_box_width, cache_filepath);
+    _report.phase_milliseconds[static_cast<int>(RenderPhase::BUILD)] = get_milliseconds_since(build_start);
+    if (_bbht->get_is_from_cache()) {
+        std::cout << "Reusing the bounding box tree cached in " << cache_filepath << "\n";
+    }
+}
+
+void RayTracer::compile_scene() {
+    BlenderFileReader bfr(_ray_tracer_settings.input_filename);
+    Scene scene = bfr.load_scene();
+
+    // the texture paths are only known once they have been read
+    PrimitiveStore store = PrimitiveStore::from_meshes(scene.meshes);
+    bfr.wait_for_textures();
+
+    write_scene_file(_ray_tracer_settings.compiled_scene_filename, scene.camera.get_camera_properties(),
+                     scene.lights, store);
+    std::cout << "Compiled " << _ray_tracer_settings.input_filename << " into "
+              << _ray_tracer_settings.compiled_scene_filename << "\n";
+}
+
+Eigen::Vector3f RayTracer::shade_sample(Hit* hit, const Ray& ray, ShadowCache* shadow_cache, RenderStatistics* statistics) {
+    // primary rays start as a point and widen by one pixel's angle
+    update_hit_ray_cone(hit, ray, 0.0f, _camera_rays->get_pixel_spread_angle());
+    ShadingContext context{_lights, *_light_grid, _props, 1.0f, *_bbht, _ray_tracer_settings.max_depth_of_reflection_recursion};
+    Eigen::Vector3f s = shade(hit, context, shadow_cache, statistics, 0);
+
+    // shade operates in 0-1 shading region, convert back to rgb255
+    return s * 255.0f;
+}
+
+Eigen::Vector3f RayTracer::resolve_pixel(Eigen::Vector3f overall_shade, int samples, bool is_hit) {
+    if (samples > 0) overall_shade /= samples; // finding the average
+    if (!is_hit) overall_shade += blender_background;
+    return overall_shade;
+}
+
+void RayTracer::trace_tile(int width, int height, const CameraRayBuffer& buffer,
+                           std::vector<Eigen::Vector3f>& colours, std::vector<char>& is_hit,
+                           ShadowCache* shadow_cache, RenderStatistics* statistics) {
+    colours.assign(static_cast<size_t>(width) * height, Eigen::Vector3f::Zero());
+    is_hit.assign(static_cast<size_t>(width) * height, 0);
+
+    for (int row = 0; row < height; row++) {
+        int column = 0;
+
+        // neighbouring pixels along a row make the most coherent packets. only the primary 
+        // rays travel as a packet, the reflections and shadows are traced one by one
+        if (_ray_tracer_settings.use_ray_packets) {
+            for (; column + RAY_PACKET_SIZE <= width; column += RAY_PACKET_SIZE) {
+                size_t first = static_cast<size_t>(row) * width + column;
+                Ray rays[RAY_PACKET_SIZE];
+                Hit hits[RAY_PACKET_SIZE];
+                for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                    rays[lane] = _camera_rays->get_ray(buffer, first + lane);
+                }
+
+                int hit_lanes = _bbht->check_intersect_packet(rays, hits, statistics);
+                for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                    statistics->add_ray(RayType::PRIMARY, hit_lanes & (1 << lane));
+                    if (hit_lanes & (1 << lane)) {
+                        colours[first + lane] = shade_sample(&hits[lane], rays[lane], shadow_cache, statistics);
+                        is_hit[first + lane] = 1;
+                    }
+                }
+            }
+        }
+
+        // whatever is left of the row is traced a ray at a time
+        for (; column < width; column++) {
+            size_t i = static_cast<size_t>(row) * width + column;
+            Ray r = _camera_rays->get_ray(buffer, i);
+            Hit h;
+            bool is_primary_hit = _bbht->check_intersect(r, &h, statistics);
+            statistics->add_ray(RayType::PRIMARY, is_primary_hit);
+            if (is_primary_hit) {
+                colours[i] = shade_sample(&h, r, shadow_cache, statistics);
+                is_hit[i] = 1;
+            }
+        }
+    }
+}
+
+void RayTracer::render_tile(Framebuffer& framebuffer, int x_start, int y_start, int x_end, int y_end,
+                            CameraRayBuffer& buffer, ShadowCache* shadow_cache, RenderStatistics* statistics) {
+    int width = x_end - x_start;
+    int height = y_end - y_start;
+    int samples = _ray_tracer_settings.amount_of_antialiasing_samples_per_pixel;
+
+    // the samples are summed straight into the framebuffer, which starts at zero
+    std::vector<char> is_hit(static_cast<size_t>(width) * height, 0);
+    std::vector<Eigen::Vector3f> sample_colours;
+    std::vector<char> sample_is_hit;
+
+    for (int sample_i = 0; sample_i < samples; sample_i++) {
+        // a single sample goes through the corner of its pixel, more are spread over the pixel
+        if (samples == 1) {
+            _camera_rays->generate_tile(x_start, y_start, width, height, buffer);
+        } else {
+            _camera_rays->generate_jittered_tile(x_start, y_start, width, height, sample_i, buffer);
+        }
+
+        trace_tile(width, height, buffer, sample_colours, sample_is_hit, shadow_cache, statistics);
+        for (int row = 0; row < height; row++) {
+            for (int column = 0; column < width; column++) {
+                size_t i = static_cast<size_t>(row) * width + column;
+                if (!sample_is_hit[i]) continue;
+                framebuffer.add_to_pixel(x_start + column, y_start + row, sample_colours[i]);
+                is_hit[i] = 1;
+            }
+        }
+    }
+
+    for (int row = 0; row < height; row++) {
+        for (int column = 0; column < width; column++) {
+            size_t i = static_cast<size_t>(row) * width + column;
+            Eigen::Vector3f overall_shade = framebuffer.get_pixel(x_start + column, y_start + row);
+            framebuffer.set_pixel(x_start + column, y_start + row, resolve_pixel(overall_shade, samples, is_hit[i]));
+        }
+    }
+}
+
+long long RayTracer::render_tile_adaptive(Framebuffer& framebuffer, int x_start, int y_start, int x_end, int y_end,
+                                          CameraRayBuffer& buffer, ShadowCache* shadow_cache, RenderStatistics* statistics) {
+    int width = x_end - x_start;
+    int height = y_end - y_start;
+    int base_samples = std::max(_ray_tracer_settings.amount_of_antialiasing_samples_per_pixel, ADAPTIVE_BASE_SAMPLES);
+    int max_samples = std::max(_ray_tracer_settings.max_samples_per_pixel, base_samples);
+    long long samples_traced = 0;
+
+    std::vector<char> is_hit(static_cast<size_t>(width) * height, 0);
+    std::vector<SampleVariance> variances(static_cast<size_t>(width) * height);
+    std::vector<Eigen::Vector3f> sample_colours;
+    std::vector<char> sample_is_hit;
+
+    // the base samples cover the whole tile, so they still travel as packets
+    for (int sample_i = 0; sample_i < base_samples; sample_i++) {
+        _camera_rays->generate_jittered_tile(x_start, y_start, width, height, sample_i, buffer);
+        trace_tile(width, height, buffer, sample_colours, sample_is_hit, shadow_cache, statistics);
+        for (size_t i = 0; i < sample_colours.size(); i++) {
+            framebuffer.add_to_pixel(x_start + i % width, y_start + i / width, sample_colours[i]);
+            variances[i].add(sample_colours[i]);
+            is_hit[i] |= sample_is_hit[i];
+        }
+    }
+    samples_traced += static_cast<long long>(base_samples) * width * height;
+
+    // the remaining pixels are scattered across the tile, so their rays are traced one at a time.
+    // a sample's jitter only depends on its pixel and index, so the image does not depend on the tiling
+    for (int target = base_samples * 2; ; target *= 2) {
+        target = std::min(target, max_samples);
+        bool is_converged = true;
+        for (int row = 0; row < height; row++) {
+            for (int column = 0; column < width; column++) {
+                size_t i = static_cast<size_t>(row) * width + column;
+                SampleVariance& variance = variances[i];
+                if (variance.count >= target || variance.get_error() <= _ray_tracer_settings.noise_threshold) continue;
+
+                is_converged = false;
+                while (variance.count < target) {
+                    Ray r = _camera_rays->get_jittered_ray(x_start + column, y_start + row, variance.count);
+                    Hit h;
+                    Eigen::Vector3f colour = Eigen::Vector3f::Zero();
+                    bool is_primary_hit = _bbht->check_intersect(r, &h, statistics);
+                    statistics->add_ray(RayType::PRIMARY, is_primary_hit);
+                    if (is_primary_hit) {
+                        colour = shade_sample(&h, r, shadow_cache, statistics);
+                        framebuffer.add_to_pixel(x_start + column, y_start + row, colour);
+                        is_hit[i] = 1;
+                    }
+                    variance.add(colour);
+                    samples_traced++;
+                }
+            }
+        }
+        if (is_converged || target == max_samples) break;
+    }
+
+    for (int row = 0; row < height; row++) {
+        for (int column = 0; column < width; column++) {
+            size_t i = static_cast<size_t>(row) * width + column;
+            Eigen::Vector3f overall_shade = framebuffer.get_pixel(x_start + column, y_start + row);
+            framebuffer.set_pixel(x_start + column, y_start + row,
+                                  resolve_pixel(overall_shade, variances[i].count, is_hit[i]));
+        }
+    }
+    return samples_traced;
+}
+
+void RayTracer::render_tile_wavefront(Framebuffer& framebuffer, int x_start, int y_start, int x_end, int y_end,
+                                      CameraRayBuffer& buffer, WavefrontState& state, RenderStatistics* statistics) {
+    int width = x_end - x_start;
+    int height = y_end - y_start;
+    int samples = _ray_tracer_settings.amount_of_antialiasing_samples_per_pixel;
+    int max_depth = _ray_tracer_settings.max_depth_of_reflection_recursion;
+    size_t n_pixels = static_cast<size_t>(width) * height;
+    size_t n_paths = n_pixels * samples;
+
+    Eigen::Vector3f scene_min, scene_max;
+    _bbht->get_bounds(scene_min, scene_max);
+
+    // generate, the primary rays are queued sample by sample in row order, which is already coherent
+    state.extension.clear();
+    for (int sample_i = 0; sample_i < samples; sample_i++) {
+        if (samples == 1) {
+            _camera_rays->generate_tile(x_start, y_start, width, height, buffer);
+        } else {
+            _camera_rays->generate_jittered_tile(x_start, y_start, width, height, sample_i, buffer);
+        }
+        for (size_t i = 0; i < n_pixels; i++) {
+            state.extension.push(_camera_rays->get_ray(buffer, i), static_cast<uint32_t>(sample_i * n_pixels + i));
+        }
+    }
+
+    size_t n_bounces = static_cast<size_t>(max_depth + 1) * n_paths;
+    state.colours.assign(n_bounces, Eigen::Vector3f::Zero());
+    state.reflectivities.assign(n_bounces, 0.0f);
+    state.is_bounce_hit.assign(n_bounces, 0);
+    state.cone_widths.assign(n_paths, 0.0f);
+    state.cone_spreads.assign(n_paths, 0.0f);
+
+    for (int depth = 0; state.extension.size() > 0; depth++) {
+        size_t bounce_start = static_cast<size_t>(depth) * n_paths;
+
+        // extend, finding the closest hit of every queued ray
+        size_t n_rays = state.extension.size();
+        state.hits.assign(n_rays, Hit());
+        size_t r = 0;
+        if (_ray_tracer_settings.use_ray_packets) {
+            for (; r + RAY_PACKET_SIZE <= n_rays; r += RAY_PACKET_SIZE) {
+                _bbht->check_intersect_packet(state.extension.rays() + r, &state.hits[r], statistics);
+            }
+        }
+        for (; r < n_rays; r++) _bbht->check_intersect(state.extension.get_ray(r), &state.hits[r], statistics);
+        RayType extension_type = depth == 0 ? RayType::PRIMARY : RayType::REFLECTION;
+        for (size_t i = 0; i < n_rays; i++) statistics->add_ray(extension_type, state.hits[i].is_hit);
+
+        // shade, the ambient part of every hit is known now, the lights wait on the shadow rays
+        state.points.clear();
+        state.point_paths.clear();
+        state.shadow.clear();
+        state.shadow_distances.clear();
+        state.shadow_lights.clear();
+        state.shadow_weights.clear();
+        state.point_shadow_starts.clear();
+        for (size_t i = 0; i < n_rays; i++) {
+            Hit& hit = state.hits[i];
+            if (!hit.is_hit) continue;
+            uint32_t path = state.extension.get_id(i);
+
+            // primary rays start as a point and widen by one pixel's angle, reflections carry on from their parent
+            if (depth == 0) {
+                update_hit_ray_cone(&hit, state.extension.get_ray(i), 0.0f, _camera_rays->get_pixel_spread_angle());
+            } else {
+                update_hit_ray_cone(&hit, state.extension.get_ray(i), state.cone_widths[path], state.cone_spreads[path]);
+            }
+            state.cone_widths[path] = hit.cone_width;
+            state.cone_spreads[path] = hit.cone_spread;
+
+            ShadingPoint point = get_shading_point(&hit, &_props);
+            state.colours[bounce_start + path] = get_ambient(point, 1.0f);
+            state.reflectivities[bounce_start + path] = point.material->reflectivity;
+            state.is_bounce_hit[bounce_start + path] = 1;
+
+            state.point_shadow_starts.push_back(static_cast<uint32_t>(state.shadow_lights.size()));
+            _light_grid->for_each_light(point.P, [&](uint32_t light_index, float weight) {
+                float distance_to_blocker;
+                uint32_t slot = static_cast<uint32_t>(state.shadow_lights.size());
+                state.shadow.push(get_shadow_ray(point, _lights[light_index], distance_to_blocker), slot);
+                state.shadow_distances.push_back(distance_to_blocker);
+                state.shadow_lights.push_back(light_index);
+                state.shadow_weights.push_back(weight);
+            });
+            state.points.push_back(point);
+            state.point_paths.push_back(path);
+        }
+
+        state.point_shadow_starts.push_back(static_cast<uint32_t>(state.shadow_lights.size()));
+
+        // shadow, any hit before the light blocks it
+        state.shadow.sort(scene_min, scene_max);
+        state.is_light_visible.assign(state.shadow.size(), 0);
+        for (size_t i = 0; i < state.shadow.size(); i++) {
+            uint32_t slot = state.shadow.get_id(i);
+            const Ray& ray = state.shadow.get_ray(i);
+            bool in_shadow = _ray_tracer_settings.use_shadow_cache
+                ? state.shadow_cache.occluded(*_bbht, ray, state.shadow_distances[slot], state.shadow_lights[slot], statistics)
+                : _bbht->occluded(ray, state.shadow_distances[slot], statistics);
+            statistics->add_ray(RayType::SHADOW, in_shadow);
+            state.is_light_visible[slot] = !in_shadow;
+        }
+
+        // accumulate the unblocked lights in the same order shade adds them, then queue the reflections
+        state.extension.clear();
+        for (size_t p = 0; p < state.points.size(); p++) {
+            const ShadingPoint& point = state.points[p];
+            uint32_t path = state.point_paths[p];
+            for (uint32_t slot = state.point_shadow_starts[p]; slot < state.point_shadow_starts[p + 1]; slot++) {
+                if (!state.is_light_visible[slot]) continue;
+                add_light(state.colours[bounce_start + path], point, _lights[state.shadow_lights[slot]],
+                          state.shadow_weights[slot]);
+            }
+            if (point.material->reflectivity > 0.0f && depth < max_depth) {
+                state.extension.push(get_reflection_ray(point), path);
+            }
+        }
+        state.extension.sort(scene_min, scene_max);
+    }
+
+    // resolve every path from its last bounce back to the camera, then add the samples in order
+    std::vector<char> is_hit(n_pixels, 0);
+    for (size_t path = 0; path < n_paths; path++) {
+        if (!state.is_bounce_hit[path]) continue;
+
+        // a bounce only hit if the one before it did, so the first hit found is the deepest
+        Eigen::Vector3f colour = Eigen::Vector3f::Zero();
+        bool is_deeper_hit = false;
+        for (int depth = max_depth; depth >= 0; depth--) {
+            size_t b = static_cast<size_t>(depth) * n_paths + path;
+            if (!state.is_bounce_hit[b]) continue;
+            colour = is_deeper_hit ? blend_reflection(state.colours[b], colour, state.reflectivities[b]) : state.colours[b];
+            is_deeper_hit = true;
+        }
+
+        size_t i = path % n_pixels;
+        framebuffer.add_to_pixel(x_start + i % width, y_start + i / width, colour * 255.0f);
+        is_hit[i] = 1;
+    }
+
+    for (int row = 0; row < height; row++) {
+        for (int column = 0; column < width; column++) {
+            size_t i = static_cast<size_t>(row) * width + column;
+            Eigen::Vector3f overall_shade = framebuffer.get_pixel(x_start + column, y_start + row);
+            framebuffer.set_pixel(x_start + column, y_start + row, resolve_pixel(overall_shade, samples, is_hit[i]));
+        }
+    }
+}
+
+void RayTracer::resolve_progressive(const Framebuffer& sums, const std::vector<SampleVariance>& variances,
+                                    const std::vector<char>& is_hit, Framebuffer& framebuffer) {
+    for (int py = 0; py < sums.get_height(); py++) {
+        for (int px = 0; px < sums.get_width(); px++) {
+            size_t i = static_cast<size_t>(py) * sums.get_width() + px;
+            framebuffer.set_pixel(px, py, resolve_pixel(sums.get_pixel(px, py), variances[i].count, is_hit[i]));
+        }
+    }
+}
+
+int RayTracer::render_progressive(Framebuffer& framebuffer, WorkStealingThreadPool& pool,
+                                  std::vector<CameraRayBuffer>& ray_buffers, std::vector<ShadowCache>& shadow_caches,
+                                  std::vector<RenderStatistics>& statistics) {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::milliseconds(_ray_tracer_settings.time_budget_ms);
+    Clock::time_point last_dump = start;
+    bool has_deadline = _ray_tracer_settings.time_budget_ms > 0;
+
+    int width = framebuffer.get_width();
+    int height = framebuffer.get_height();
+    int tile_size = std::max(1, _ray_tracer_settings.tile_size);
+    int tiles_x = (width + tile_size - 1) / tile_size;
+    int tiles_y = (height + tile_size - 1) / tile_size;
+
+    // every tile writes only its own pixels, so the shared buffers need no locking
+    Framebuffer sums(width, height);
+    std::vector<SampleVariance> variances(static_cast<size_t>(width) * height);
+    std::vector<char> is_hit(static_cast<size_t>(width) * height, 0);
+    std::vector<char> is_tile_converged(static_cast<size_t>(tiles_x) * tiles_y, 0);
+
+    // what each worker traced for its current tile, one per worker like ray_buffers, so the
+    // vectors keep their capacity between tiles and passes
+    std::vector<std::vector<Eigen::Vector3f>> tile_colours(ray_buffers.size());
+    std::vector<std::vector<char>> tile_is_hits(ray_buffers.size());
+
+    ImageFormat format = _ray_tracer_settings.output_format.value_or(
+        image_format_from_filename(_ray_tracer_settings.output_filename));
+
+    int passes = 0;
+    while (passes < _ray_tracer_settings.max_samples_per_pixel && !(has_deadline && Clock::now() >= deadline)) {
+        int pass = passes++;
+        pool.run(tiles_x * tiles_y, [&](int tile_index, int worker_index) {
+            if (is_tile_converged[tile_index] || (has_deadline && Clock::now() >= deadline)) return;
+
+            int x_start = (tile_index % tiles_x) * tile_size;
+            int y_start = (tile_index / tiles_x) * tile_size;
+            int tile_width = std::min(x_start + tile_size, width) - x_start;
+            int tile_height = std::min(y_start + tile_size, height) - y_start;
+
+            CameraRayBuffer& buffer = ray_buffers[worker_index];
+            if (pass == 0) {
+                _camera_rays->generate_tile(x_start, y_start, tile_width, tile_height, buffer);
+            } else {
+                _camera_rays->generate_jittered_tile(x_start, y_start, tile_width, tile_height, pass, buffer);
+            }
+
+            std::vector<Eigen::Vector3f>& colours = tile_colours[worker_index];
+            std::vector<char>& tile_is_hit = tile_is_hits[worker_index];
+            ShadowCache* shadow_cache = _ray_tracer_settings.use_shadow_cache ? &shadow_caches[worker_index] : nullptr;
+            trace_tile(tile_width, tile_height, buffer, colours, tile_is_hit, shadow_cache, &statistics[worker_index]);
+
+            bool is_converged = pass + 1 >= ADAPTIVE_BASE_SAMPLES;
+            for (int row = 0; row < tile_height; row++) {
+                for (int column = 0; column < tile_width; column++) {
+                    size_t t = static_cast<size_t>(row) * tile_width + column;
+                    size_t i = static_cast<size_t>(y_start + row) * width + x_start + column;
+                    sums.add_to_pixel(x_start + column, y_start + row, colours[t]);
+                    variances[i].add(colours[t]);
+                    is_hit[i] |= tile_is_hit[t];
+                    is_converged &= variances[i].get_error() <= _ray_tracer_settings.noise_threshold;
                 }
             }
+            is_tile_converged[tile_index] = _ray_tracer_settings.use_adaptive_sampling && is_converged;
+        });
+
+        if (std::all_of(is_tile_converged.begin(), is_tile_converged.end(), [](char c) { return c; })) break;
 
-            overall_shade /= _ray_tracer_settings.amount_of_antialiasing_samples_per_pixel; // finding the average
-            if (!is_hit) overall_shade += blender_background;
-            Colour new_colour{overall_shade[0], overall_shade[1], overall_shade[2]};
-            
-            image.update_pixel(px, py, new_colour);
+        // the image so far is only written between passes, so it never shows half a pass. past the
+        // deadline the final image is about to be written anyway
+        if (_ray_tracer_settings.dump_interval_ms > 0 && !(has_deadline && Clock::now() >= deadline) &&
+            Clock::now() - last_dump >= std::chrono::milliseconds(_ray_tracer_settings.dump_interval_ms)) {
+            resolve_progressive(sums, variances, is_hit, framebuffer);
+            framebuffer.write_to_file(_ray_tracer_settings.output_filename, format);
+            last_dump = Clock::now();
         }
     }
 
-    image.write_current_image_to_file(_ray_tracer_settings.output_filename);
+    resolve_progressive(sums, variances, is_hit, framebuffer);
+
+    long long samples = 0;
+    for (const SampleVariance& variance : variances) samples += variance.count;
+    std::cout << "Progressive render made " << passes << " passes in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() << " ms, "
+              << static_cast<double>(samples) / variances.size() << " samples per pixel on average\n";
+    return passes;
+}
+
+void RayTracer::render_image() {
+    std::cout << "Rendering image, please be patient...\n";
+    
+    Framebuffer framebuffer(_props.resolution_x, _props.resolution_y);
+
+    // split the image into tiles, these are the units of work shared between the threads
+    int tile_size = std::max(1, _ray_tracer_settings.tile_size);
+    int tiles_x = (framebuffer.get_width() + tile_size - 1) / tile_size;
+    int tiles_y = (framebuffer.get_height() + tile_size - 1) / tile_size;
+
+    WorkStealingThreadPool pool(_ray_tracer_settings.number_of_threads);
+    std::cout << "Using " << pool.get_number_of_threads() << " threads across " 
+              << tiles_x * tiles_y << " tiles\n";
+    if (_ray_tracer_settings.use_ray_packets) {
+        std::cout << "Tracing primary rays in packets of " << RAY_PACKET_SIZE << " using "
+                  << get_packet_traversal_name() << "\n";
+    }
+
+    std::cout << "Placing antialiasing samples with the " << get_sampler_name(_ray_tracer_settings.sampler)
+              << " sampler\n";
+    if (_ray_tracer_settings.use_adaptive_sampling) {
+        std::cout << "Sampling adaptively, up to " << _ray_tracer_settings.max_samples_per_pixel
+                  << " samples per pixel until the noise is below " << _ray_tracer_settings.noise_threshold << "\n";
+    } else if (_ray_tracer_settings.use_wavefront && !_ray_tracer_settings.use_progressive_rendering) {
+        std::cout << "Tracing each tile in wavefronts, with sorted shadow and reflection queues\n";
+    }
+
+    if (_light_grid->get_is_culling()) {
+        std::cout << "Culling lights dimmer than " << _ray_tracer_settings.light_cutoff << " over a grid of "
+                  << _light_grid->get_number_of_cells() << " cells, " << _light_grid->get_average_lights_per_cell()
+                  << " lights per cell on average\n";
+    }
+    if (_light_grid->get_samples() > 0) {
+        std::cout << "Shading at most " << _light_grid->get_samples() << " of the " << _lights.size()
+                  << " lights per point, picked by their estimated brightness\n";
+    }
+
+    // each thread counts into its own slot, these are merged once the frame is done
+    std::vector<RenderStatistics> statistics(pool.get_number_of_threads());
+    std::vector<long long> sample_counters(pool.get_number_of_threads(), 0);
+
+    // and fills its own buffer with the primary rays of its current tile
+    std::vector<CameraRayBuffer> ray_buffers(pool.get_number_of_threads());
+    std::vector<WavefrontState> wavefront_states(_ray_tracer_settings.use_wavefront ? pool.get_number_of_threads() : 0);
+
+    // and remembers the last blocker of each light for its own shadow rays
+    std::vector<ShadowCache> shadow_caches(pool.get_number_of_threads(), ShadowCache(_lights.size()));
+
+    std::chrono::steady_clock::time_point render_start = std::chrono::steady_clock::now();
+    if (_ray_tracer_settings.use_progressive_rendering) {
+        render_progressive(framebuffer, pool, ray_buffers, shadow_caches, statistics);
+    } else {
+        pool.run(tiles_x * tiles_y, [&](int tile_index, int worker_index) {
+            int x_start = (tile_index % tiles_x) * tile_size;
+            int y_start = (tile_index / tiles_x) * tile_size;
+            int x_end = std::min(x_start + tile_size, framebuffer.get_width());
+            int y_end = std::min(y_start + tile_size, framebuffer.get_height());
+
+            ShadowCache* shadow_cache = _ray_tracer_settings.use_shadow_cache ? &shadow_caches[worker_index] : nullptr;
+            RenderStatistics* worker_statistics = &statistics[worker_index];
+            if (_ray_tracer_settings.use_adaptive_sampling) {
+                sample_counters[worker_index] += render_tile_adaptive(framebuffer, x_start, y_start, x_end, y_end,
+                                                                      ray_buffers[worker_index], shadow_cache,
+                                                                      worker_statistics);
+            } else if (_ray_tracer_settings.use_wavefront) {
+                render_tile_wavefront(framebuffer, x_start, y_start, x_end, y_end, ray_buffers[worker_index],
+                                      wavefront_states[worker_index], worker_statistics);
+            } else {
+                render_tile(framebuffer, x_start, y_start, x_end, y_end, ray_buffers[worker_index], shadow_cache,
+                            worker_statistics);
+            }
+        });
+    }
+    _report.phase_milliseconds[static_cast<int>(RenderPhase::RENDER)] = get_milliseconds_since(render_start);
+    if (_ray_tracer_settings.use_adaptive_sampling && !_ray_tracer_settings.use_progressive_rendering) {
+        long long samples = 0;
+        for (long long counter : sample_counters) samples += counter;
+        std::cout << "Average samples per pixel: "
+                  << static_cast<double>(samples) / (static_cast<double>(framebuffer.get_width()) * framebuffer.get_height())
+                  << "\n";
+    }
+
+    // the 8 bit image is only made once every sample is in
+    std::chrono::steady_clock::time_point write_start = std::chrono::steady_clock::now();
+    ImageFormat format = _ray_tracer_settings.output_format.value_or(
+        image_format_from_filename(_ray_tracer_settings.output_filename));
+    framebuffer.write_to_file(_ray_tracer_settings.output_filename, format);
+    _report.phase_milliseconds[static_cast<int>(RenderPhase::WRITE)] = get_milliseconds_since(write_start);
+
+    _report.input_filename = _ray_tracer_settings.input_filename;
+    _report.width = framebuffer.get_width();
+    _report.height = framebuffer.get_height();
+    _report.threads = pool.get_number_of_threads();
+    _report.samples_per_pixel = _ray_tracer_settings.amount_of_antialiasing_samples_per_pixel;
+    _report.statistics = RenderStatistics();
+    for (const RenderStatistics& worker_statistics : statistics) _report.statistics.add(worker_statistics);
+    print_render_report(_report);
+    if (!_ray_tracer_settings.stats_json_filename.empty()) {
+        write_render_report(_ray_tracer_settings.stats_json_filename, _report);
+    }
 }
\ No newline at end of file
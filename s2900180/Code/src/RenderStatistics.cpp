@@ -0,0 +1,112 @@
+#include "RenderStatistics.h"
+
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+namespace {
+
+const char* RAY_TYPE_NAMES[NUMBER_OF_RAY_TYPES] = {"primary", "shadow", "reflection"};
+const char* RENDER_PHASE_NAMES[NUMBER_OF_RENDER_PHASES] = {"load", "build", "render", "write"};
+const char* MESH_TYPE_NAMES[NUMBER_OF_MESH_TYPES] = {"cube", "sphere", "plane", "triangle_mesh"};
+
+double get_rate(long long part, long long whole) {
+    return whole > 0 ? static_cast<double>(part) / whole : 0.0;
+}
+
+} // namespace
+
+void RenderStatistics::add(const RenderStatistics& other) {
+    for (int i = 0; i < NUMBER_OF_RAY_TYPES; i++) {
+        rays[i] += other.rays[i];
+        ray_hits[i] += other.ray_hits[i];
+    }
+    node_visits += other.node_visits;
+    for (int i = 0; i < NUMBER_OF_MESH_TYPES; i++) primitive_tests[i] += other.primitive_tests[i];
+    shadow_cache_lookups += other.shadow_cache_lookups;
+    shadow_cache_hits += other.shadow_cache_hits;
+}
+
+long long RenderStatistics::get_total_rays() const {
+    long long total = 0;
+    for (long long count : rays) total += count;
+    return total;
+}
+
+long long RenderStatistics::get_total_primitive_tests() const {
+    long long total = 0;
+    for (long long count : primitive_tests) total += count;
+    return total;
+}
+
+double RenderReport::get_mrays_per_second() const {
+    double seconds = phase_milliseconds[static_cast<int>(RenderPhase::RENDER)] / 1000.0;
+    return seconds > 0.0 ? statistics.get_total_rays() / seconds / 1e6 : 0.0;
+}
+
+void print_render_report(const RenderReport& report) {
+    const RenderStatistics& statistics = report.statistics;
+
+    std::cout << "Time:";
+    for (int i = 0; i < NUMBER_OF_RENDER_PHASES; i++) {
+        std::cout << " " << RENDER_PHASE_NAMES[i] << " " << report.phase_milliseconds[i] << " ms";
+    }
+    std::cout << "\n";
+
+    std::cout << "Rays: " << statistics.get_total_rays() << " at " << report.get_mrays_per_second() << " Mrays/s\n";
+    for (int i = 0; i < NUMBER_OF_RAY_TYPES; i++) {
+        std::cout << "  " << RAY_TYPE_NAMES[i] << ": " << statistics.rays[i] << ", "
+                  << 100.0 * get_rate(statistics.ray_hits[i], statistics.rays[i])
+                  << (static_cast<RayType>(i) == RayType::SHADOW ? "% blocked\n" : "% hit\n");
+    }
+
+    std::cout << "Node visits: " << statistics.node_visits << ", "
+              << get_rate(statistics.node_visits, statistics.get_total_rays()) << " per ray\n";
+    std::cout << "Primitive tests: " << statistics.get_total_primitive_tests() << ",";
+    for (int i = 0; i < NUMBER_OF_MESH_TYPES; i++) {
+        std::cout << " " << MESH_TYPE_NAMES[i] << " " << statistics.primitive_tests[i];
+    }
+    std::cout << "\n";
+
+    if (statistics.shadow_cache_lookups > 0) {
+        std::cout << "Shadow cache: " << statistics.shadow_cache_hits << " of "
+                  << statistics.rays[static_cast<int>(RayType::SHADOW)]
+                  << " shadow rays blocked by the light's last blocker, a hit rate of "
+                  << 100.0 * get_rate(statistics.shadow_cache_hits, statistics.shadow_cache_lookups) << "% of the "
+                  << statistics.shadow_cache_lookups << " tried\n";
+    }
+}
+
+void write_render_report(const std::string& filepath, const RenderReport& report) {
+    const RenderStatistics& statistics = report.statistics;
+
+    // ordered, so the file reads in the same order as the printed report
+    nlohmann::ordered_json json;
+    json["input"] = report.input_filename;
+    json["width"] = report.width;
+    json["height"] = report.height;
+    json["threads"] = report.threads;
+    json["samples_per_pixel"] = report.samples_per_pixel;
+    for (int i = 0; i < NUMBER_OF_RENDER_PHASES; i++) {
+        json["phase_milliseconds"][RENDER_PHASE_NAMES[i]] = report.phase_milliseconds[i];
+    }
+    json["mrays_per_second"] = report.get_mrays_per_second();
+    for (int i = 0; i < NUMBER_OF_RAY_TYPES; i++) {
+        json["rays"][RAY_TYPE_NAMES[i]] = {{"count", statistics.rays[i]}, {"hits", statistics.ray_hits[i]},
+                                          {"hit_rate", get_rate(statistics.ray_hits[i], statistics.rays[i])}};
+    }
+    json["node_visits"] = statistics.node_visits;
+    for (int i = 0; i < NUMBER_OF_MESH_TYPES; i++) {
+        json["primitive_tests"][MESH_TYPE_NAMES[i]] = statistics.primitive_tests[i];
+    }
+    json["shadow_cache"] = {{"lookups", statistics.shadow_cache_lookups}, {"hits", statistics.shadow_cache_hits},
+                            {"hit_rate", get_rate(statistics.shadow_cache_hits, statistics.shadow_cache_lookups)}};
+
+    std::ofstream file(filepath);
+    if (!file.is_open()) {
+        std::cerr << "Error: could not open " << filepath << " to write the render statistics" << std::endl;
+        throw std::runtime_error("Could not open statistics file");
+    }
+    file << json.dump(2) << "\n";
+}
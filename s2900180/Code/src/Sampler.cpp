@@ -0,0 +1,138 @@
+#include "Sampler.h"
+
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// number of Sobol dimensions with their own direction numbers, later ones reuse these with another scramble
+constexpr int SOBOL_DIMENSIONS = 4;
+constexpr int SOBOL_BITS = 32;
+
+// splitmix64 finaliser, mixes every input bit into every output bit
+uint64_t mix_bits(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// one 32 bit seed per pixel and dimension
+uint32_t hash_pixel(int px, int py, uint32_t dimension) {
+    uint64_t z = (static_cast<uint64_t>(static_cast<uint32_t>(py)) << 32) | static_cast<uint32_t>(px);
+    return static_cast<uint32_t>(mix_bits(z ^ (static_cast<uint64_t>(dimension) * 0xd1b54a32d192ed03ULL)) >> 32);
+}
+
+// top 24 bits, so the value is exactly representable and always below 1
+float to_unit_float(uint32_t bits) {
+    return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+uint32_t reverse_bits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+// Burley's hash based Owen scramble, each output bit only depends on the bits above it
+uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+    x = reverse_bits(x);
+    x ^= x * 0x3d20adeau;
+    x += seed;
+    x *= (seed >> 16) | 1u;
+    x ^= x * 0x05526c56u;
+    x ^= x * 0x53a22864u;
+    return reverse_bits(x);
+}
+
+// generator matrices of the first Sobol dimensions, from the primitive polynomials and initial
+// direction numbers of Joe and Kuo. each column is stored with its first bit at the top
+std::array<std::array<uint32_t, SOBOL_BITS>, SOBOL_DIMENSIONS> make_sobol_matrices() {
+    struct Polynomial { int degree; uint32_t coefficients; uint32_t initial[3]; };
+    const Polynomial polynomials[SOBOL_DIMENSIONS - 1] = {
+        {1, 0, {1, 0, 0}},
+        {2, 1, {1, 3, 0}},
+        {3, 1, {1, 3, 1}},
+    };
+
+    std::array<std::array<uint32_t, SOBOL_BITS>, SOBOL_DIMENSIONS> matrices{};
+    for (int bit = 0; bit < SOBOL_BITS; bit++) matrices[0][bit] = 1u << (31 - bit); // van der Corput
+
+    for (int d = 1; d < SOBOL_DIMENSIONS; d++) {
+        const Polynomial& p = polynomials[d - 1];
+        std::array<uint32_t, SOBOL_BITS>& v = matrices[d];
+        for (int bit = 0; bit < p.degree; bit++) v[bit] = p.initial[bit] << (31 - bit);
+        for (int bit = p.degree; bit < SOBOL_BITS; bit++) {
+            v[bit] = v[bit - p.degree] ^ (v[bit - p.degree] >> p.degree);
+            for (int k = 1; k < p.degree; k++) {
+                if ((p.coefficients >> (p.degree - 1 - k)) & 1u) v[bit] ^= v[bit - k];
+            }
+        }
+    }
+    return matrices;
+}
+
+const std::array<std::array<uint32_t, SOBOL_BITS>, SOBOL_DIMENSIONS> SOBOL_MATRICES = make_sobol_matrices();
+
+uint32_t sobol(uint32_t index, int dimension) {
+    uint32_t result = 0;
+    for (int bit = 0; index != 0; index >>= 1, bit++) {
+        if (index & 1u) result ^= SOBOL_MATRICES[dimension][bit];
+    }
+    return result;
+}
+
+} // namespace
+
+float random_sample(int px, int py, int sample_index, int dimension) {
+    uint64_t z = (static_cast<uint64_t>(static_cast<uint32_t>(py)) << 32) | static_cast<uint32_t>(px);
+    z ^= (static_cast<uint64_t>(static_cast<uint32_t>(sample_index)) << 8 | static_cast<uint32_t>(dimension)) * 0xd1b54a32d192ed03ULL;
+    return static_cast<float>(mix_bits(z) >> 40) * (1.0f / 16777216.0f);
+}
+
+float r2_sample(int px, int py, int sample_index, int dimension) {
+    // 1 / g and 1 / g^2 for the plastic number g, in 32 bit fixed point so the sum wraps exactly
+    const uint32_t ALPHA[2] = {0xc13fa9a9u, 0x91e10da5u};
+
+    // further pairs of dimensions repeat the sequence with a different shift
+    uint32_t shift = hash_pixel(px, py, static_cast<uint32_t>(dimension));
+    return to_unit_float(shift + ALPHA[dimension % 2] * static_cast<uint32_t>(sample_index));
+}
+
+float sobol_sample(int px, int py, int sample_index, int dimension) {
+    // shuffling the order keeps every power of two prefix of a pixel's samples stratified
+    uint32_t index = owen_scramble(static_cast<uint32_t>(sample_index), hash_pixel(px, py, 0xffffffffu));
+    uint32_t value = sobol(index, dimension % SOBOL_DIMENSIONS);
+    return to_unit_float(owen_scramble(value, hash_pixel(px, py, static_cast<uint32_t>(dimension))));
+}
+
+float Sampler::get(int px, int py, int sample_index, int dimension) const {
+    switch (_type) {
+        case SamplerType::RANDOM: return random_sample(px, py, sample_index, dimension);
+        case SamplerType::R2:     return r2_sample(px, py, sample_index, dimension);
+        case SamplerType::SOBOL:  return sobol_sample(px, py, sample_index, dimension);
+    }
+    return 0.0f;
+}
+
+SamplerType sampler_type_from_name(const char* name) {
+    if (!strcmp(name, "random")) return SamplerType::RANDOM;
+    if (!strcmp(name, "r2")) return SamplerType::R2;
+    if (!strcmp(name, "sobol")) return SamplerType::SOBOL;
+    std::cerr << "Error: unknown sampler " << name << ", use random, r2 or sobol" << std::endl;
+    throw std::runtime_error("Unknown sampler");
+}
+
+const char* get_sampler_name(SamplerType type) {
+    switch (type) {
+        case SamplerType::RANDOM: return "random";
+        case SamplerType::R2:     return "r2";
+        case SamplerType::SOBOL:  return "sobol";
+    }
+    return "unknown";
+}
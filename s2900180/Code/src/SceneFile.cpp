@@ -0,0 +1,319 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+// the records are written and mapped exactly as they sit in memory
+static_assert(std::is_trivially_copyable_v<CubePrimitive> && std::is_trivially_copyable_v<SpherePrimitive> &&
+              std::is_trivially_copyable_v<PlanePrimitive> && std::is_trivially_copyable_v<TriangleMeshInstance>,
+              "primitive records must be plain data to be mapped");
+static_assert(sizeof(SceneFileHeader) % SCENE_FILE_ALIGNMENT == 0, "the first section should start aligned");
+
+MappedFile::MappedFile(const std::string& filepath) {
+    int file = open(filepath.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Error: Could not open the file at " << filepath << std::endl;
+        throw std::runtime_error("Could not open file");
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        close(file);
+        std::cerr << "Error: Could not read the size of " << filepath << std::endl;
+        throw std::runtime_error("Could not map file");
+    }
+    _size = static_cast<size_t>(status.st_size);
+
+    // the mapping stays valid once the descriptor is closed
+    void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) {
+        std::cerr << "Error: Could not map " << filepath << " into memory" << std::endl;
+        throw std::runtime_error("Could not map file");
+    }
+    _data = static_cast<const std::byte*>(data);
+}
+
+MappedFile::~MappedFile() {
+    if (_data != nullptr) munmap(const_cast<std::byte*>(_data), _size);
+}
+
+bool is_scene_file(const std::string& filepath) {
+    const std::string extension = ".rtscene";
+    return filepath.size() >= extension.size() &&
+           filepath.compare(filepath.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+namespace {
+
+void check_native_byte_order() {
+    // the file is used in place, so only machines that share its byte order can read it
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error("Compiled scenes are only supported on little endian machines");
+    }
+}
+
+// collects the sections of a file as they are written, padding each to the alignment
+class SceneFileWriter {
+  public:
+    SceneFileWriter() : _bytes(sizeof(SceneFileHeader), std::byte{0}) {};
+
+    template <typename T>
+    void add_section(SceneFileSectionId id, const T* records, size_t count) {
+        _bytes.resize((_bytes.size() + SCENE_FILE_ALIGNMENT - 1) / SCENE_FILE_ALIGNMENT * SCENE_FILE_ALIGNMENT);
+        _header.sections[id] = {_bytes.size(), count};
+        const std::byte* first = reinterpret_cast<const std::byte*>(records);
+        _bytes.insert(_bytes.end(), first, first + count * sizeof(T));
+    }
+
+    void write(const std::string& filepath) {
+        std::memcpy(_header.magic, SCENE_FILE_MAGIC, sizeof(_header.magic));
+        _header.version = SCENE_FILE_VERSION;
+        _header.byte_order = SCENE_FILE_BYTE_ORDER_MARK;
+        std::memcpy(_bytes.data(), &_header, sizeof(_header));
+
+        std::ofstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open " << filepath << " for writing" << std::endl;
+            throw std::runtime_error("Could not open file");
+        }
+        file.write(reinterpret_cast<const char*>(_bytes.data()), static_cast<std::streamsize>(_bytes.size()));
+    }
+
+  private:
+    SceneFileHeader _header{};
+    std::vector<std::byte> _bytes;
+};
+
+SceneFileString add_string(std::vector<char>& strings, const std::string& value) {
+    SceneFileString string{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(value.size())};
+    strings.insert(strings.end(), value.begin(), value.end());
+    return string;
+}
+
+void copy_vec3(float* destination, const Eigen::Vector3f& source) {
+    for (int i = 0; i < 3; i++) destination[i] = source[i];
+}
+
+// bounds checked view of one section of a mapped file
+template <typename T>
+std::span<const T> get_section(const MappedFile& file, const SceneFileHeader& header, SceneFileSectionId id) {
+    const SceneFileSection& section = header.sections[id];
+    if (section.offset % alignof(T) != 0 || section.offset > file.size() ||
+        section.count > (file.size() - section.offset) / sizeof(T)) {
+        throw std::runtime_error("Compiled scene has a section outside of the file");
+    }
+    return std::span<const T>(reinterpret_cast<const T*>(file.data() + section.offset), section.count);
+}
+
+std::string get_string(std::span<const char> strings, SceneFileString string) {
+    if (string.offset > strings.size() || string.length > strings.size() - string.offset) {
+        throw std::runtime_error("Compiled scene has a string outside of the file");
+    }
+    return std::string(strings.data() + string.offset, string.length);
+}
+
+// appends values to a buffer, returning where they start
+template <typename T>
+uint64_t add_values(std::vector<T>& buffer, const std::vector<T>& values) {
+    uint64_t offset = buffer.size();
+    buffer.insert(buffer.end(), values.begin(), values.end());
+    return offset;
+}
+
+// copies count values from offset out of a section
+template <typename T>
+std::vector<T> get_values(std::span<const T> section, uint64_t offset, uint64_t count) {
+    if (offset > section.size() || count > section.size() - offset) {
+        throw std::runtime_error("Compiled scene has a triangle mesh outside of the file");
+    }
+    return std::vector<T>(section.begin() + offset, section.begin() + offset + count);
+}
+
+} // namespace
+
+void write_scene_file(const std::string& filepath, const CameraProperties& camera, const std::vector<Light>& lights,
+                      const PrimitiveStore& store) {
+    check_native_byte_order();
+
+    SceneFileCamera camera_record;
+    copy_vec3(camera_record.location, camera.location);
+    copy_vec3(camera_record.gaze_vector_direction, camera.gaze_vector_direction);
+    copy_vec3(camera_record.up_vector, camera.up_vector);
+    camera_record.sensor_fit = static_cast<uint32_t>(camera.sensor_fit);
+    camera_record.focal_length = camera.focal_length;
+    camera_record.sensor_width = camera.sensor_width;
+    camera_record.sensor_height = camera.sensor_height;
+    camera_record.resolution_x = camera.resolution_x;
+    camera_record.resolution_y = camera.resolution_y;
+
+    std::vector<SceneFileLight> light_records;
+    for (Light light : lights) {
+        SceneFileLight record;
+        copy_vec3(record.location, light.get_location());
+        record.id = light.get_id();
+        record.is = light.get_is();
+        light_records.push_back(record);
+    }
+
+    std::vector<SceneFileMaterial> material_records;
+    std::vector<char> strings;
+    for (uint32_t i = 0; i < store.get_number_of_materials(); i++) {
+        const Material& material = store.get_material(i);
+        SceneFileMaterial record{material.ka, material.kd, material.ks, material.shininess, material.reflectivity,
+                                 material.transparancy, material.ior,
+                                 {material.base_colour.r, material.base_colour.g, material.base_colour.b},
+                                 add_string(strings, store.get_name_by_index(i)),
+                                 add_string(strings, material.texture ? material.texture->get_path() : "")};
+        material_records.push_back(record);
+    }
+
+    std::vector<SceneFileTriangleMesh> mesh_records;
+    std::vector<float> mesh_floats;
+    std::vector<uint32_t> mesh_indices;
+    for (const auto& mesh : store.get_triangle_mesh_data()) {
+        SceneFileTriangleMesh record{};
+        record.name = add_string(strings, mesh->get_name());
+        record.vertex_count = static_cast<uint32_t>(mesh->get_number_of_vertices());
+        record.triangle_count = static_cast<uint32_t>(mesh->get_number_of_triangles());
+        record.has_normals = !mesh->get_normals().empty();
+        record.has_uvs = !mesh->get_uvs().empty();
+        record.positions_offset = add_values(mesh_floats, mesh->get_positions());
+        record.normals_offset = add_values(mesh_floats, mesh->get_normals());
+        record.uvs_offset = add_values(mesh_floats, mesh->get_uvs());
+        record.indices_offset = add_values(mesh_indices, mesh->get_indices());
+        mesh_records.push_back(record);
+    }
+
+    PrimitiveArrays arrays = store.get_arrays();
+    SceneFileWriter writer;
+    writer.add_section(CAMERA_SECTION, &camera_record, 1);
+    writer.add_section(LIGHTS_SECTION, light_records.data(), light_records.size());
+    writer.add_section(MATERIALS_SECTION, material_records.data(), material_records.size());
+    writer.add_section(STRINGS_SECTION, strings.data(), strings.size());
+    writer.add_section(CUBES_SECTION, arrays.cubes.data(), arrays.cubes.size());
+    writer.add_section(SPHERES_SECTION, arrays.spheres.data(), arrays.spheres.size());
+    writer.add_section(PLANES_SECTION, arrays.planes.data(), arrays.planes.size());
+    writer.add_section(TRIANGLE_MESH_INSTANCES_SECTION, arrays.triangle_meshes.data(), arrays.triangle_meshes.size());
+    writer.add_section(TRIANGLE_MESHES_SECTION, mesh_records.data(), mesh_records.size());
+    writer.add_section(TRIANGLE_MESH_FLOATS_SECTION, mesh_floats.data(), mesh_floats.size());
+    writer.add_section(TRIANGLE_MESH_INDICES_SECTION, mesh_indices.data(), mesh_indices.size());
+    writer.add_section(REFERENCES_SECTION, arrays.references.data(), arrays.references.size());
+    writer.write(filepath);
+}
+
+CompiledScene SceneFileReader::load_scene() {
+    check_native_byte_order();
+
+    std::shared_ptr<const MappedFile> file = std::make_shared<const MappedFile>(_filepath);
+
+    SceneFileHeader header;
+    if (file->size() < sizeof(header)) {
+        throw std::runtime_error("Compiled scene is too small to hold a header");
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, SCENE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << "Error: " << _filepath << " is not a compiled scene" << std::endl;
+        throw std::runtime_error("Not a compiled scene");
+    }
+    if (header.version != SCENE_FILE_VERSION || header.byte_order != SCENE_FILE_BYTE_ORDER_MARK) {
+        std::cerr << "Error: " << _filepath << " was compiled by version " << header.version
+                  << ", recompile it with --compile-scene" << std::endl;
+        throw std::runtime_error("Compiled scene version mismatch");
+    }
+
+    std::span<const SceneFileCamera> cameras = get_section<SceneFileCamera>(*file, header, CAMERA_SECTION);
+    if (cameras.size() != 1) {
+        throw std::runtime_error("No camera object found in file");
+    }
+    const SceneFileCamera& camera = cameras[0];
+    CameraProperties camera_properties{
+        Eigen::Vector3f(camera.location[0], camera.location[1], camera.location[2]),
+        Eigen::Vector3f(camera.gaze_vector_direction[0], camera.gaze_vector_direction[1], camera.gaze_vector_direction[2]),
+        Eigen::Vector3f(camera.up_vector[0], camera.up_vector[1], camera.up_vector[2]),
+        static_cast<SensorFit>(camera.sensor_fit), camera.focal_length, camera.sensor_width, camera.sensor_height,
+        camera.resolution_x, camera.resolution_y};
+
+    std::vector<Light> lights;
+    for (const SceneFileLight& light : get_section<SceneFileLight>(*file, header, LIGHTS_SECTION)) {
+        lights.emplace_back(Eigen::Vector3f(light.location[0], light.location[1], light.location[2]), light.id, light.is);
+    }
+
+    // the materials are small and hold shared textures, so they are the one part rebuilt
+    std::span<const char> strings = get_section<char>(*file, header, STRINGS_SECTION);
+    std::vector<Material> materials;
+    std::vector<std::string> names;
+    for (const SceneFileMaterial& record : get_section<SceneFileMaterial>(*file, header, MATERIALS_SECTION)) {
+        Material material;
+        material.ka = record.ka;
+        material.kd = record.kd;
+        material.ks = record.ks;
+        material.shininess = record.shininess;
+        material.reflectivity = record.reflectivity;
+        material.transparancy = record.transparancy;
+        material.ior = record.ior;
+        material.base_colour = {record.base_colour[0], record.base_colour[1], record.base_colour[2]};
+
+        std::string texture_path = get_string(strings, record.texture_path);
+        if (!texture_path.empty()) material.texture = _texture_cache.get(texture_path);
+
+        materials.push_back(material);
+        names.push_back(get_string(strings, record.name));
+    }
+
+    // each mesh builds the tree over its triangles again, which checks its indices
+    std::span<const float> mesh_floats = get_section<float>(*file, header, TRIANGLE_MESH_FLOATS_SECTION);
+    std::span<const uint32_t> mesh_indices = get_section<uint32_t>(*file, header, TRIANGLE_MESH_INDICES_SECTION);
+    std::vector<std::shared_ptr<const TriangleMeshData>> meshes;
+    for (const SceneFileTriangleMesh& record : get_section<SceneFileTriangleMesh>(*file, header, TRIANGLE_MESHES_SECTION)) {
+        uint64_t vertex_count = record.vertex_count;
+        meshes.push_back(std::make_shared<const TriangleMeshData>(
+            get_string(strings, record.name),
+            get_values(mesh_floats, record.positions_offset, 3 * vertex_count),
+            get_values(mesh_floats, record.normals_offset, record.has_normals ? 3 * vertex_count : 0),
+            get_values(mesh_floats, record.uvs_offset, record.has_uvs ? 2 * vertex_count : 0),
+            get_values(mesh_indices, record.indices_offset, 3 * static_cast<uint64_t>(record.triangle_count))));
+    }
+
+    PrimitiveArrays arrays{get_section<CubePrimitive>(*file, header, CUBES_SECTION),
+                           get_section<SpherePrimitive>(*file, header, SPHERES_SECTION),
+                           get_section<PlanePrimitive>(*file, header, PLANES_SECTION),
+                           get_section<TriangleMeshInstance>(*file, header, TRIANGLE_MESH_INSTANCES_SECTION),
+                           get_section<uint32_t>(*file, header, REFERENCES_SECTION)};
+
+    // every reference and material index is checked once here, so the renderer can trust them
+    auto is_valid = [&](const auto& records, uint32_t index) {
+        return index < records.size() && records[index].material_index < materials.size() &&
+               records[index].metadata_index < names.size();
+    };
+    for (uint32_t reference : arrays.references) {
+        uint32_t index = primitive_index(reference);
+        bool valid = false;
+        switch (primitive_type(reference)) {
+            case MeshType::CUBE:   valid = is_valid(arrays.cubes, index); break;
+            case MeshType::SPHERE: valid = is_valid(arrays.spheres, index); break;
+            case MeshType::PLANE:  valid = is_valid(arrays.planes, index); break;
+            case MeshType::TRIANGLE_MESH:
+                valid = is_valid(arrays.triangle_meshes, index) &&
+                        arrays.triangle_meshes[index].mesh_index < meshes.size();
+                break;
+        }
+        if (!valid) throw std::runtime_error("Compiled scene has a primitive outside of the file");
+    }
+
+    return CompiledScene{Camera(camera_properties), std::move(lights),
+                         PrimitiveStore(arrays, std::move(meshes), std::move(materials), std::move(names), file)};
+}
+
+void SceneFileReader::wait_for_textures() {
+    _texture_cache.wait();
+}
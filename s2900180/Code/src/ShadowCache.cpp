@@ -0,0 +1,19 @@
+#include "ShadowCache.h"
+
+bool ShadowCache::occluded(const BoundingBoxHierarchyTree& tree, const Ray& ray, float t_max, uint32_t light_index,
+                           RenderStatistics* statistics) {
+    if (light_index >= _occluders.size()) _occluders.resize(light_index + 1, NO_PRIMITIVE);
+    uint32_t& occluder = _occluders[light_index];
+
+    if (occluder != NO_PRIMITIVE) {
+        statistics->shadow_cache_lookups++;
+        if (tree.is_occluded_by(occluder, ray, t_max, statistics)) {
+            statistics->shadow_cache_hits++;
+            return true;
+        }
+    }
+
+    // a lit point forgets the blocker, so lit areas do not keep paying for the extra test
+    occluder = NO_PRIMITIVE;
+    return tree.occluded(ray, t_max, statistics, &occluder);
+}
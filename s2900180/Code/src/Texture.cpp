@@ -0,0 +1,211 @@
+#include "Texture.h"
+#include "Image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+uint16_t float_to_half(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    bits &= 0x7fffffff;
+
+    // infinity and nan keep their meaning, anything past the largest half becomes infinity
+    if (bits >= 0x7f800000) return sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0);
+    if (bits >= 0x477ff000) return sign | 0x7c00;
+
+    // below the smallest normal half, the value is a whole number of 2^-24 steps
+    if (bits < 0x38800000) {
+        return sign | static_cast<uint16_t>(std::lrint(std::fabs(value) * 16777216.0f));
+    }
+
+    // rebias the exponent and round the dropped 13 mantissa bits to nearest even
+    bits += 0xc8000fff + ((bits >> 13) & 1);
+    return sign | static_cast<uint16_t>(bits >> 13);
+}
+
+float half_to_float(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+
+    if (exponent == 0) {
+        float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+
+    uint32_t bits = exponent == 31
+        ? sign | 0x7f800000 | (mantissa << 13)
+        : sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+namespace {
+
+// next level of the mip chain, each texel the average of the (up to) four beneath it
+std::vector<float> downsample(const std::vector<float>& values, int width, int height, int next_width, int next_height) {
+    std::vector<float> next(static_cast<size_t>(next_width) * next_height * 3);
+    for (int py = 0; py < next_height; py++) {
+        int y0 = std::min(2 * py, height - 1);
+        int y1 = std::min(2 * py + 1, height - 1);
+        for (int px = 0; px < next_width; px++) {
+            int x0 = std::min(2 * px, width - 1);
+            int x1 = std::min(2 * px + 1, width - 1);
+            for (int c = 0; c < 3; c++) {
+                float sum = values[(static_cast<size_t>(y0) * width + x0) * 3 + c]
+                          + values[(static_cast<size_t>(y0) * width + x1) * 3 + c]
+                          + values[(static_cast<size_t>(y1) * width + x0) * 3 + c]
+                          + values[(static_cast<size_t>(y1) * width + x1) * 3 + c];
+                next[(static_cast<size_t>(py) * next_width + px) * 3 + c] = sum * 0.25f;
+            }
+        }
+    }
+    return next;
+}
+
+} // namespace
+
+Texture::Texture(const PPMImageFile& image) : _path(image.get_filename()) {
+    // lay out every level first, so the texels of the whole chain live in one allocation
+    int width = image.get_width();
+    int height = image.get_height();
+    size_t texels = 0;
+    while (true) {
+        int tiles_x = (width + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        int tiles_y = (height + TEXTURE_TILE_SIZE - 1) / TEXTURE_TILE_SIZE;
+        _levels.push_back({width, height, tiles_x, texels});
+        texels += static_cast<size_t>(tiles_x) * tiles_y * TEXELS_PER_TEXTURE_TILE;
+        if (width == 1 && height == 1) break;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+
+    // the levels are filtered in float, whatever they end up stored as
+    std::vector<float> values = image.get_float_data();
+    if (values.empty()) {
+        _format = TexelFormat::RGB8;
+        _rgb8.resize(texels * 3);
+        const std::vector<uint8_t>& bytes = image.get_data();
+        values.resize(bytes.size());
+        std::transform(bytes.begin(), bytes.end(), values.begin(), [](uint8_t value) { return value / 255.0f; });
+    } else {
+        _format = TexelFormat::HALF_RGB;
+        _half.resize(texels * 3);
+    }
+
+    for (int level = 0; level < get_number_of_levels(); level++) {
+        if (level > 0) {
+            const TextureLevel& previous = _levels[level - 1];
+            values = downsample(values, previous.width, previous.height, _levels[level].width, _levels[level].height);
+        }
+        store_level(level, values);
+    }
+}
+
+void Texture::store_level(int level, const std::vector<float>& values) {
+    const TextureLevel& current = _levels[level];
+    for (int py = 0; py < current.height; py++) {
+        for (int px = 0; px < current.width; px++) {
+            size_t source = (static_cast<size_t>(py) * current.width + px) * 3;
+            size_t destination = current.texel_index(px, py) * 3;
+            for (int c = 0; c < 3; c++) {
+                if (_format == TexelFormat::RGB8) {
+                    _rgb8[destination + c] = static_cast<uint8_t>(std::clamp(values[source + c] * 255.0f + 0.5f, 0.0f, 255.0f));
+                } else {
+                    _half[destination + c] = float_to_half(values[source + c]);
+                }
+            }
+        }
+    }
+}
+
+std::shared_ptr<const Texture> Texture::from_file(const std::string& path) {
+    // the image is only needed while its texels are packed
+    PPMImageFile image(path);
+    image.read_image_from_file();
+    return std::make_shared<const Texture>(image);
+}
+
+Eigen::Vector3f Texture::get_texel(int px, int py, int level) const {
+    size_t i = _levels[level].texel_index(px, py) * 3;
+    if (_format == TexelFormat::HALF_RGB) {
+        return Eigen::Vector3f(half_to_float(_half[i]), half_to_float(_half[i + 1]), half_to_float(_half[i + 2]));
+    }
+    return Eigen::Vector3f(_rgb8[i] / 255.0f, _rgb8[i + 1] / 255.0f, _rgb8[i + 2] / 255.0f);
+}
+
+Eigen::Vector3f Texture::sample_level(float u, float v, int level) const {
+    // texel centres sit at half steps, lookups past the edges repeat the edge texels
+    const TextureLevel& current = _levels[level];
+    float x = std::clamp(u, 0.0f, 1.0f) * current.width - 0.5f;
+    float y = std::clamp(v, 0.0f, 1.0f) * current.height - 0.5f;
+    float x_floor = std::floor(x);
+    float y_floor = std::floor(y);
+    float fx = x - x_floor;
+    float fy = y - y_floor;
+
+    int x0 = std::clamp(static_cast<int>(x_floor), 0, current.width - 1);
+    int x1 = std::min(static_cast<int>(x_floor) + 1, current.width - 1);
+    int y0 = std::clamp(static_cast<int>(y_floor), 0, current.height - 1);
+    int y1 = std::min(static_cast<int>(y_floor) + 1, current.height - 1);
+
+    Eigen::Vector3f top = get_texel(x0, y0, level) * (1.0f - fx) + get_texel(x1, y0, level) * fx;
+    Eigen::Vector3f bottom = get_texel(x0, y1, level) * (1.0f - fx) + get_texel(x1, y1, level) * fx;
+    return top * (1.0f - fy) + bottom * fy;
+}
+
+Eigen::Vector3f Texture::sample(float u, float v, float lod) const {
+    lod = std::clamp(lod, 0.0f, static_cast<float>(get_number_of_levels() - 1));
+    int level = static_cast<int>(lod);
+    float blend = lod - level;
+
+    Eigen::Vector3f colour = sample_level(u, v, level);
+    if (blend > 0.0f) colour = colour * (1.0f - blend) + sample_level(u, v, level + 1) * blend;
+    return colour;
+}
+
+float Texture::get_lod(float uv_footprint) const {
+    // the footprint measured in texels of the full image, non square images use their mean size
+    float texels = uv_footprint * std::sqrt(static_cast<float>(get_width()) * get_height());
+    if (!(texels > 1.0f)) return 0.0f;
+    return std::log2(texels);
+}
+
+std::shared_ptr<const Texture> TextureCache::get(const std::string& path) {
+    // the same file can be reached through different spellings of its path
+    std::error_code error;
+    std::string key = std::filesystem::weakly_canonical(path, error).string();
+    if (error) key = path;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _textures.find(key);
+    if (found != _textures.end()) return found->second;
+
+    // each texture is filled in place, so the pointer handed out now stays valid
+    std::shared_ptr<Texture> texture = std::make_shared<Texture>();
+    _pending.push_back(std::async(std::launch::async, [texture, path]() {
+        PPMImageFile image(path);
+        image.read_image_from_file();
+        *texture = Texture(image);
+    }));
+    _textures.emplace(key, texture);
+    return texture;
+}
+
+void TextureCache::wait() {
+    std::vector<std::future<void>> pending;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        pending.swap(_pending);
+    }
+    for (std::future<void>& texture : pending) texture.get();
+}
+
+size_t TextureCache::size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _textures.size();
+}
@@ -0,0 +1,83 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+WorkStealingThreadPool::WorkStealingThreadPool(int number_of_threads) {
+    if (number_of_threads <= 0) {
+        number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    _number_of_threads = number_of_threads;
+
+    for (int i = 0; i < _number_of_threads; i++) {
+        _queues.push_back(std::make_unique<WorkerQueue>());
+    }
+}
+
+bool WorkStealingThreadPool::next_task(int worker_index, int& task_index) {
+    // own queue first, front to back so neighbouring tasks run one after another
+    {
+        WorkerQueue& own = *_queues[worker_index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task_index = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the back of the other queues, furthest away from what their owner is working on
+    for (int offset = 1; offset < _number_of_threads; offset++) {
+        WorkerQueue& victim = *_queues[(worker_index + offset) % _number_of_threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task_index = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void WorkStealingThreadPool::run(int number_of_tasks, const std::function<void(int, int)>& task) {
+    // hand every worker a contiguous block of tasks to start with
+    for (int w = 0; w < _number_of_threads; w++) {
+        int begin = static_cast<int>(static_cast<long long>(number_of_tasks) * w / _number_of_threads);
+        int end = static_cast<int>(static_cast<long long>(number_of_tasks) * (w + 1) / _number_of_threads);
+        std::lock_guard<std::mutex> lock(_queues[w]->mutex);
+        _queues[w]->tasks.clear();
+        for (int t = begin; t < end; t++) {
+            _queues[w]->tasks.push_back(t);
+        }
+    }
+
+    // keep the first exception thrown by any task and rethrow it once every worker has stopped
+    std::exception_ptr first_exception;
+    std::mutex exception_mutex;
+
+    auto worker = [&](int worker_index) {
+        int task_index;
+        while (next_task(worker_index, task_index)) {
+            try {
+                task(task_index, worker_index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                if (!first_exception) first_exception = std::current_exception();
+            }
+        }
+    };
+
+    // the calling thread acts as worker 0
+    std::vector<std::thread> threads;
+    for (int w = 1; w < _number_of_threads; w++) {
+        threads.emplace_back(worker, w);
+    }
+    worker(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    if (first_exception) std::rethrow_exception(first_exception);
+}
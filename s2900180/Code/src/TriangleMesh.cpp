@@ -0,0 +1,310 @@
+#include "TriangleMesh.h"
+#include "Light.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+
+constexpr int TRIANGLE_MESH_STACK_SIZE = 64;
+
+// slab test of a ray against a node, as intersect_node does for the scene's tree
+bool intersect_triangle_mesh_node(const TriangleMeshNode& node, const Ray& ray, float t_max) {
+    float tmin = 0.0f;
+    for (int i = 0; i < 3; i++) {
+        float t0 = (node.min[i] - ray.origin[i]) * ray.inv_direction[i];
+        float t1 = (node.max[i] - ray.origin[i]) * ray.inv_direction[i];
+        if (ray.direction_is_negative[i]) std::swap(t0, t1);
+        tmin = std::max(tmin, t0);
+        t_max = std::min(t_max, t1);
+        if (t_max < tmin) return false;
+    }
+    return true;
+}
+
+} // namespace
+
+TriangleMeshData::TriangleMeshData(std::string name, std::vector<float> positions, std::vector<float> normals,
+                                   std::vector<float> uvs, std::vector<uint32_t> indices)
+    : _name(std::move(name)), _positions(std::move(positions)), _normals(std::move(normals)), _uvs(std::move(uvs)),
+      _indices(std::move(indices)) {
+    size_t vertex_count = _positions.size() / 3;
+    bool is_valid = _positions.size() % 3 == 0 && !_indices.empty() && _indices.size() % 3 == 0 &&
+                    (_normals.empty() || _normals.size() == _positions.size()) &&
+                    (_uvs.empty() || _uvs.size() == 2 * vertex_count);
+    for (uint32_t index : _indices) {
+        is_valid &= index < vertex_count;
+    }
+    if (!is_valid) {
+        std::cerr << "Error: the triangle mesh " << _name << " has buffers of mismatched sizes" << std::endl;
+        throw std::runtime_error("Invalid triangle mesh");
+    }
+
+    uint32_t triangle_count = static_cast<uint32_t>(get_number_of_triangles());
+    std::vector<uint32_t> order(triangle_count);
+    std::iota(order.begin(), order.end(), 0);
+
+    std::vector<Eigen::Vector3f> centroids(triangle_count);
+    for (uint32_t i = 0; i < triangle_count; i++) {
+        Eigen::Vector3f corners[3];
+        get_corners(i, corners);
+        centroids[i] = (corners[0] + corners[1] + corners[2]) / 3.0f;
+    }
+
+    _nodes.reserve(2 * triangle_count);
+    build(order, centroids, 0, triangle_count, 0);
+    _min_bound = Eigen::Vector3f(_nodes[0].min[0], _nodes[0].min[1], _nodes[0].min[2]);
+    _max_bound = Eigen::Vector3f(_nodes[0].max[0], _nodes[0].max[1], _nodes[0].max[2]);
+
+    // the leaves point at runs of triangles, so the triangles are stored in the order of the tree
+    std::vector<uint32_t> sorted_indices(_indices.size());
+    for (uint32_t i = 0; i < triangle_count; i++) {
+        for (int corner = 0; corner < 3; corner++) {
+            sorted_indices[3*i + corner] = _indices[3*order[i] + corner];
+        }
+    }
+    _indices = std::move(sorted_indices);
+}
+
+uint32_t TriangleMeshData::build(std::vector<uint32_t>& order, std::vector<Eigen::Vector3f>& centroids,
+                                 uint32_t first, uint32_t last, int depth) {
+    uint32_t node_index = static_cast<uint32_t>(_nodes.size());
+    _nodes.push_back(TriangleMeshNode{});
+
+    Eigen::Vector3f min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    Eigen::Vector3f centroid_min = min;
+    Eigen::Vector3f centroid_max = max;
+    for (uint32_t i = first; i < last; i++) {
+        Eigen::Vector3f corners[3];
+        get_corners(order[i], corners);
+        for (const Eigen::Vector3f& corner : corners) {
+            min = min.cwiseMin(corner);
+            max = max.cwiseMax(corner);
+        }
+        centroid_min = centroid_min.cwiseMin(centroids[order[i]]);
+        centroid_max = centroid_max.cwiseMax(centroids[order[i]]);
+    }
+    for (int i = 0; i < 3; i++) {
+        _nodes[node_index].min[i] = min[i];
+        _nodes[node_index].max[i] = max[i];
+    }
+
+    uint32_t count = last - first;
+    if (count <= TRIANGLE_MESH_MAX_LEAF_SIZE || depth >= TRIANGLE_MESH_MAX_DEPTH) {
+        _nodes[node_index].offset = first;
+        _nodes[node_index].triangle_count = static_cast<uint16_t>(count);
+        _nodes[node_index].is_leaf = 1;
+        return node_index;
+    }
+
+    // split at the median of the axis the centroids spread furthest along
+    int axis = 0;
+    (centroid_max - centroid_min).maxCoeff(&axis);
+    uint32_t middle = first + count / 2;
+    std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+                     [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    build(order, centroids, first, middle, depth + 1);
+    uint32_t second = build(order, centroids, middle, last, depth + 1);
+    _nodes[node_index].offset = second;
+    _nodes[node_index].axis = static_cast<uint8_t>(axis);
+    _nodes[node_index].is_leaf = 0;
+    return node_index;
+}
+
+void TriangleMeshData::get_corners(uint32_t triangle, Eigen::Vector3f corners[3]) const {
+    for (int i = 0; i < 3; i++) corners[i] = get_position(_indices[3*triangle + i]);
+}
+
+bool TriangleMeshData::get_corner_uvs(uint32_t triangle, Eigen::Vector2f uvs[3]) const {
+    if (_uvs.empty()) return false;
+    for (int i = 0; i < 3; i++) {
+        uint32_t vertex = _indices[3*triangle + i];
+        uvs[i] = Eigen::Vector2f(_uvs[2*vertex], _uvs[2*vertex + 1]);
+    }
+    return true;
+}
+
+bool TriangleMeshData::intersect_triangle(uint32_t triangle, const Ray& ray, TriangleHit& hit) const {
+    Eigen::Vector3f corners[3];
+    get_corners(triangle, corners);
+    Eigen::Vector3f edge1 = corners[1] - corners[0];
+    Eigen::Vector3f edge2 = corners[2] - corners[0];
+
+    Eigen::Vector3f p = ray.direction.cross(edge2);
+    float determinant = edge1.dot(p);
+    if (std::abs(determinant) < 1e-12f) return false; // parallel
+    float inv_determinant = 1.0f / determinant;
+
+    Eigen::Vector3f s = ray.origin - corners[0];
+    float b1 = s.dot(p) * inv_determinant;
+    if (b1 < 0.0f || b1 > 1.0f) return false;
+
+    Eigen::Vector3f q = s.cross(edge1);
+    float b2 = ray.direction.dot(q) * inv_determinant;
+    if (b2 < 0.0f || b1 + b2 > 1.0f) return false;
+
+    float t = edge2.dot(q) * inv_determinant;
+    if (t <= 0.0f || t >= hit.distance) return false;
+
+    hit = TriangleHit{t, triangle, b1, b2};
+    return true;
+}
+
+bool TriangleMeshData::intersect(const Ray& ray, float t_max, TriangleHit& hit) const {
+    hit.distance = t_max;
+    bool is_hit = false;
+
+    uint32_t stack[TRIANGLE_MESH_STACK_SIZE];
+    int stack_size = 0;
+    uint32_t node_index = 0;
+
+    while (true) {
+        const TriangleMeshNode& node = _nodes[node_index];
+        if (intersect_triangle_mesh_node(node, ray, hit.distance)) {
+            if (node.is_leaf) {
+                for (uint32_t i = node.offset; i < node.offset + node.triangle_count; i++) {
+                    is_hit |= intersect_triangle(i, ray, hit);
+                }
+            } else if (ray.direction_is_negative[node.axis]) {
+                stack[stack_size++] = node_index + 1;
+                node_index = node.offset;
+                continue;
+            } else {
+                stack[stack_size++] = node.offset;
+                node_index = node_index + 1;
+                continue;
+            }
+        }
+
+        if (stack_size == 0) break;
+        node_index = stack[--stack_size];
+    }
+    return is_hit;
+}
+
+bool TriangleMeshData::occluded(const Ray& ray, float t_max) const {
+    TriangleHit hit{t_max, 0, 0.0f, 0.0f};
+
+    uint32_t stack[TRIANGLE_MESH_STACK_SIZE];
+    int stack_size = 0;
+    uint32_t node_index = 0;
+
+    while (true) {
+        const TriangleMeshNode& node = _nodes[node_index];
+        if (intersect_triangle_mesh_node(node, ray, t_max)) {
+            if (node.is_leaf) {
+                // any hit before t_max will do, so there is no need to find the closest
+                for (uint32_t i = node.offset; i < node.offset + node.triangle_count; i++) {
+                    if (intersect_triangle(i, ray, hit)) return true;
+                }
+            } else {
+                stack[stack_size++] = node.offset;
+                node_index = node_index + 1;
+                continue;
+            }
+        }
+
+        if (stack_size == 0) break;
+        node_index = stack[--stack_size];
+    }
+    return false;
+}
+
+void TriangleMeshData::get_surface(const TriangleHit& hit, Eigen::Vector3f& normal, float& u, float& v) const {
+    float b0 = 1.0f - hit.b1 - hit.b2;
+    const uint32_t* vertices = &_indices[3*hit.triangle];
+
+    if (_normals.empty()) {
+        Eigen::Vector3f corners[3];
+        get_corners(hit.triangle, corners);
+        normal = (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+    } else {
+        normal = Eigen::Vector3f::Zero();
+        float weights[3] = {b0, hit.b1, hit.b2};
+        for (int i = 0; i < 3; i++) {
+            const float* n = &_normals[3*vertices[i]];
+            normal += weights[i] * Eigen::Vector3f(n[0], n[1], n[2]);
+        }
+    }
+
+    Eigen::Vector2f uvs[3];
+    if (get_corner_uvs(hit.triangle, uvs)) {
+        Eigen::Vector2f uv = b0 * uvs[0] + hit.b1 * uvs[1] + hit.b2 * uvs[2];
+        u = uv.x();
+        v = uv.y();
+    } else {
+        u = -1.0f;
+        v = -1.0f;
+    }
+}
+
+TriangleMeshInstance make_triangle_mesh_instance(const Eigen::Matrix4f& matrix_world, const TriangleMeshData& mesh) {
+    TriangleMeshInstance instance{};
+    Eigen::Matrix3f linear = matrix_world.topLeftCorner<3, 3>();
+    Eigen::Vector3f translation = matrix_world.topRightCorner<3, 1>();
+    Eigen::Matrix3f inv_linear = linear.inverse();
+
+    Eigen::Map<Eigen::Matrix3f>(instance.linear) = linear;
+    Eigen::Map<Eigen::Matrix3f>(instance.inv_linear) = inv_linear;
+    Eigen::Map<Eigen::Vector3f>(instance.translation) = translation;
+    Eigen::Map<Eigen::Vector3f>(instance.inv_translation) = -inv_linear * translation;
+
+    // the world bounds hold every corner of the local bounds once transformed
+    Eigen::Vector3f min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f max = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    for (int corner = 0; corner < 8; corner++) {
+        Eigen::Vector3f local((corner & 1) ? mesh.get_max_bound().x() : mesh.get_min_bound().x(),
+                              (corner & 2) ? mesh.get_max_bound().y() : mesh.get_min_bound().y(),
+                              (corner & 4) ? mesh.get_max_bound().z() : mesh.get_min_bound().z());
+        Eigen::Vector3f world = linear * local + translation;
+        min = min.cwiseMin(world);
+        max = max.cwiseMax(world);
+    }
+    Eigen::Map<Eigen::Vector3f>(instance.min) = min;
+    Eigen::Map<Eigen::Vector3f>(instance.max) = max;
+    return instance;
+}
+
+Ray to_instance_space(const TriangleMeshInstance& instance, const Ray& ray) {
+    return Ray(as_mat3(instance.inv_linear) * ray.origin + as_vec3(instance.inv_translation),
+               as_mat3(instance.inv_linear) * ray.direction);
+}
+
+bool check_intersect_triangle_mesh(const TriangleMeshInstance& instance, const TriangleMeshData& mesh,
+                                   const Ray& ray, const ShadingMaterial* material, Hit* hit) {
+    // a hit is only kept if it is closer than the one already held, so nothing past it is looked at
+    float t_max = hit->is_hit ? hit->distance_along_ray : std::numeric_limits<float>::infinity();
+    TriangleHit triangle_hit;
+    if (!mesh.intersect(to_instance_space(instance, ray), t_max, triangle_hit)) {
+        return false;
+    }
+
+    Eigen::Vector3f local_normal;
+    float u, v;
+    mesh.get_surface(triangle_hit, local_normal, u, v);
+
+    // normals move by the inverse transpose, so they stay perpendicular under non uniform scales
+    Eigen::Vector3f world_normal = (as_mat3(instance.inv_linear).transpose() * local_normal).normalized();
+    Eigen::Vector3f world_hit = ray.origin + triangle_hit.distance * ray.direction;
+
+    // the square root of the world area of the triangle per unit of texture area
+    float uv_scale = 0.0f;
+    Eigen::Vector2f uvs[3];
+    if (mesh.get_corner_uvs(triangle_hit.triangle, uvs)) {
+        Eigen::Vector3f corners[3];
+        mesh.get_corners(triangle_hit.triangle, corners);
+        Eigen::Vector3f edge1 = as_mat3(instance.linear) * (corners[1] - corners[0]);
+        Eigen::Vector3f edge2 = as_mat3(instance.linear) * (corners[2] - corners[0]);
+        Eigen::Vector2f uv_edge1 = uvs[1] - uvs[0];
+        Eigen::Vector2f uv_edge2 = uvs[2] - uvs[0];
+        float uv_area = std::abs(uv_edge1.x() * uv_edge2.y() - uv_edge1.y() * uv_edge2.x());
+        if (uv_area > 0.0f) uv_scale = std::sqrt(edge1.cross(edge2).norm() / uv_area);
+    }
+
+    update_hit_from_intersection(hit, world_hit, world_normal, triangle_hit.distance, material, u, v, uv_scale);
+    return true;
+}
@@ -0,0 +1,57 @@
+#include "Wavefront.h"
+
+#include <algorithm>
+#include <array>
+
+namespace {
+
+// every 10 bit value with its bits spread out to every third bit, so a Morton code is three lookups
+std::array<uint32_t, 1 << RAY_SORT_BITS_PER_AXIS> make_spread_bits_table() {
+    std::array<uint32_t, 1 << RAY_SORT_BITS_PER_AXIS> table{};
+    for (uint32_t x = 0; x < table.size(); x++) {
+        for (int bit = 0; bit < RAY_SORT_BITS_PER_AXIS; bit++) table[x] |= ((x >> bit) & 1u) << (3 * bit);
+    }
+    return table;
+}
+
+const std::array<uint32_t, 1 << RAY_SORT_BITS_PER_AXIS> SPREAD_BITS = make_spread_bits_table();
+
+// interleaves three values in [0, 1] into a 30 bit Morton code
+uint64_t morton_code(const Eigen::Vector3f& values) {
+    const float scale = static_cast<float>((1 << RAY_SORT_BITS_PER_AXIS) - 1);
+    Eigen::Vector3f quantised = (values.cwiseMax(0.0f).cwiseMin(1.0f) * scale);
+    return (SPREAD_BITS[static_cast<uint32_t>(quantised[0])] << 2) |
+           (SPREAD_BITS[static_cast<uint32_t>(quantised[1])] << 1) |
+           SPREAD_BITS[static_cast<uint32_t>(quantised[2])];
+}
+
+} // namespace
+
+uint64_t get_ray_sort_key(const Ray& ray, const Eigen::Vector3f& scene_min, const Eigen::Vector3f& inv_scene_extent) {
+    uint64_t octant = static_cast<uint64_t>(ray.direction_is_negative[0] | (ray.direction_is_negative[1] << 1) |
+                                            (ray.direction_is_negative[2] << 2));
+    uint64_t origin = morton_code((ray.origin - scene_min).cwiseProduct(inv_scene_extent));
+    uint64_t direction = morton_code((ray.direction + Eigen::Vector3f::Ones()) * 0.5f);
+    return (octant << 60) | (origin << 30) | direction;
+}
+
+void RayQueue::sort(const Eigen::Vector3f& scene_min, const Eigen::Vector3f& scene_max) {
+    // a flat scene would divide by zero, any scale works along an axis with no extent
+    Eigen::Vector3f extent = (scene_max - scene_min).cwiseMax(Eigen::Vector3f::Constant(1e-6f));
+    Eigen::Vector3f inv_extent = extent.cwiseInverse();
+
+    _keys.resize(_rays.size());
+    for (size_t i = 0; i < _rays.size(); i++) {
+        _keys[i] = {get_ray_sort_key(_rays[i], scene_min, inv_extent), static_cast<uint32_t>(i)};
+    }
+    std::sort(_keys.begin(), _keys.end());
+
+    _sorted_rays.resize(_rays.size());
+    _sorted_ids.resize(_ids.size());
+    for (size_t i = 0; i < _keys.size(); i++) {
+        _sorted_rays[i] = _rays[_keys[i].second];
+        _sorted_ids[i] = _ids[_keys[i].second];
+    }
+    std::swap(_rays, _sorted_rays);
+    std::swap(_ids, _sorted_ids);
+}
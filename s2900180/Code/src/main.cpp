@@ -4,6 +4,11 @@ int main(int argc, char* argv[]) {
   RayTracer raytracer;
 
   raytracer.create_settings_from_command_args(argc, argv);
+  if (raytracer.is_compiling_scene()) {
+    raytracer.compile_scene();
+    return 0;
+  }
+
   raytracer.setup();
 
   raytracer.render_image();
@@ -2,6 +2,7 @@
 #include "BlenderFileReader.h"
 #include "AccelerationHierarchy.h"
 #include "Camera.h"
+#include "CameraRayGenerator.h"
 #include <chrono>
 #include <iostream>
 #include <Eigen/Dense>
@@ -10,51 +11,109 @@
 struct Colour white{255, 255, 255};
 
 void measureExecutionTime(
-    int (*func)(CameraProperties, PPMImageFile&, std::vector<std::unique_ptr<Mesh>>&),
+    long long (*func)(CameraProperties, PPMImageFile&, std::vector<std::unique_ptr<Mesh>>&, RenderStatistics&),
     CameraProperties props, PPMImageFile& image, std::vector<std::unique_ptr<Mesh>>& meshes) {
 
+  RenderStatistics statistics;
   auto start = std::chrono::high_resolution_clock::now();
 
-  int cycle_count = func(props, image, meshes); // call the function with parameters
+  long long cycle_count = func(props, image, meshes, statistics); // call the function with parameters
 
   auto end = std::chrono::high_resolution_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+  auto duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+  long long amount_of_rays = static_cast<long long>(image.get_width()) * image.get_height();
 
   std::cout << "Execution time: " << duration.count() << " ms" << std::endl;
+  std::cout << "Time per ray: " << duration_ns.count() / amount_of_rays << " ns" << std::endl;
   std::cout << "Amount of intersection tests: " << cycle_count << std::endl;
+  std::cout << "  Node visits: " << statistics.node_visits << std::endl;
+  std::cout << "  Primitive tests: " << statistics.get_total_primitive_tests() << std::endl;
+  std::cout << "Intersection tests per ray: " << static_cast<double>(cycle_count) / amount_of_rays << std::endl;
 }
 
-int hierarchy_acceleration(CameraProperties props, PPMImageFile& image, std::vector<std::unique_ptr<Mesh>>& meshes) {
-    BoundingBoxHierarchyTree bbht = BoundingBoxHierarchyTree(std::move(meshes));
-    int counter = 0;
+long long hierarchy_acceleration(CameraProperties props, PPMImageFile& image, std::vector<std::unique_ptr<Mesh>>& meshes,
+                                 RenderStatistics& statistics, BoundingBoxBuilder builder, int width) {
+    // the tree takes ownership, so build it from copies to leave the meshes for the next test
+    std::vector<std::unique_ptr<Mesh>> copied_meshes;
+    for (auto& mesh : meshes) {
+      copied_meshes.push_back(mesh->clone());
+    }
+    BoundingBoxHierarchyTree bbht = BoundingBoxHierarchyTree(std::move(copied_meshes), builder, width);
+    CameraRayGenerator camera_rays(props);
     for (int px = 0; px < image.get_width(); px++) {
       for (int py = 0; py < image.get_height(); py++) {
-        Pixel p = image.get_pixel(px, py);
-        Ray r = p.as_ray(props);
+        Ray r = camera_rays.get_ray(px, py);
         Hit h;
-        if (bbht.check_intersect(r, &h, &counter)) {
+        if (bbht.check_intersect(r, &h, &statistics)) {
           image.update_pixel(px, py, white);
         }
       }
     }
-  return counter;
+  return statistics.node_visits + statistics.get_total_primitive_tests();
+}
+
+long long midpoint_hierarchy_acceleration(CameraProperties props, PPMImageFile& image,
+                                          std::vector<std::unique_ptr<Mesh>>& meshes, RenderStatistics& statistics) {
+  return hierarchy_acceleration(props, image, meshes, statistics, BoundingBoxBuilder::MIDPOINT, 2);
+}
+
+long long sah_hierarchy_acceleration(CameraProperties props, PPMImageFile& image,
+                                     std::vector<std::unique_ptr<Mesh>>& meshes, RenderStatistics& statistics) {
+  return hierarchy_acceleration(props, image, meshes, statistics, BoundingBoxBuilder::SAH, 2);
+}
+
+long long wide_sah_hierarchy_acceleration(CameraProperties props, PPMImageFile& image,
+                                          std::vector<std::unique_ptr<Mesh>>& meshes, RenderStatistics& statistics) {
+  // same tree as above collapsed into 4 wide nodes, so the two traversals can be compared
+  return hierarchy_acceleration(props, image, meshes, statistics, BoundingBoxBuilder::SAH, WIDE_NODE_WIDTH);
+}
+
+long long packet_hierarchy_acceleration(CameraProperties props, PPMImageFile& image,
+                                        std::vector<std::unique_ptr<Mesh>>& meshes, RenderStatistics& statistics) {
+    /*
+      Same as the SAH hierarchy, but tracing RAY_PACKET_SIZE neighbouring pixels of a row together
+    */
+    std::vector<std::unique_ptr<Mesh>> copied_meshes;
+    for (auto& mesh : meshes) {
+      copied_meshes.push_back(mesh->clone());
+    }
+    BoundingBoxHierarchyTree bbht = BoundingBoxHierarchyTree(std::move(copied_meshes), BoundingBoxBuilder::SAH);
+    std::cout << "Packet traversal: " << get_packet_traversal_name() << std::endl;
+    CameraRayGenerator camera_rays(props);
+    for (int py = 0; py < image.get_height(); py++) {
+      for (int px = 0; px + RAY_PACKET_SIZE <= image.get_width(); px += RAY_PACKET_SIZE) {
+        Ray rays[RAY_PACKET_SIZE];
+        Hit hits[RAY_PACKET_SIZE];
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+          rays[lane] = camera_rays.get_ray(px + lane, py);
+        }
+        int hit_lanes = bbht.check_intersect_packet(rays, hits, &statistics);
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+          if (hit_lanes & (1 << lane)) image.update_pixel(px + lane, py, white);
+        }
+      }
+    }
+  return statistics.node_visits + statistics.get_total_primitive_tests();
 }
 
-int no_hierarchy_acceleration(CameraProperties props, PPMImageFile& image, std::vector<std::unique_ptr<Mesh>>& meshes) {
+long long no_hierarchy_acceleration(CameraProperties props, PPMImageFile& image,
+                                    std::vector<std::unique_ptr<Mesh>>& meshes, RenderStatistics& statistics) {
   /*
     This is the brute-force method:
     Go through every single ray and query against every single mesh
   */
-  int counter = 0;
+  CameraRayGenerator camera_rays(props);
+  long long counter = 0;
   for (int px = 0; px < image.get_width(); px++) {
     for (int py = 0; py < image.get_height(); py++) {
-      Pixel p = image.get_pixel(px, py);
-      Ray r = p.as_ray(props);
+      Ray r = camera_rays.get_ray(px, py);
       for (auto& mesh : meshes) {
           Hit h;
           if (mesh->check_intersect(r, &h)) {
             image.update_pixel(px, py, white);
           };
+          statistics.primitive_tests[static_cast<int>(mesh->get_meshtype())]++;
           counter++;
       }
     }
@@ -65,12 +124,13 @@ int no_hierarchy_acceleration(CameraProperties props, PPMImageFile& image, std::
 int main() {
   std::string filepath = std::string(TEST_DATA_DIR) + "/intersect_test.json";
   BlenderFileReader bfr = BlenderFileReader(filepath); 
-  Camera c = bfr.get_camera_from_blender_file();
-  CameraProperties props = c.get_camera_properties();
+  Scene scene = bfr.load_scene();
+  bfr.wait_for_textures();
+  CameraProperties props = scene.camera.get_camera_properties();
 
   PPMImageFile image("");
   image.set_width_and_height(props.resolution_x, props.resolution_y);  
-  std::vector<std::unique_ptr<Mesh>> meshes = bfr.get_meshes_from_blender_file(); 
+  std::vector<std::unique_ptr<Mesh>> meshes = std::move(scene.meshes); 
 
   std::cout << "-- TESTING NO HIERARCHY --------------\n";
   measureExecutionTime(no_hierarchy_acceleration, props, image, meshes);
@@ -78,9 +138,27 @@ int main() {
   image.write_current_image_to_file(image_filepath);
   std::cout << "--------------------------------------\n";
 
-  std::cout << "\n-- TESTING HIERARCHY --------------\n";
-  measureExecutionTime(hierarchy_acceleration, props, image, meshes);
+  std::cout << "\n-- TESTING MIDPOINT HIERARCHY -----\n";
+  measureExecutionTime(midpoint_hierarchy_acceleration, props, image, meshes);
   std::string image_filepath_h = std::string(TEST_DATA_DIR) + "/image_result_hierarchy.ppm";
   image.write_current_image_to_file(image_filepath_h);
   std::cout << "--------------------------------------\n";
+
+  std::cout << "\n-- TESTING SAH HIERARCHY ----------\n";
+  measureExecutionTime(sah_hierarchy_acceleration, props, image, meshes);
+  std::string image_filepath_sah = std::string(TEST_DATA_DIR) + "/image_result_sah_hierarchy.ppm";
+  image.write_current_image_to_file(image_filepath_sah);
+  std::cout << "--------------------------------------\n";
+
+  std::cout << "\n-- TESTING WIDE SAH HIERARCHY -----\n";
+  measureExecutionTime(wide_sah_hierarchy_acceleration, props, image, meshes);
+  std::string image_filepath_wide = std::string(TEST_DATA_DIR) + "/image_result_wide_sah_hierarchy.ppm";
+  image.write_current_image_to_file(image_filepath_wide);
+  std::cout << "--------------------------------------\n";
+
+  std::cout << "\n-- TESTING SAH HIERARCHY WITH PACKETS --\n";
+  measureExecutionTime(packet_hierarchy_acceleration, props, image, meshes);
+  std::string image_filepath_packet = std::string(TEST_DATA_DIR) + "/image_result_packet_hierarchy.ppm";
+  image.write_current_image_to_file(image_filepath_packet);
+  std::cout << "--------------------------------------\n";
 }
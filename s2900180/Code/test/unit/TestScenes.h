@@ -0,0 +1,79 @@
+/*
+TestScenes.h
+James Hocking, 2025
+*/
+
+#pragma once
+
+#include "Mesh.h"
+#include "PrimitiveStore.h"
+#include "TriangleMesh.h"
+#include <Eigen/Dense>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+// a unit square in the xy plane, made of two triangles
+inline std::shared_ptr<const TriangleMeshData> make_square_mesh() {
+    return std::make_shared<const TriangleMeshData>(
+        "Square", std::vector<float>{0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0}, std::vector<float>{},
+        std::vector<float>{0, 0, 1, 0, 1, 1, 0, 1}, std::vector<uint32_t>{0, 1, 2, 0, 2, 3});
+}
+
+// two instances of one square: "First" where the mesh is, and "Second" doubled in size and
+// moved up to z = 2
+inline PrimitiveStore make_square_instances(const Material& material = Material()) {
+    std::shared_ptr<const TriangleMeshData> square = make_square_mesh();
+    Eigen::Matrix4f moved = Eigen::Matrix4f::Identity();
+    moved.topLeftCorner<3, 3>() *= 2.0f;
+    moved(2, 3) = 2.0f;
+
+    PrimitiveStore store;
+    TriangleMesh first(square, Eigen::Matrix4f::Identity(), "First", MeshType::TRIANGLE_MESH, material);
+    TriangleMesh second(square, moved, "Second", MeshType::TRIANGLE_MESH, material);
+    store.add(first);
+    store.add(second);
+    return store;
+}
+
+// a 6x6 grid of cubes, spheres and planes in turn, spread over x and y in front of the origin
+// at different depths, each with a material of its own so hits can be told apart
+inline PrimitiveStore make_mixed_store() {
+    PrimitiveStore store;
+    for (int i = 0; i < 36; i++) {
+        Eigen::Vector3f centre(3.0f * (i % 6) - 7.5f, 3.0f * (i / 6) - 7.5f, -10.0f - (i % 5));
+        Material material = Material();
+        material.kd = i / 36.0f;
+        std::string name = "Mesh" + std::to_string(i);
+        switch (i % 3) {
+            case 0: {
+                Cube cube(centre, Eigen::Vector3f(0.3f, 0.2f, 0.1f * i), Eigen::Vector3f::Ones(), name, MeshType::CUBE, material);
+                store.add(cube);
+                break;
+            }
+            case 1: {
+                Sphere sphere(centre, Eigen::Vector3f::Zero(), Eigen::Vector3f(1.2f, 1.0f, 0.8f), name, MeshType::SPHERE, material);
+                store.add(sphere);
+                break;
+            }
+            case 2: {
+                // tilted towards the viewer, so its box has some depth
+                std::array<Eigen::Vector3f, NUMBER_OF_PLANE_CORNERS> corners = {
+                    centre + Eigen::Vector3f(-1.2f, -1.2f, -0.5f), centre + Eigen::Vector3f(1.2f, -1.2f, -0.5f),
+                    centre + Eigen::Vector3f(-1.2f, 1.2f, 0.5f), centre + Eigen::Vector3f(1.2f, 1.2f, 0.5f)};
+                Plane plane(corners, name, MeshType::PLANE, material);
+                store.add(plane);
+                break;
+            }
+        }
+    }
+    return store;
+}
+
+// a ray from the origin through a point of an image plane at z = -1, spanning the grid above
+inline Ray make_grid_ray(int px, int py, int resolution) {
+    float x = (px + 0.5f) / resolution * 2.0f - 1.0f;
+    float y = (py + 0.5f) / resolution * 2.0f - 1.0f;
+    return Ray(Eigen::Vector3f::Zero(), Eigen::Vector3f(x, y, -1.0f).normalized());
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include "AccelerationHierarchy.h"
+#include "Mesh.h"
+#include "RenderStatistics.h"
+#include "TestScenes.h"
+#include <array>
+#include <limits>
+
+TEST(BoundingBoxTreeTest, KeepsEveryPrimitiveOfABigCluster) {
+    // more spheres in one spot than a leaf can count, so the midpoint builder cannot separate them
+    PrimitiveStore store;
+    size_t count = MAX_LEAF_PRIMITIVES + 100;
+    for (size_t i = 0; i < count; i++) {
+        Sphere sphere(Eigen::Vector3f(0.0f, 0.0f, -5.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::Ones(), "Sphere",
+                      MeshType::SPHERE, Material());
+        store.add(sphere);
+    }
+    BoundingBoxHierarchyTree tree(std::move(store), BoundingBoxBuilder::MIDPOINT, 2);
+
+    // every sphere is hit at the same distance, so the ray tests all of them
+    Hit hit;
+    RenderStatistics statistics;
+    ASSERT_TRUE(tree.check_intersect(Ray(Eigen::Vector3f::Zero(), Eigen::Vector3f(0.0f, 0.0f, -1.0f)), &hit, &statistics));
+    ASSERT_EQ(statistics.primitive_tests[static_cast<int>(MeshType::SPHERE)], count);
+}
+
+TEST(BoundingBoxTreeTest, FindsHitsJustPastAPlanesEdge) {
+    // a flat square in z = 0, and a sphere far enough away that the plane gets a leaf of its own
+    std::array<Eigen::Vector3f, NUMBER_OF_PLANE_CORNERS> corners = {
+        Eigen::Vector3f(-1.0f, -1.0f, 0.0f), Eigen::Vector3f(1.0f, -1.0f, 0.0f),
+        Eigen::Vector3f(-1.0f, 1.0f, 0.0f), Eigen::Vector3f(1.0f, 1.0f, 0.0f)};
+    Plane plane(corners, "Plane", MeshType::PLANE, Material());
+    Sphere sphere(Eigen::Vector3f(10.0f, 0.0f, 0.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::Ones(), "Sphere",
+                  MeshType::SPHERE, Material());
+
+    // the plane's own test accepts a point this far past its corner
+    Ray ray(Eigen::Vector3f(1.0f + 0.5f * PLANE_CONTAINS_TOLERANCE, 0.0f, 1.0f), Eigen::Vector3f(0.0f, 0.0f, -1.0f));
+    Hit alone;
+    ASSERT_TRUE(check_intersect_plane(plane.get_primitive(), ray, nullptr, &alone));
+
+    for (int width : {2, WIDE_NODE_WIDTH}) {
+        PrimitiveStore store;
+        store.add(plane);
+        store.add(sphere);
+        BoundingBoxHierarchyTree tree(std::move(store), BoundingBoxBuilder::SAH, width);
+
+        Hit hit;
+        RenderStatistics statistics;
+        ASSERT_TRUE(tree.check_intersect(ray, &hit, &statistics));
+        ASSERT_EQ(hit.distance_along_ray, alone.distance_along_ray);
+        ASSERT_TRUE(tree.occluded(ray, 2.0f, &statistics));
+    }
+}
+
+TEST(BoundingBoxTreeTest, OnlyBlockersBeforeTMaxOcclude) {
+    // one unit sphere 5 away straight ahead, and another 20 away off to the side
+    Sphere near(Eigen::Vector3f(0.0f, 0.0f, -5.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::Ones(), "Near",
+                MeshType::SPHERE, Material());
+    Sphere far(Eigen::Vector3f(5.0f, 0.0f, -20.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::Ones(), "Far",
+               MeshType::SPHERE, Material());
+    Ray towards_near(Eigen::Vector3f::Zero(), Eigen::Vector3f(0.0f, 0.0f, -1.0f));
+    Ray towards_far(Eigen::Vector3f::Zero(), Eigen::Vector3f(5.0f, 0.0f, -20.0f).normalized());
+
+    for (int width : {2, WIDE_NODE_WIDTH}) {
+        PrimitiveStore store;
+        uint32_t near_reference = store.add(near);
+        store.add(far);
+        BoundingBoxHierarchyTree tree(std::move(store), BoundingBoxBuilder::SAH, width);
+        RenderStatistics statistics;
+        // the spheres are far enough apart to get a leaf each, so t_max culls whole boxes too
+        ASSERT_GT(tree.get_number_of_nodes(), 1);
+
+        // the near sphere is hit at 4, so it blocks a light 10 away but not one 3 away
+        uint32_t occluder = NO_PRIMITIVE;
+        EXPECT_TRUE(tree.occluded(towards_near, 10.0f, &statistics, &occluder)) << "width " << width;
+        EXPECT_EQ(occluder, near_reference) << "width " << width;
+        EXPECT_FALSE(tree.occluded(towards_near, 3.0f, &statistics)) << "width " << width;
+
+        // the far sphere lies past a light 10 away, so it casts no shadow until t_max reaches it
+        EXPECT_FALSE(tree.occluded(towards_far, 10.0f, &statistics)) << "width " << width;
+        EXPECT_TRUE(tree.occluded(towards_far, 30.0f, &statistics)) << "width " << width;
+    }
+}
+
+TEST(BoundingBoxTreeTest, WideTreeAgreesWithBinaryTree) {
+    // both widths over the same primitives, so every ray should see the same scene
+    BoundingBoxHierarchyTree binary(make_mixed_store(), BoundingBoxBuilder::SAH, 2);
+    BoundingBoxHierarchyTree wide(make_mixed_store(), BoundingBoxBuilder::SAH, WIDE_NODE_WIDTH);
+    ASSERT_GT(wide.get_number_of_wide_nodes(), 0);
+
+    RenderStatistics statistics;
+    int resolution = 32;
+    for (int py = 0; py < resolution; py++) {
+        for (int px = 0; px < resolution; px++) {
+            Ray ray = make_grid_ray(px, py, resolution);
+            Hit binary_hit;
+            Hit wide_hit;
+            bool is_binary_hit = binary.check_intersect(ray, &binary_hit, &statistics);
+            ASSERT_EQ(wide.check_intersect(ray, &wide_hit, &statistics), is_binary_hit) << "ray " << px << ", " << py;
+            ASSERT_EQ(wide.occluded(ray, std::numeric_limits<float>::infinity(), &statistics), is_binary_hit)
+                << "ray " << px << ", " << py;
+            if (!is_binary_hit) continue;
+            EXPECT_FLOAT_EQ(wide_hit.distance_along_ray, binary_hit.distance_along_ray) << "ray " << px << ", " << py;
+            // each tree compiles its own materials, so they are told apart by their kd
+            EXPECT_EQ(wide_hit.material->kd, binary_hit.material->kd) << "ray " << px << ", " << py;
+
+            // stopping just short of the closest hit, neither tree may find a blocker
+            float t_max = 0.99f * binary_hit.distance_along_ray;
+            EXPECT_FALSE(binary.occluded(ray, t_max, &statistics)) << "ray " << px << ", " << py;
+            EXPECT_FALSE(wide.occluded(ray, t_max, &statistics)) << "ray " << px << ", " << py;
+        }
+    }
+}
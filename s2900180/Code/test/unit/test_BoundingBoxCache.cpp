@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include "AccelerationHierarchy.h"
+#include "BoundingBoxCache.h"
+#include "Mesh.h"
+#include <cstring>
+#include <fstream>
+
+TEST(BoundingBoxCacheTest, RejectsDamagedFiles) {
+    // a row of spheres, so the wide tree has more than one level
+    PrimitiveStore store;
+    for (int i = 0; i < 16; i++) {
+        Sphere sphere(Eigen::Vector3f(2.0f * i, 0.0f, -5.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::Ones(), "Sphere",
+                      MeshType::SPHERE, Material());
+        store.add(sphere);
+    }
+    std::string filepath = std::string(TEST_DATA_DIR) + "/test.bvhcache";
+    std::remove(filepath.c_str());
+    BoundingBoxHierarchyTree tree(std::move(store), BoundingBoxBuilder::SAH, WIDE_NODE_WIDTH, filepath);
+    uint64_t hash = hash_bounding_box_inputs(tree.get_store(), BoundingBoxBuilder::SAH, WIDE_NODE_WIDTH);
+    ASSERT_TRUE(read_bounding_box_cache(filepath, hash, tree.get_store(), WIDE_NODE_WIDTH).has_value());
+
+    std::vector<char> bytes;
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    BoundingBoxCacheHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    auto read_damaged = [&](size_t offset, const auto& value) {
+        std::vector<char> damaged = bytes;
+        std::memcpy(damaged.data() + offset, &value, sizeof(value));
+        std::ofstream(filepath, std::ios::binary).write(damaged.data(), static_cast<std::streamsize>(damaged.size()));
+        return read_bounding_box_cache(filepath, hash, tree.get_store(), WIDE_NODE_WIDTH).has_value();
+    };
+
+    // a wide node pointing back at itself would loop forever
+    WideBoundingBoxNode root;
+    std::memcpy(&root, bytes.data() + header.wide_node_offset, sizeof(root));
+    root.leaf_mask &= ~1;
+    root.child[0] = 0;
+    ASSERT_FALSE(read_damaged(header.wide_node_offset, root));
+
+    // a reference to a cube, when the store holds none
+    ASSERT_FALSE(read_damaged(header.primitive_offset, make_primitive_reference(MeshType::CUBE, 0)));
+    std::remove(filepath.c_str());
+}
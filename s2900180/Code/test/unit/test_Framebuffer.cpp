@@ -0,0 +1,22 @@
+#include <gtest/gtest.h>
+#include "Framebuffer.h"
+#include "Image.h"
+
+TEST(FramebufferTest, QuantizeClampsToEightBits) {
+    Framebuffer framebuffer(2, 1);
+    framebuffer.set_pixel(0, 0, Eigen::Vector3f(-4.0f, 127.9f, 300.0f));
+    framebuffer.add_to_pixel(1, 0, Eigen::Vector3f(10.0f, 20.0f, 30.0f));
+    framebuffer.add_to_pixel(1, 0, Eigen::Vector3f(10.0f, 20.0f, 30.0f));
+
+    PPMImageFile img("");
+    framebuffer.quantize(img);
+
+    ASSERT_EQ(img.get_width(), 2);
+    ASSERT_EQ(img.get_height(), 1);
+    ASSERT_EQ(img.get_pixel(0, 0).colour.r, 0);
+    ASSERT_EQ(img.get_pixel(0, 0).colour.g, 127);
+    ASSERT_EQ(img.get_pixel(0, 0).colour.b, 255);
+    ASSERT_EQ(img.get_pixel(1, 0).colour.r, 20);
+    ASSERT_EQ(img.get_pixel(1, 0).colour.g, 40);
+    ASSERT_EQ(img.get_pixel(1, 0).colour.b, 60);
+}
@@ -52,3 +52,30 @@ TEST(PPMImageFileTest, CanWriteToFile) {
         std::perror("Error deleting file");
     }
 }
+
+TEST(PPMImageFileTest, CanWriteAndReadBinaryFormats) {
+    std::string filepath = std::string(TEST_DATA_DIR) + "/test.ppm";
+    PPMImageFile img = PPMImageFile(filepath);
+    EXPECT_NO_THROW(img.read_image_from_file());
+
+    // the reader picks the format from the header, not the extension
+    std::string filepath_p6 = std::string(TEST_DATA_DIR) + "/test_output_p6.ppm";
+    std::string filepath_pfm = std::string(TEST_DATA_DIR) + "/test_output.pfm";
+    img.write_current_image_to_file(filepath_p6, ImageFormat::P6);
+    img.write_current_image_to_file(filepath_pfm, ImageFormat::PFM);
+
+    for (const std::string& output : {filepath_p6, filepath_pfm}) {
+        PPMImageFile img2 = PPMImageFile(output);
+        EXPECT_NO_THROW(img2.read_image_from_file());
+        ASSERT_EQ(img2.get_width(), 4);
+        ASSERT_EQ(img2.get_height(), 4);
+        for (int py = 0; py < 4; py++) {
+            for (int px = 0; px < 4; px++) {
+                ASSERT_EQ(img2.get_pixel(px, py).colour.r, img.get_pixel(px, py).colour.r);
+                ASSERT_EQ(img2.get_pixel(px, py).colour.g, img.get_pixel(px, py).colour.g);
+                ASSERT_EQ(img2.get_pixel(px, py).colour.b, img.get_pixel(px, py).colour.b);
+            }
+        }
+        std::remove(output.c_str());
+    }
+}
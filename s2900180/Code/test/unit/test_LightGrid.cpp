@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+#include "LightGrid.h"
+
+TEST(LightGridTest, OnlyLightsInReachAreShaded) {
+    // a row of lights one unit apart, each reaching 0.2 * 255 / 25.5 = 2 units
+    std::vector<Light> lights;
+    for (int i = 0; i < 20; i++) lights.push_back(Light(Eigen::Vector3f(i, 0.0f, 0.0f), 0.1f, 0.1f));
+    LightGrid grid(lights, 25.5f);
+    ASSERT_NEAR(grid.get_radius(0), 2.0f, 1e-4f);
+
+    for (float x : {-5.0f, 0.0f, 7.3f, 19.5f}) {
+        Eigen::Vector3f P(x, 0.5f, 0.0f);
+        std::vector<uint32_t> visited;
+        grid.for_each_light(P, [&](uint32_t light_index, float weight) {
+            visited.push_back(light_index);
+            ASSERT_EQ(weight, 1.0f);
+        });
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < lights.size(); i++) {
+            if ((lights[i].get_location() - P).norm() < 2.0f) expected.push_back(i);
+        }
+        ASSERT_EQ(visited, expected);
+    }
+
+    // sampled lights keep the estimated total, each pick standing in for its share of it
+    LightGrid sampled(lights, 0.0f, 4);
+    Eigen::Vector3f P(7.3f, 0.5f, 0.0f);
+    float total = 0.0f, weighted = 0.0f;
+    int picks = 0;
+    for (const Light& light : lights) total += 0.2f * std::min(1.0f / (light.get_location() - P).norm(), 1.0f);
+    sampled.for_each_light(P, [&](uint32_t light_index, float weight) {
+        weighted += weight * 0.2f * std::min(1.0f / (lights[light_index].get_location() - P).norm(), 1.0f);
+        picks++;
+    });
+    ASSERT_LE(picks, 4);
+    ASSERT_NEAR(weighted, total, 1e-3f * total);
+}
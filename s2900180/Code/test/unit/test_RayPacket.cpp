@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include "AccelerationHierarchy.h"
+#include "Light.h"
+#include "RayPacket.h"
+#include "RenderStatistics.h"
+#include "TestScenes.h"
+#include <limits>
+#include <string>
+#include <vector>
+
+constexpr int GRID_RESOLUTION = 32; // rays per side, rows split into coherent packets of 8
+
+// helper that traces packets of neighbouring grid rays with the given implementation, and checks
+// each lane against check_intersect
+static void expect_packets_match_single_rays(BoundingBoxHierarchyTree& tree, PacketTraversalFunction traverse) {
+    PacketTraversalData data = tree.get_packet_traversal_data();
+    RenderStatistics statistics;
+    int hits_found = 0;
+
+    for (int py = 0; py < GRID_RESOLUTION; py++) {
+        for (int start = 0; start < GRID_RESOLUTION; start += RAY_PACKET_SIZE) {
+            Ray rays[RAY_PACKET_SIZE];
+            RayPacket packet;
+            PacketHit packet_hit;
+            for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                rays[lane] = make_grid_ray(start + lane, py, GRID_RESOLUTION);
+                for (int i = 0; i < 3; i++) {
+                    packet.origin[i][lane] = rays[lane].origin[i];
+                    packet.direction[i][lane] = rays[lane].direction[i];
+                    packet.inv_direction[i][lane] = rays[lane].inv_direction[i];
+                }
+                packet_hit.distance[lane] = std::numeric_limits<float>::infinity();
+                packet_hit.primitive[lane] = NO_PRIMITIVE;
+            }
+            for (int i = 0; i < 3; i++) packet.direction_is_negative[i] = rays[0].direction_is_negative[i];
+
+            traverse(data, packet, packet_hit, &statistics);
+
+            for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                Hit expected;
+                bool is_expected_hit = tree.check_intersect(rays[lane], &expected, &statistics);
+
+                Hit hit;
+                bool is_hit = packet_hit.primitive[lane] != NO_PRIMITIVE &&
+                              tree.get_store().check_intersect(packet_hit.primitive[lane], rays[lane], &hit);
+                ASSERT_EQ(is_hit, is_expected_hit) << "ray " << start + lane << ", " << py;
+                if (!is_hit) continue;
+                hits_found++;
+                EXPECT_FLOAT_EQ(hit.distance_along_ray, expected.distance_along_ray) << "ray " << start + lane << ", " << py;
+                EXPECT_EQ(hit.material, expected.material) << "ray " << start + lane << ", " << py;
+            }
+        }
+    }
+
+    // the grid should catch a good share of the scene, and miss some of it
+    EXPECT_GT(hits_found, 0);
+    EXPECT_LT(hits_found, GRID_RESOLUTION * GRID_RESOLUTION);
+}
+
+TEST(RayPacketTest, ScalarMatchesSingleRays) {
+    BoundingBoxHierarchyTree tree(make_mixed_store());
+    expect_packets_match_single_rays(tree, traverse_packet_scalar);
+}
+
+TEST(RayPacketTest, SseMatchesSingleRays) {
+    BoundingBoxHierarchyTree tree(make_mixed_store());
+    expect_packets_match_single_rays(tree, traverse_packet_sse);
+}
+
+TEST(RayPacketTest, Avx2MatchesSingleRays) {
+#if defined(RAYTRACER_HAS_AVX2_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+    if (!__builtin_cpu_supports("avx2")) GTEST_SKIP() << "CPU has no AVX2";
+    BoundingBoxHierarchyTree tree(make_mixed_store());
+    expect_packets_match_single_rays(tree, traverse_packet_avx2);
+#else
+    GTEST_SKIP() << "AVX2 kernels not built";
+#endif
+}
+
+TEST(RayPacketTest, MixedSignPacketMatchesSingleRays) {
+    BoundingBoxHierarchyTree tree(make_mixed_store());
+    RenderStatistics statistics;
+
+    // the packet straddles x = 0, so half its rays point left and half right
+    for (int py = 0; py < GRID_RESOLUTION; py++) {
+        Ray rays[RAY_PACKET_SIZE];
+        Hit hits[RAY_PACKET_SIZE];
+        int start = GRID_RESOLUTION / 2 - RAY_PACKET_SIZE / 2;
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) rays[lane] = make_grid_ray(start + lane, py, GRID_RESOLUTION);
+        ASSERT_NE(rays[0].direction_is_negative[0], rays[RAY_PACKET_SIZE - 1].direction_is_negative[0]);
+
+        int hit_lanes = tree.check_intersect_packet(rays, hits, &statistics);
+
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            Hit expected;
+            bool is_expected_hit = tree.check_intersect(rays[lane], &expected, &statistics);
+            ASSERT_EQ(((hit_lanes >> lane) & 1) != 0, is_expected_hit) << "ray " << start + lane << ", " << py;
+            ASSERT_EQ(hits[lane].is_hit, is_expected_hit) << "ray " << start + lane << ", " << py;
+            if (!is_expected_hit) continue;
+            EXPECT_FLOAT_EQ(hits[lane].distance_along_ray, expected.distance_along_ray) << "ray " << start + lane << ", " << py;
+            EXPECT_EQ(hits[lane].material, expected.material) << "ray " << start + lane << ", " << py;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include "Raytracer.h"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// helper that renders the small test scene with the given extra settings, returning the bytes of
+// the pfm written. pfm keeps the full float of every pixel, so equal files mean equal framebuffers
+static std::vector<char> render_small_scene(std::vector<std::string> arguments) {
+    std::string output = std::string(TEST_DATA_DIR) + "/test_render.pfm";
+    arguments.insert(arguments.end(), {"--input", std::string(TEST_DATA_DIR) + "/small_scene.json", "--output", output});
+
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) argv.push_back(argument.data());
+
+    RayTracer raytracer;
+    raytracer.create_settings_from_command_args(static_cast<int>(argv.size()), argv.data());
+    raytracer.setup();
+    raytracer.render_image();
+
+    std::ifstream file(output, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(output.c_str());
+    return bytes;
+}
+
+TEST(RayTracerTest, ImageDoesNotDependOnThreadsOrTiles) {
+    // each mode is rendered on one thread, then on several with tiles that do not divide the
+    // 61x37 image, so some tiles are cut short and the threads take them in any order
+    std::vector<std::vector<std::string>> modes = {
+        {},
+        {"--antialiasing", "4"},
+        {"--wavefront"},
+        {"--progressive", "--max-samples", "4"},
+    };
+    for (const std::vector<std::string>& mode : modes) {
+        std::vector<std::string> single = mode;
+        single.insert(single.end(), {"--threads", "1"});
+        std::vector<std::string> several = mode;
+        several.insert(several.end(), {"--threads", "3", "--tile-size", "7"});
+
+        std::vector<char> expected = render_small_scene(single);
+        ASSERT_FALSE(expected.empty());
+        ASSERT_TRUE(render_small_scene(several) == expected) << "mode " << (mode.empty() ? "default" : mode[0]);
+    }
+}
@@ -0,0 +1,31 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include "RenderStatistics.h"
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+TEST(RenderStatisticsTest, MergesThreadsIntoTheReport) {
+    // two threads' counts, added together and written out
+    RenderStatistics first, second;
+    first.add_ray(RayType::PRIMARY, true);
+    first.add_ray(RayType::SHADOW, false);
+    second.add_ray(RayType::PRIMARY, false);
+    second.primitive_tests[static_cast<int>(MeshType::SPHERE)] += 3;
+
+    RenderReport report;
+    report.statistics.add(first);
+    report.statistics.add(second);
+    report.phase_milliseconds[static_cast<int>(RenderPhase::RENDER)] = 1.0;
+    ASSERT_EQ(report.statistics.get_total_rays(), 3);
+    ASSERT_NEAR(report.get_mrays_per_second(), 0.003, 1e-9);
+
+    std::string filepath = std::string(TEST_DATA_DIR) + "/test_stats.json";
+    write_render_report(filepath, report);
+    std::ifstream file(filepath);
+    nlohmann::json json = nlohmann::json::parse(file);
+    ASSERT_EQ(json["rays"]["primary"]["count"], 2);
+    ASSERT_EQ(json["rays"]["primary"]["hits"], 1);
+    ASSERT_EQ(json["primitive_tests"]["sphere"], 3);
+    file.close();
+    std::remove(filepath.c_str());
+}
@@ -0,0 +1,27 @@
+#include <gtest/gtest.h>
+#include "Sampler.h"
+
+TEST(SamplerTest, SobolSamplesAreStratified) {
+    // any 16 samples of a pixel from the start put exactly one into every 4x4 cell, and into
+    // every 1/16 wide column and row
+    for (int px : {0, 7, 1234}) {
+        int cells[16] = {0}, columns[16] = {0}, rows[16] = {0};
+        for (int i = 0; i < 16; i++) {
+            float x = sobol_sample(px, 3, i, 0);
+            float y = sobol_sample(px, 3, i, 1);
+            ASSERT_TRUE(x >= 0.0f && x < 1.0f && y >= 0.0f && y < 1.0f);
+            cells[static_cast<int>(x * 4) * 4 + static_cast<int>(y * 4)]++;
+            columns[static_cast<int>(x * 16)]++;
+            rows[static_cast<int>(y * 16)]++;
+        }
+        for (int i = 0; i < 16; i++) {
+            ASSERT_EQ(cells[i], 1);
+            ASSERT_EQ(columns[i], 1);
+            ASSERT_EQ(rows[i], 1);
+        }
+    }
+
+    // and a sample never depends on what was asked for before it
+    ASSERT_EQ(Sampler(SamplerType::R2).get(5, 6, 9, 1), r2_sample(5, 6, 9, 1));
+    ASSERT_EQ(Sampler(SamplerType::SOBOL).get(5, 6, 9, 1), sobol_sample(5, 6, 9, 1));
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include "SceneFile.h"
+#include "TestScenes.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+
+TEST(SceneFileTest, CompiledSceneRoundTrips) {
+    Material material;
+    material.kd = 0.25f;
+    material.base_colour = {10, 20, 30};
+    PrimitiveStore store = make_square_instances(material);
+
+    CameraProperties camera{Eigen::Vector3f(1.0f, 2.0f, 3.0f), Eigen::Vector3f(0.0f, 0.0f, -1.0f),
+                            Eigen::Vector3f(0.0f, 1.0f, 0.0f), SensorFit::VERTICAL, 50.0f, 36.0f, 24.0f, 64.0f, 48.0f};
+    std::vector<Light> lights{Light(Eigen::Vector3f(0.0f, 5.0f, 0.0f), 10.0f, 5.0f)};
+
+    std::string filepath = std::string(TEST_DATA_DIR) + "/test.rtscene";
+    write_scene_file(filepath, camera, lights, store);
+    SceneFileReader reader(filepath);
+    CompiledScene scene = reader.load_scene();
+    reader.wait_for_textures();
+
+    CameraProperties read_camera = scene.camera.get_camera_properties();
+    ASSERT_EQ(read_camera.location, camera.location);
+    ASSERT_EQ(read_camera.sensor_fit, camera.sensor_fit);
+    ASSERT_EQ(read_camera.focal_length, camera.focal_length);
+    ASSERT_EQ(read_camera.resolution_y, camera.resolution_y);
+    ASSERT_EQ(scene.lights.size(), 1u);
+    ASSERT_EQ(scene.lights[0].get_location(), lights[0].get_location());
+    ASSERT_EQ(scene.lights[0].get_is(), lights[0].get_is());
+
+    // the instances still share one mesh, and keep their names, materials and placement
+    ASSERT_EQ(scene.store.size(), store.size());
+    ASSERT_TRUE(std::equal(store.get_references().begin(), store.get_references().end(),
+                           scene.store.get_references().begin()));
+    ASSERT_EQ(scene.store.get_triangle_mesh_data().size(), 1u);
+    ASSERT_EQ(scene.store.get_triangle_mesh_data()[0]->get_positions(), make_square_mesh()->get_positions());
+    ASSERT_EQ(scene.store.get_triangle_mesh_data()[0]->get_uvs(), make_square_mesh()->get_uvs());
+    ASSERT_EQ(scene.store.get_triangle_mesh_data()[0]->get_number_of_triangles(), 2u);
+    uint32_t reference = scene.store.get_references()[1];
+    ASSERT_EQ(scene.store.get_name(reference), "Second");
+    ASSERT_EQ(scene.store.get_material(1).kd, 0.25f);
+    ASSERT_EQ(scene.store.get_material(1).base_colour.b, 30);
+    float t;
+    ASSERT_TRUE(scene.store.intersect(reference, Ray(Eigen::Vector3f(1.5f, 1.5f, 5.0f), Eigen::Vector3f(0.0f, 0.0f, -1.0f)), t));
+    ASSERT_FLOAT_EQ(t, 3.0f);
+
+    std::vector<char> bytes;
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    // a file cut short leaves its last sections outside of it
+    std::ofstream(filepath, std::ios::binary).write(bytes.data(), static_cast<std::streamsize>(bytes.size() / 2));
+    ASSERT_THROW(SceneFileReader(filepath).load_scene(), std::runtime_error);
+
+    // a file from another version of the format is refused rather than misread
+    std::vector<char> other_version = bytes;
+    uint32_t version = SCENE_FILE_VERSION + 1;
+    std::memcpy(other_version.data() + offsetof(SceneFileHeader, version), &version, sizeof(version));
+    std::ofstream(filepath, std::ios::binary).write(other_version.data(), static_cast<std::streamsize>(other_version.size()));
+    ASSERT_THROW(SceneFileReader(filepath).load_scene(), std::runtime_error);
+    std::remove(filepath.c_str());
+}
@@ -0,0 +1,29 @@
+#include <gtest/gtest.h>
+#include "AccelerationHierarchy.h"
+#include "Mesh.h"
+#include "ShadowCache.h"
+#include "RenderStatistics.h"
+
+TEST(ShadowCacheTest, RemembersTheLastBlocker) {
+    // two unit spheres side by side under a light at the origin
+    PrimitiveStore store;
+    for (float x : {-2.0f, 2.0f}) {
+        Sphere sphere(Eigen::Vector3f(x, 0.0f, -5.0f), Eigen::Vector3f::Zero(), Eigen::Vector3f::Ones(), "Sphere",
+                      MeshType::SPHERE, Material());
+        store.add(sphere);
+    }
+    BoundingBoxHierarchyTree tree(std::move(store));
+    ShadowCache cache(1);
+    RenderStatistics statistics;
+
+    // points whose rays pass through the centre of one sphere or the other, then one lit point between them
+    auto shadow_ray = [](float x) { return Ray(Eigen::Vector3f(x, 0.0f, -10.0f), Eigen::Vector3f(-x, 0.0f, 10.0f).normalized()); };
+    float t_max = 9.9f;
+    for (float x : {-4.0f, -4.0f, 4.0f, 4.0f, 0.0f}) {
+        ASSERT_EQ(cache.occluded(tree, shadow_ray(x), t_max, 0, &statistics), tree.occluded(shadow_ray(x), t_max, &statistics));
+    }
+
+    // the repeats are answered by the cache, the switch to the other sphere is not
+    ASSERT_EQ(statistics.shadow_cache_lookups, 4);
+    ASSERT_EQ(statistics.shadow_cache_hits, 2);
+}
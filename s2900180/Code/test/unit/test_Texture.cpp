@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "Texture.h"
+#include <cmath>
+
+TEST(TextureCacheTest, SharesTexturesBetweenPaths) {
+    std::string filepath = std::string(TEST_DATA_DIR) + "/test.ppm";
+    std::string other_spelling = std::string(TEST_DATA_DIR) + "/../test_data/test.ppm";
+
+    TextureCache cache;
+    std::shared_ptr<const Texture> texture = cache.get(filepath);
+    ASSERT_EQ(cache.get(other_spelling), texture);
+    ASSERT_EQ(cache.size(), 1u);
+    cache.wait();
+
+    ASSERT_EQ(texture->get_format(), TexelFormat::RGB8);
+    ASSERT_FLOAT_EQ(texture->get_texel(3, 0).x(), 15 / 255.0f);
+    ASSERT_FLOAT_EQ(texture->get_texel(3, 0).y(), 0.0f);
+}
+
+TEST(TextureTest, BuildsMipChain) {
+    std::string filepath = std::string(TEST_DATA_DIR) + "/test.ppm";
+    std::shared_ptr<const Texture> texture = Texture::from_file(filepath);
+
+    // 4x4, 2x2 and 1x1, each padded out to one whole tile
+    ASSERT_EQ(texture->get_number_of_levels(), 3);
+    ASSERT_EQ(texture->get_size_in_bytes(), 3u * TEXELS_PER_TEXTURE_TILE * 3u);
+
+    // the last level is the average of the image, which every lookup at that level returns
+    Eigen::Vector3f average = Eigen::Vector3f::Zero();
+    for (int py = 0; py < 4; py++) {
+        for (int px = 0; px < 4; px++) average += texture->get_texel(px, py) / 16.0f;
+    }
+    Eigen::Vector3f top = texture->sample(0.1f, 0.9f, 100.0f);
+    for (int c = 0; c < 3; c++) ASSERT_NEAR(top[c], average[c], 1.0f / 255.0f);
+
+    // footprints of a texel or less read the full image
+    ASSERT_FLOAT_EQ(texture->get_lod(0.25f), 0.0f);
+    ASSERT_FLOAT_EQ(texture->get_lod(1.0f), 2.0f);
+}
+
+TEST(TextureCacheTest, HalfFloatsRoundTrip) {
+    for (float value : {0.0f, 1.0f, -2.5f, 0.333251953125f, 65504.0f, 5.9604645e-08f}) {
+        ASSERT_EQ(half_to_float(float_to_half(value)), value);
+    }
+    ASSERT_TRUE(std::isinf(half_to_float(float_to_half(1e6f))));
+}
@@ -0,0 +1,28 @@
+#include <gtest/gtest.h>
+#include "PrimitiveStore.h"
+#include "TestScenes.h"
+
+TEST(TriangleMeshTest, InstancesShareOneMesh) {
+    PrimitiveStore store = make_square_instances();
+    uint32_t reference = store.get_references()[1];
+    ASSERT_EQ(store.get_triangle_mesh_data().size(), 1u);
+
+    // (1.5, 1.5) is only within the larger copy, and distances stay in world units
+    float t;
+    Ray ray(Eigen::Vector3f(1.5f, 1.5f, 5.0f), Eigen::Vector3f(0.0f, 0.0f, -1.0f));
+    ASSERT_TRUE(store.intersect(reference, ray, t));
+    ASSERT_FLOAT_EQ(t, 3.0f);
+    ASSERT_FALSE(store.intersect(store.get_references()[0], ray, t));
+    ASSERT_FALSE(store.occluded(reference, ray, 2.5f));
+    // a closer hit already found elsewhere in the scene culls the instance
+    ASSERT_FALSE(store.intersect(reference, ray, t, 2.5f));
+
+    Eigen::Vector3f min, max;
+    store.get_bounds(reference, min, max);
+    Eigen::Vector3f padding = Eigen::Vector3f::Constant(PRIMITIVE_BOUNDS_PADDING);
+    ASSERT_TRUE((min + padding).isApprox(Eigen::Vector3f(0.0f, 0.0f, 2.0f)));
+    ASSERT_TRUE((max - padding).isApprox(Eigen::Vector3f(2.0f, 2.0f, 2.0f)));
+
+    // indices past the last vertex are refused
+    ASSERT_THROW(TriangleMeshData("Broken", {0, 0, 0, 1, 0, 0, 1, 1, 0}, {}, {}, {0, 1, 3}), std::runtime_error);
+}